@@ -0,0 +1,235 @@
+#include "analyse.h"
+#include "fen.h"
+#include "movegen.h"
+#include "search.h"
+#include "transposition.h"
+#include "utilities.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct AnalyseOptions {
+    std::string epdPath;
+    std::string outPath;
+    int depth = 0;
+    std::uint64_t nodes = 0;
+    int threads = 1;
+    int hashMB = 64; // per worker unless the TT is shared
+    bool sharedTT = false;
+};
+
+struct Job {
+    std::uint64_t index;
+    std::string line;
+};
+
+// Bounded so reading a huge file never gets far ahead of the workers
+class JobQueue {
+public:
+    explicit JobQueue(std::size_t capacity) : capacity(capacity) {}
+
+    void Push(Job job) {
+        std::unique_lock lock{mutex};
+        notFull.wait(lock, [&] { return jobs.size() < capacity; });
+        jobs.push_back(std::move(job));
+        notEmpty.notify_one();
+    }
+
+    // False once the queue is closed and drained
+    bool Pop(Job& job) {
+        std::unique_lock lock{mutex};
+        notEmpty.wait(lock, [&] { return !jobs.empty() || closed; });
+        if (jobs.empty()) {
+            return false;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard lock{mutex};
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    std::deque<Job> jobs;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+void AppendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        if ((unsigned char)c >= 0x20) {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+std::string AnalysePosition(const Job& job, const AnalyseOptions& options) {
+    std::string out = "{\"index\":" + std::to_string(job.index) + ",\"fen\":";
+    const std::size_t fenStart = out.size();
+    std::size_t fenEnd = fenStart;
+    try {
+        std::string fenString = EpdToFen(job.line);
+        AppendJsonString(out, fenString);
+        fenEnd = out.size();
+        Fen fen = ParseFen(fenString);
+        if (GenMoves(fen.board, fen.colorToMove).empty()) {
+            // Nothing to search, the side to move is mated or stalemated
+            bool mated = InCheck(fen.board, fen.colorToMove);
+            out += ",\"bestmove\":null,\"score\":{";
+            out += mated ? "\"mate\":0" : "\"cp\":0";
+            out += "},\"depth\":0,\"nodes\":0,\"pv\":[]}";
+            return out;
+        }
+        threefoldRepetitionTable.clear();
+        searchHistory->Clear();
+        Move bestMove = Search(fen.board, fen.colorToMove, SearchLimits{ .depth = options.depth, .nodes = options.nodes }, false);
+        const RootLine& line = rootLines[0];
+        out += ",\"bestmove\":\"" + MoveToUCINotation(bestMove) + "\",\"score\":{";
+        if (int mate = MateMoves(line.score)) {
+            out += "\"mate\":" + std::to_string(mate);
+        }
+        else {
+            out += "\"cp\":" + std::to_string(line.score);
+        }
+        out += "},\"depth\":" + std::to_string(line.depth) + ",\"nodes\":" + std::to_string(searchNodes) + ",\"pv\":[";
+        for (std::size_t i = 0; i < line.pv.size(); i++) {
+            out += (i ? ",\"" : "\"") + MoveToUCINotation(line.pv[i]) + '"';
+        }
+        out += "]}";
+    }
+    catch (const std::exception& error) {
+        // Malformed positions, EpdToFen and ParseFen throw std::invalid_argument. The fen stays if it was extracted.
+        out.resize(fenEnd);
+        out += fenEnd == fenStart ? "null,\"error\":" : ",\"error\":";
+        AppendJsonString(out, error.what());
+        out += '}';
+    }
+    return out;
+}
+
+bool ParseOptions(int argc, char** argv, AnalyseOptions& options) {
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--shared-tt") {
+            options.sharedTT = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--epd") {
+            options.epdPath = value;
+        }
+        else if (arg == "--out") {
+            options.outPath = value;
+        }
+        else if (arg == "--depth") {
+            options.depth = std::atoi(value);
+        }
+        else if (arg == "--nodes") {
+            options.nodes = std::strtoull(value, nullptr, 10);
+        }
+        else if (arg == "--threads") {
+            options.threads = std::max(1, std::atoi(value));
+        }
+        else if (arg == "--hash") {
+            options.hashMB = std::max(1, std::atoi(value));
+        }
+        else {
+            std::cerr << "Unknown analyse option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.epdPath.empty() || options.outPath.empty() || (options.depth <= 0 && options.nodes == 0)) {
+        std::cerr << "Usage: faris-engine analyse --epd <file> (--depth <d> | --nodes <n>) [--threads <t>] "
+                     "[--hash <MB>] [--shared-tt] --out <file>" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int Analyse(int argc, char** argv) {
+    AnalyseOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    std::ifstream epd{options.epdPath};
+    if (!epd) {
+        std::cerr << "Failed to open '" << options.epdPath << "'" << std::endl;
+        return 1;
+    }
+    std::ofstream out{options.outPath};
+    if (!out) {
+        std::cerr << "Failed to open '" << options.outPath << "' for writing" << std::endl;
+        return 1;
+    }
+
+    const std::size_t ttEntries = (std::size_t)options.hashMB * 1024 * 1024 / sizeof(TTEntry);
+    std::unique_ptr<TT> sharedTT;
+    if (options.sharedTT) {
+        // Workers write the shared table without locking. A torn entry can only cost a wrong score or a TT move that
+        // isn't legal in the position, which move ordering never finds among the generated moves.
+        sharedTT = std::make_unique<TT>(ttEntries);
+    }
+    JobQueue queue{(std::size_t)options.threads * 4};
+    std::mutex outMutex;
+    std::uint64_t positions = 0;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; i++) {
+        workers.emplace_back([&] {
+            std::unique_ptr<TT> ownTT = sharedTT ? nullptr : std::make_unique<TT>(ttEntries);
+            searchTT = sharedTT ? sharedTT.get() : ownTT.get();
+            Job job;
+            while (queue.Pop(job)) {
+                std::string result = AnalysePosition(job, options);
+                std::lock_guard lock{outMutex};
+                out << result << '\n';
+            }
+        });
+    }
+
+    std::string line;
+    for (std::uint64_t index = 0; std::getline(epd, line); index++) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        queue.Push({ index, std::move(line) });
+        positions++;
+    }
+    queue.Close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::cerr << "Analysed " << positions << " positions" << std::endl;
+    return out ? 0 : 1;
+}
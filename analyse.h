@@ -0,0 +1,9 @@
+#pragma once
+
+// faris-engine analyse --epd <file> (--depth <d> | --nodes <n>) [--threads <t>] [--hash <MB>] [--shared-tt] --out <file>
+// Searches every position of an EPD/FEN file (one per line) on a pool of worker threads and writes one JSON object per
+// position: {"index", "fen", "bestmove", "score" (cp or mate), "depth", "nodes", "pv"}. A position without legal moves
+// isn't searched and gets a null bestmove with score mate 0 or cp 0. Results are written as they complete, so they are
+// not in input order; index is the 0-based line number. A line that isn't a valid position gets an "error" in place of
+// the search results, and a null fen if no FEN could be extracted from it at all. Returns the process exit code.
+int Analyse(int argc, char** argv);
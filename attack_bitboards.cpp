@@ -1,8 +1,12 @@
 #include "attack_bitboards.h"
 #include "board.h"
-#include "magic.h"
+#include "cpu.h"
+#include <bit>
+#include <cassert>
 #include <cstdlib>
+#if defined(USE_PEXT) || defined(USE_AVX2)
 #include <immintrin.h>
+#endif
 
 static std::array<Bitboard, 64> GenKnightAttacks() {
     constexpr int knightMoves[8] = {6, 10, 15, 17, -6, -10, -15, -17};
@@ -86,30 +90,355 @@ std::array<Bitboard, 64> knightAttacks = GenKnightAttacks();
 std::array<std::array<Bitboard, 64>, 2> pawnAttacks = GenPawnAttacks();
 std::array<Bitboard, 64> kingAttacks = GenKingAttacks();
 
-Bitboard RookAttack(Square square, Bitboard occupancy) {
+// Fancy magic bitboards. Every square owns a slice of one shared attack table holding 2^popcount(mask) entries, so
+// the rook table is 102400 entries and the bishop table 5248 instead of 64 * 4096 and 64 * 512. The slice is indexed
+// by pext(occupancy, mask) on the PEXT path and by ((occupancy & mask) * magic) >> shift on the magic path; both
+// produce indices below 2^popcount(mask), so the layout is shared and only the order within a slice differs. The
+// tables are refilled in the selected order whenever the implementation changes.
+// The magics come from tools/magic/magicgen.
+struct SliderMagic {
+    Bitboard mask;
+    std::uint64_t magic;
+    Bitboard* attacks;
+    unsigned int shift;
+
+    unsigned int MagicIndex(Bitboard occupancy) const {
+        return (unsigned int)(((occupancy & mask) * magic) >> shift);
+    }
+
+#ifdef USE_PEXT
+    // Compiled for BMI2 without enabling it for the whole program, only called when the CPU supports it
+    __attribute__((target("bmi2"))) unsigned int PextIndex(Bitboard occupancy) const {
+        return (unsigned int)_pext_u64(occupancy, mask);
+    }
+#endif
+};
+
+static constexpr std::uint64_t ROOK_MAGICS[64] = {
+    0x0280088051a0c000ULL, 0x0040001000200042ULL, 0x02002080400a0010ULL, 0x6500100088042100ULL,
+    0x0100020800041100ULL, 0x2200020005449018ULL, 0xa080010000800200ULL, 0xca0001840c420123ULL,
+    0x0300802040008000ULL, 0x0010804000802000ULL, 0x2021802001100082ULL, 0x0020801000840802ULL,
+    0x2201000500120800ULL, 0x100300080b000400ULL, 0x3806800600170080ULL, 0x8002000100820044ULL,
+    0x8000818000400020ULL, 0x0208810030400100ULL, 0x4000888020021000ULL, 0x1800090020100100ULL,
+    0x0040050011000800ULL, 0x0249010002040008ULL, 0x1000440010080102ULL, 0x400206000508a844ULL,
+    0x0010800280244000ULL, 0x0108200440005000ULL, 0x000901c100142004ULL, 0x0010880280100080ULL,
+    0x0216080080040080ULL, 0x9002020080040080ULL, 0x0002000200040801ULL, 0x0212005200140081ULL,
+    0x6680614002800186ULL, 0x4220004000802080ULL, 0x0100110041002001ULL, 0x44c0801002800801ULL,
+    0x0865000801000410ULL, 0x0002000400800280ULL, 0x0000821004002841ULL, 0x0000800040800100ULL,
+    0x0240800040008020ULL, 0x4010420900820021ULL, 0x0020010220490010ULL, 0xa008008010028008ULL,
+    0x80220004508a0020ULL, 0x2000020004008080ULL, 0x9c00010802040010ULL, 0x04010000a0410012ULL,
+    0x84008000c300e500ULL, 0x0042004020810200ULL, 0x0020001000882080ULL, 0x8005100080480180ULL,
+    0x0818040080080080ULL, 0x2004010040020040ULL, 0x0000080250010400ULL, 0x002008440118a200ULL,
+    0x1006028111006042ULL, 0x0040204000810011ULL, 0x0300100a00204082ULL, 0x4042000410200842ULL,
+    0x2002000820041002ULL, 0x0812004804011082ULL, 0xa6005001120800a4ULL, 0x04081900840022c2ULL,
+};
+static constexpr std::uint64_t BISHOP_MAGICS[64] = {
+    0x0010024204002201ULL, 0x0004448444019841ULL, 0x0008024400209042ULL, 0x00220a0208110420ULL,
+    0x1008484012061020ULL, 0x91c104200400001cULL, 0x0020441004111618ULL, 0x0621208804112002ULL,
+    0x000004a142041102ULL, 0x8000101000a10040ULL, 0x0800420086008801ULL, 0x0000240401970000ULL,
+    0x0010a42420041000ULL, 0x820020921040000cULL, 0x0021820110029001ULL, 0x2010103401041000ULL,
+    0xc020200504440800ULL, 0x4404811050008100ULL, 0x0510020200320020ULL, 0x000409880c109020ULL,
+    0x024401821120040cULL, 0x0041000190080120ULL, 0x200c030904018402ULL, 0x0020530100480400ULL,
+    0x4620132844100202ULL, 0x1c1002400808c100ULL, 0x2604300002040040ULL, 0x0004004004010002ULL,
+    0x0101001011004010ULL, 0x0030040818410801ULL, 0x0100b08904040401ULL, 0x0841002409008801ULL,
+    0x000804044e112050ULL, 0x4018010800108208ULL, 0x8100140202100088ULL, 0x0006020080080080ULL,
+    0x8060008400088021ULL, 0x18100220200a0084ULL, 0x28900101004200a0ULL, 0x00041c008022228cULL,
+    0x0008380288041000ULL, 0x0300823010108200ULL, 0x300a020822000400ULL, 0x1020002214084800ULL,
+    0x3000408810401202ULL, 0x2040013204080080ULL, 0x2044100408600102ULL, 0x0030110d20240100ULL,
+    0x0184044402080080ULL, 0x0080848818021000ULL, 0x8004002201102088ULL, 0x1e011000420202c0ULL,
+    0x0049200910240030ULL, 0x0430101410043002ULL, 0x0804610802008000ULL, 0x0084041084010880ULL,
+    0x280a048c84012001ULL, 0x0100102108021004ULL, 0x00b1008092481811ULL, 0x0081000811040910ULL,
+    0x0200080830520884ULL, 0x000400c011020084ULL, 0x00304204040c2840ULL, 0x100410a401040010ULL,
+};
+
+static constexpr int ROOK_TABLE_SIZE = 102400;
+static constexpr int BISHOP_TABLE_SIZE = 5248;
+static constexpr int rookDirections[4][2] = { {0, 1}, {0, -1}, {1, 0}, {-1, 0} }; // {file, rank}
+static constexpr int bishopDirections[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+
+static Bitboard rookTable[ROOK_TABLE_SIZE];
+static Bitboard bishopTable[BISHOP_TABLE_SIZE];
+
+static Bitboard GenSlidingAttack(const int (&directions)[4][2], Square square, Bitboard occupancy) {
+    Bitboard attacks = 0;
+    for (const auto& direction : directions) {
+        int file = square % 8 + direction[0];
+        int rank = square / 8 + direction[1];
+        while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+            Bitboard sBB = ToBitboard(rank * 8 + file);
+            attacks |= sBB;
+            if (occupancy & sBB) {
+                break;
+            }
+            file += direction[0];
+            rank += direction[1];
+        }
+    }
+    return attacks;
+}
+
+template<std::size_t tableSize>
+static std::array<SliderMagic, 64> GenSliderMagics(const int (&directions)[4][2], const std::uint64_t (&magics)[64],
+                                                   Bitboard (&table)[tableSize]) {
+    std::array<SliderMagic, 64> sliderMagics{};
+    Bitboard* slice = table;
+    for (Square square = 0; square < 64; square++) {
+        // Edge squares never block anything further along the ray, so leave them out of the mask unless the
+        // slider itself stands on that edge
+        Bitboard edges = ((RANK_MASK[0] | RANK_MASK[7]) & ~RANK_MASK[square / 8]) |
+                         ((FILE_MASK[0] | FILE_MASK[7]) & ~FILE_MASK[square % 8]);
+        SliderMagic& sliderMagic = sliderMagics[square];
+        sliderMagic.mask = GenSlidingAttack(directions, square, 0) & ~edges;
+        sliderMagic.magic = magics[square];
+        sliderMagic.attacks = slice;
+        sliderMagic.shift = 64 - std::popcount(sliderMagic.mask);
+        slice += (std::size_t)1 << std::popcount(sliderMagic.mask);
+    }
+    assert(slice == table + tableSize);
+    return sliderMagics;
+}
+
+static const std::array<SliderMagic, 64> rookMagics = GenSliderMagics(rookDirections, ROOK_MAGICS, rookTable);
+static const std::array<SliderMagic, 64> bishopMagics = GenSliderMagics(bishopDirections, BISHOP_MAGICS, bishopTable);
+
+static void FillSliderTables(const int (&directions)[4][2], const std::array<SliderMagic, 64>& sliderMagics,
+                             SliderAttackImpl impl) {
+    for (Square square = 0; square < 64; square++) {
+        const SliderMagic& sliderMagic = sliderMagics[square];
+        Bitboard occupancy = 0;
+        do {
 #ifdef USE_PEXT
-    std::uint64_t idx = _pext_u64(occupancy, rookMask[square]);
-    return rookAttacks[square][idx];
+            unsigned int idx = impl == SliderAttackImpl::Pext ? sliderMagic.PextIndex(occupancy)
+                                                              : sliderMagic.MagicIndex(occupancy);
 #else
-    std::uint64_t magic = rookMagic[square];
-    Bitboard mask = occupancy & rookMask[square];
-    const unsigned int rookAttackIdx = (mask * magic) >> 52; 
-    return rookAttacks[square][rookAttackIdx];
+            unsigned int idx = sliderMagic.MagicIndex(occupancy);
 #endif
+            sliderMagic.attacks[idx] = GenSlidingAttack(directions, square, occupancy);
+            occupancy = (occupancy - sliderMagic.mask) & sliderMagic.mask; // next subset of mask (Carry-Rippler)
+        } while (occupancy);
+    }
+}
+
+static Bitboard RookAttackMagic(Square square, Bitboard occupancy) {
+    const SliderMagic& sliderMagic = rookMagics[square];
+    return sliderMagic.attacks[sliderMagic.MagicIndex(occupancy)];
+}
+
+static Bitboard BishopAttackMagic(Square square, Bitboard occupancy) {
+    const SliderMagic& sliderMagic = bishopMagics[square];
+    return sliderMagic.attacks[sliderMagic.MagicIndex(occupancy)];
 }
 
-Bitboard BishopAttack(Square square, Bitboard occupancy) {
 #ifdef USE_PEXT
-    std::uint64_t idx = _pext_u64(occupancy, bishopMask[square]);
-    return bishopAttacks[square][idx];
+__attribute__((target("bmi2"))) static Bitboard RookAttackPext(Square square, Bitboard occupancy) {
+    const SliderMagic& sliderMagic = rookMagics[square];
+    return sliderMagic.attacks[sliderMagic.PextIndex(occupancy)];
+}
+
+__attribute__((target("bmi2"))) static Bitboard BishopAttackPext(Square square, Bitboard occupancy) {
+    const SliderMagic& sliderMagic = bishopMagics[square];
+    return sliderMagic.attacks[sliderMagic.PextIndex(occupancy)];
+}
+#endif
+
+Bitboard (*RookAttack)(Square square, Bitboard occupancy) = RookAttackMagic;
+Bitboard (*BishopAttack)(Square square, Bitboard occupancy) = BishopAttackMagic;
+static SliderAttackImpl sliderAttackImpl = SliderAttackImpl::Magic;
+
+SliderAttackImpl DefaultSliderAttackImpl() {
+#ifdef USE_PEXT
+    if (GetCpuFeatures().fastPext) {
+        return SliderAttackImpl::Pext;
+    }
+#endif
+    return SliderAttackImpl::Magic;
+}
+
+bool SetSliderAttackImpl(SliderAttackImpl impl) {
+    if (impl == SliderAttackImpl::Pext) {
+#ifdef USE_PEXT
+        if (!GetCpuFeatures().bmi2) {
+            return false;
+        }
+        RookAttack = RookAttackPext;
+        BishopAttack = BishopAttackPext;
 #else
-    std::uint64_t magic = bishopMagic[square];
-    Bitboard mask = occupancy & bishopMask[square];
-    const unsigned int bishopAttackIdx = (mask * magic) >> 55; 
-    return bishopAttacks[square][bishopAttackIdx];
+        return false;
 #endif
+    }
+    else {
+        RookAttack = RookAttackMagic;
+        BishopAttack = BishopAttackMagic;
+    }
+    FillSliderTables(rookDirections, rookMagics, impl);
+    FillSliderTables(bishopDirections, bishopMagics, impl);
+    sliderAttackImpl = impl;
+    return true;
+}
+
+SliderAttackImpl GetSliderAttackImpl() {
+    return sliderAttackImpl;
+}
+
+const char* SliderAttackImplName(SliderAttackImpl impl) {
+    return impl == SliderAttackImpl::Pext ? "Pext" : "Magic";
 }
 
+// Fill the tables before main so every lookup is valid, the UCI option can switch later
+[[maybe_unused]] static const bool sliderAttacksInitialized = SetSliderAttackImpl(DefaultSliderAttackImpl());
+
 Bitboard QueenAttack(Square square, Bitboard occupancy) {
     return RookAttack(square, occupancy) | BishopAttack(square, occupancy);
 }
+
+Bitboard KnightAttacks(Bitboard knights) {
+    Bitboard left1 = (knights >> 1) & ~FILE_MASK[7];
+    Bitboard left2 = (knights >> 2) & ~(FILE_MASK[6] | FILE_MASK[7]);
+    Bitboard right1 = (knights << 1) & ~FILE_MASK[0];
+    Bitboard right2 = (knights << 2) & ~(FILE_MASK[0] | FILE_MASK[1]);
+    Bitboard horizontal1 = left1 | right1;
+    Bitboard horizontal2 = left2 | right2;
+    return (horizontal1 << 16) | (horizontal1 >> 16) | (horizontal2 << 8) | (horizontal2 >> 8);
+}
+
+// Ray directions split by shift sign so each group of four shares one shift instruction: {north, east, north east,
+// north west} shift left and {south, west, south west, south east} shift right, by {8, 1, 9, 7} in both cases.
+// The masks drop bits that wrapped around to the other side of the board.
+static constexpr int rayShifts[4] = { 8, 1, 9, 7 };
+static constexpr Bitboard leftRayMasks[4] = { ~0ULL, ~FILE_MASK[0], ~FILE_MASK[0], ~FILE_MASK[7] };
+static constexpr Bitboard rightRayMasks[4] = { ~0ULL, ~FILE_MASK[7], ~FILE_MASK[7], ~FILE_MASK[0] };
+
+// Kogge-Stone occluded fill: smears the generators along the ray through empty squares in three doubling steps, then
+// shifts once more so the first blocker is included and the generators themselves are not
+static Bitboard LeftRayAttacks(Bitboard generators, Bitboard empty, int shift, Bitboard mask) {
+    Bitboard propagators = empty & mask;
+    generators |= propagators & (generators << shift);
+    propagators &= propagators << shift;
+    generators |= propagators & (generators << (shift * 2));
+    propagators &= propagators << (shift * 2);
+    generators |= propagators & (generators << (shift * 4));
+    return (generators << shift) & mask;
+}
+
+static Bitboard RightRayAttacks(Bitboard generators, Bitboard empty, int shift, Bitboard mask) {
+    Bitboard propagators = empty & mask;
+    generators |= propagators & (generators >> shift);
+    propagators &= propagators >> shift;
+    generators |= propagators & (generators >> (shift * 2));
+    propagators &= propagators >> (shift * 2);
+    generators |= propagators & (generators >> (shift * 4));
+    return (generators >> shift) & mask;
+}
+
+static SliderAttacks SetwiseSliderAttacksScalar(Bitboard bishops, Bitboard rooks, Bitboard queens, Bitboard occupancy) {
+    const Bitboard empty = ~occupancy;
+    SliderAttacks attacks{};
+    for (int i = 0; i < 4; i++) {
+        Bitboard& pieceAttacks = i < 2 ? attacks.rooks : attacks.bishops;
+        Bitboard pieces = i < 2 ? rooks : bishops;
+        pieceAttacks |= LeftRayAttacks(pieces, empty, rayShifts[i], leftRayMasks[i]) |
+                        RightRayAttacks(pieces, empty, rayShifts[i], rightRayMasks[i]);
+        attacks.queens |= LeftRayAttacks(queens, empty, rayShifts[i], leftRayMasks[i]) |
+                          RightRayAttacks(queens, empty, rayShifts[i], rightRayMasks[i]);
+    }
+    return attacks;
+}
+
+#ifdef USE_AVX2
+// Same fills as above with the four directions of a shift sign in the four 64-bit lanes of one register
+struct Avx2Rays {
+    __m256i shift1, shift2, shift4, mask;
+};
+
+__attribute__((target("avx2"))) static __m256i LeftRayAttacksAvx2(__m256i generators, __m256i empty, const Avx2Rays& rays) {
+    __m256i propagators = _mm256_and_si256(empty, rays.mask);
+    generators = _mm256_or_si256(generators, _mm256_and_si256(propagators, _mm256_sllv_epi64(generators, rays.shift1)));
+    propagators = _mm256_and_si256(propagators, _mm256_sllv_epi64(propagators, rays.shift1));
+    generators = _mm256_or_si256(generators, _mm256_and_si256(propagators, _mm256_sllv_epi64(generators, rays.shift2)));
+    propagators = _mm256_and_si256(propagators, _mm256_sllv_epi64(propagators, rays.shift2));
+    generators = _mm256_or_si256(generators, _mm256_and_si256(propagators, _mm256_sllv_epi64(generators, rays.shift4)));
+    return _mm256_and_si256(_mm256_sllv_epi64(generators, rays.shift1), rays.mask);
+}
+
+__attribute__((target("avx2"))) static __m256i RightRayAttacksAvx2(__m256i generators, __m256i empty, const Avx2Rays& rays) {
+    __m256i propagators = _mm256_and_si256(empty, rays.mask);
+    generators = _mm256_or_si256(generators, _mm256_and_si256(propagators, _mm256_srlv_epi64(generators, rays.shift1)));
+    propagators = _mm256_and_si256(propagators, _mm256_srlv_epi64(propagators, rays.shift1));
+    generators = _mm256_or_si256(generators, _mm256_and_si256(propagators, _mm256_srlv_epi64(generators, rays.shift2)));
+    propagators = _mm256_and_si256(propagators, _mm256_srlv_epi64(propagators, rays.shift2));
+    generators = _mm256_or_si256(generators, _mm256_and_si256(propagators, _mm256_srlv_epi64(generators, rays.shift4)));
+    return _mm256_and_si256(_mm256_srlv_epi64(generators, rays.shift1), rays.mask);
+}
+
+__attribute__((target("avx2"))) static SliderAttacks SetwiseSliderAttacksAvx2(Bitboard bishops, Bitboard rooks,
+                                                                              Bitboard queens, Bitboard occupancy) {
+    const __m256i shift1 = _mm256_setr_epi64x(rayShifts[0], rayShifts[1], rayShifts[2], rayShifts[3]);
+    const Avx2Rays leftRays = {
+        shift1, _mm256_add_epi64(shift1, shift1), _mm256_slli_epi64(shift1, 2),
+        _mm256_setr_epi64x(leftRayMasks[0], leftRayMasks[1], leftRayMasks[2], leftRayMasks[3])
+    };
+    const Avx2Rays rightRays = {
+        leftRays.shift1, leftRays.shift2, leftRays.shift4,
+        _mm256_setr_epi64x(rightRayMasks[0], rightRayMasks[1], rightRayMasks[2], rightRayMasks[3])
+    };
+    const __m256i empty = _mm256_set1_epi64x(~occupancy);
+
+    // Rooks in the orthogonal lanes and bishops in the diagonal lanes share one register, queens fill all four
+    const __m256i rooksAndBishops = _mm256_setr_epi64x(rooks, rooks, bishops, bishops);
+    const __m256i queensInAllLanes = _mm256_set1_epi64x(queens);
+    __m256i rookBishopAttacks = _mm256_or_si256(LeftRayAttacksAvx2(rooksAndBishops, empty, leftRays),
+                                                RightRayAttacksAvx2(rooksAndBishops, empty, rightRays));
+    __m256i queenAttacks = _mm256_or_si256(LeftRayAttacksAvx2(queensInAllLanes, empty, leftRays),
+                                           RightRayAttacksAvx2(queensInAllLanes, empty, rightRays));
+
+    alignas(32) Bitboard rookBishopLanes[4];
+    alignas(32) Bitboard queenLanes[4];
+    _mm256_store_si256((__m256i*)rookBishopLanes, rookBishopAttacks);
+    _mm256_store_si256((__m256i*)queenLanes, queenAttacks);
+    return SliderAttacks{
+        .bishops = rookBishopLanes[2] | rookBishopLanes[3],
+        .rooks = rookBishopLanes[0] | rookBishopLanes[1],
+        .queens = queenLanes[0] | queenLanes[1] | queenLanes[2] | queenLanes[3]
+    };
+}
+#endif
+
+SliderAttacks (*SetwiseSliderAttacks)(Bitboard bishops, Bitboard rooks, Bitboard queens, Bitboard occupancy) = SetwiseSliderAttacksScalar;
+static SetwiseAttackImpl setwiseAttackImpl = SetwiseAttackImpl::Scalar;
+
+SetwiseAttackImpl DefaultSetwiseAttackImpl() {
+#ifdef USE_AVX2
+    if (GetCpuFeatures().avx2) {
+        return SetwiseAttackImpl::Avx2;
+    }
+#endif
+    return SetwiseAttackImpl::Scalar;
+}
+
+bool SetSetwiseAttackImpl(SetwiseAttackImpl impl) {
+    if (impl == SetwiseAttackImpl::Avx2) {
+#ifdef USE_AVX2
+        if (!GetCpuFeatures().avx2) {
+            return false;
+        }
+        SetwiseSliderAttacks = SetwiseSliderAttacksAvx2;
+#else
+        return false;
+#endif
+    }
+    else {
+        SetwiseSliderAttacks = SetwiseSliderAttacksScalar;
+    }
+    setwiseAttackImpl = impl;
+    return true;
+}
+
+SetwiseAttackImpl GetSetwiseAttackImpl() {
+    return setwiseAttackImpl;
+}
+
+const char* SetwiseAttackImplName(SetwiseAttackImpl impl) {
+    return impl == SetwiseAttackImpl::Avx2 ? "Avx2" : "Scalar";
+}
+
+[[maybe_unused]] static const bool setwiseAttacksInitialized = SetSetwiseAttackImpl(DefaultSetwiseAttackImpl());
@@ -6,6 +6,39 @@
 extern std::array<Bitboard, 64> knightAttacks;
 extern std::array<std::array<Bitboard, 64>, 2> pawnAttacks; // [color][square]
 extern std::array<Bitboard, 64> kingAttacks;
-Bitboard RookAttack(Square square, Bitboard occupancy);
-Bitboard BishopAttack(Square square, Bitboard occupancy);
+
+enum class SliderAttackImpl : std::uint8_t { Magic, Pext };
+
+// Slider lookups go through these pointers so the implementation can be picked at runtime (see SetSliderAttackImpl)
+extern Bitboard (*RookAttack)(Square square, Bitboard occupancy);
+extern Bitboard (*BishopAttack)(Square square, Bitboard occupancy);
 Bitboard QueenAttack(Square square, Bitboard occupancy);
+
+// Fastest implementation the CPU supports: PEXT where it is implemented in hardware, magic multiplication otherwise
+SliderAttackImpl DefaultSliderAttackImpl();
+// Refills the attack tables for impl and switches the lookups over. Returns false, leaving everything unchanged, if
+// impl is not compiled in or not supported by the CPU. Must not be called while a search is running.
+bool SetSliderAttackImpl(SliderAttackImpl impl);
+SliderAttackImpl GetSliderAttackImpl();
+const char* SliderAttackImplName(SliderAttackImpl impl);
+
+// Set-wise attacks: every square attacked by any piece of a set, computed for all pieces at once instead of one
+// lookup per piece. Meant for evaluation (see AttackInfo), move generation keeps the per-square lookups above.
+Bitboard KnightAttacks(Bitboard knights);
+
+struct SliderAttacks {
+    Bitboard bishops;
+    Bitboard rooks;
+    Bitboard queens;
+};
+
+enum class SetwiseAttackImpl : std::uint8_t { Scalar, Avx2 };
+
+// Kogge-Stone occluded fills along the eight ray directions, four directions per AVX2 register when available
+extern SliderAttacks (*SetwiseSliderAttacks)(Bitboard bishops, Bitboard rooks, Bitboard queens, Bitboard occupancy);
+
+SetwiseAttackImpl DefaultSetwiseAttackImpl();
+// Returns false, leaving the current implementation, if impl is not supported by the CPU
+bool SetSetwiseAttackImpl(SetwiseAttackImpl impl);
+SetwiseAttackImpl GetSetwiseAttackImpl();
+const char* SetwiseAttackImplName(SetwiseAttackImpl impl);
@@ -0,0 +1,34 @@
+#include "attack_info.h"
+#include "attack_bitboards.h"
+
+template<Color color>
+AttackInfo ComputeAttackInfo(const Board& board) {
+    AttackInfo info{};
+    auto addAttacks = [&info](PieceType type, Bitboard attacks) {
+        info.byType[(int)type] = attacks;
+        info.twice |= info.all & attacks;
+        info.all |= attacks;
+    };
+
+    constexpr int leftCaptureOffset = color == White ? 7 : -9;
+    constexpr int rightCaptureOffset = color == White ? 9 : -7;
+    const Bitboard pawns = board.Pawns(color);
+    const Bitboard leftPawnAttacks = Shift<leftCaptureOffset>(pawns) & ~FILE_MASK[7];
+    const Bitboard rightPawnAttacks = Shift<rightCaptureOffset>(pawns) & ~FILE_MASK[0];
+    info.twice = leftPawnAttacks & rightPawnAttacks;
+    addAttacks(PieceType::Pawn, leftPawnAttacks | rightPawnAttacks);
+
+    addAttacks(PieceType::Knight, KnightAttacks(board.Knights(color)));
+
+    SliderAttacks sliderAttacks = SetwiseSliderAttacks(board.Bishops(color), board.Rooks(color), board.Queens(color),
+                                                       board.Occupancy());
+    addAttacks(PieceType::Bishop, sliderAttacks.bishops);
+    addAttacks(PieceType::Rook, sliderAttacks.rooks);
+    addAttacks(PieceType::Queen, sliderAttacks.queens);
+
+    addAttacks(PieceType::King, kingAttacks[LSB(board.Kings(color))]);
+    return info;
+}
+
+template AttackInfo ComputeAttackInfo<White>(const Board& board);
+template AttackInfo ComputeAttackInfo<Black>(const Board& board);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "board.h"
+
+// Everything one side attacks, computed once per evaluation with set-wise attacks and shared by the eval terms that
+// need attack maps, instead of each term looking attacks up piece by piece.
+struct AttackInfo {
+    Bitboard byType[6]; // indexed by PieceType, squares attacked by any piece of that type
+    Bitboard all;       // squares attacked by anything
+    Bitboard twice;     // squares attacked by at least two pieces of different types, or by two pawns
+};
+
+template<Color color> AttackInfo ComputeAttackInfo(const Board& board);
@@ -0,0 +1,71 @@
+#include "bench.h"
+#include "attack_bitboards.h"
+#include "board.h"
+#include "fen.h"
+#include "movegen.h"
+#include "perft.h"
+#include "search.h"
+#include "transposition.h"
+#include "utilities.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+namespace {
+
+struct BenchPosition {
+    const char* fen;
+    int perftDepth;
+};
+
+constexpr BenchPosition benchPositions[] = {
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5 },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4 },
+    { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5 },
+    { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4 },
+    { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4 },
+    { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4 },
+    { "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1Q1PPP/R3KB1R w KQ - 0 9", 4 },
+    { "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1", 5 },
+};
+
+double ElapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+void Bench(int searchDepth) {
+    std::uint64_t perftNodes = 0;
+    double perftSeconds = 0.0;
+    std::uint64_t totalSearchNodes = 0;
+    double searchSeconds = 0.0;
+
+    std::cout << "Slider attacks: " << SliderAttackImplName(GetSliderAttackImpl()) << "\n";
+    for (const BenchPosition& position : benchPositions) {
+        Fen fen = ParseFen(position.fen);
+
+        Board board = fen.board;
+        maxDepth = position.perftDepth;
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t nodes = perftest(board, position.perftDepth, fen.colorToMove);
+        perftSeconds += ElapsedSeconds(start);
+        perftNodes += nodes;
+
+        transpositionTable.Clear();
+        searchHistory->Clear();
+        threefoldRepetitionTable.clear();
+        start = std::chrono::steady_clock::now();
+        Move bestMove = Search(fen.board, fen.colorToMove, SearchLimits{ .depth = searchDepth }, false);
+        searchSeconds += ElapsedSeconds(start);
+        totalSearchNodes += searchNodes;
+
+        std::cout << position.fen << "\n    perft " << position.perftDepth << ": " << nodes
+                  << "  search " << searchDepth << ": bestmove " << MoveToUCINotation(bestMove) << " nodes " << searchNodes << '\n';
+    }
+
+    std::cout << "\nPerft nodes: " << perftNodes << "  time: " << (int)(perftSeconds * 1000) << " ms  nps: "
+              << (std::uint64_t)(perftNodes / perftSeconds) << '\n';
+    std::cout << "Search nodes: " << totalSearchNodes << "  time: " << (int)(searchSeconds * 1000) << " ms  nps: "
+              << (std::uint64_t)(totalSearchNodes / searchSeconds) << std::endl;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Fixed workload for comparing builds and search changes: perft plus fixed-depth searches over a set of positions.
+// The total search node count doubles as a signature of search behavior.
+void Bench(int searchDepth);
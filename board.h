@@ -1,9 +1,11 @@
 #pragma once
 
+#include <array>
 #include <bit>
 #include <cassert>
 #include <cstdint>
 #include <span>
+#include <type_traits>
 
 
 enum class Rank : std::uint8_t {
@@ -36,6 +38,27 @@ static constexpr int COLOR_OFFSET[2] = { 0, 6 }; // Matches order of Color enum
 static constexpr int COUNT_BITBOARDS = 12;
 static constexpr Square STARTING_KING_SQUARE[2] = { 4, 60 };
 
+// Castling rights are a 4 bit mask. Bit layout matches the index into ZOBRIST_KEYS.castlingRights.
+static constexpr std::uint8_t SHORT_CASTLING_RIGHT[2] = { 1 << 3, 1 << 2 };
+static constexpr std::uint8_t LONG_CASTLING_RIGHT[2] = { 1 << 1, 1 };
+static constexpr std::uint8_t ALL_CASTLING_RIGHTS = 0xF;
+
+static constexpr std::array<std::uint8_t, 64> GenCastlingRightsMask() {
+    std::array<std::uint8_t, 64> mask{};
+    mask.fill(ALL_CASTLING_RIGHTS);
+    mask[0] &= ~LONG_CASTLING_RIGHT[0];
+    mask[7] &= ~SHORT_CASTLING_RIGHT[0];
+    mask[4] &= ~(LONG_CASTLING_RIGHT[0] | SHORT_CASTLING_RIGHT[0]);
+    mask[56] &= ~LONG_CASTLING_RIGHT[1];
+    mask[63] &= ~SHORT_CASTLING_RIGHT[1];
+    mask[60] &= ~(LONG_CASTLING_RIGHT[1] | SHORT_CASTLING_RIGHT[1]);
+    return mask;
+}
+
+// castlingRights &= CASTLING_RIGHTS_MASK[from] & CASTLING_RIGHTS_MASK[to] updates the rights for any move:
+// moving the king or a rook off its starting square, or capturing a rook on its starting square, clears them.
+static constexpr std::array<std::uint8_t, 64> CASTLING_RIGHTS_MASK = GenCastlingRightsMask();
+
 static constexpr Bitboard RANK_MASK[8] = { 0xFFULL, 0xFFULL << 8, 0xFFULL << 16, 0xFFULL << 24, 0xFFULL << 32, 0xFFULL << 40, 0xFFULL << 48, 0xFFULL << 56 };
 static constexpr Bitboard PROMOTION_RANK_MASK[2] = { (Bitboard)0xFF << 56, (Bitboard)0xFF };
 // TODO: finish file mask and use for pawn attack gen
@@ -67,15 +90,33 @@ enum Color {
     White, Black
 };
 
-inline Color ToggleColor(Color color) {
+constexpr Color ToggleColor(Color color) {
     return Color(1 - color);
 }
 
+// Shifts by a compile-time signed offset, e.g. a pawn push of +8 for white and -8 for black
+template<int offset>
+constexpr Bitboard Shift(Bitboard b) {
+    if constexpr (offset >= 0) {
+        return b << offset;
+    }
+    else {
+        return b >> -offset;
+    }
+}
+
 struct Piece {
     PieceType type;
     Color color; 
 };
 
+// Board::mailbox entries pack a piece as type | color << 3. An empty square holds PieceType::None (and reads as white).
+static constexpr std::uint8_t EMPTY_SQUARE = (std::uint8_t)PieceType::None;
+
+static constexpr std::uint8_t ToMailboxPiece(PieceType type, Color color) {
+    return (std::uint8_t)type | (std::uint8_t)(color << 3);
+}
+
 struct Board {
     union {
         struct {
@@ -98,30 +139,30 @@ struct Board {
         Bitboard bitboards[COUNT_BITBOARDS];
     };
 
+    // Redundant with the bitboards, kept in sync by AddPiece/RemovePiece/Move/PromotePawn. Write pieces through those
+    // rather than to the bitboards directly.
+    std::array<std::uint8_t, 64> mailbox;
+    Bitboard colorOccupancy[2];
+
     Square enPassant = -1;
     // These only indicate if the king and corresponding rook have moved,
     // not if castling is currently possible (intermediate squares clear/unattacked).
-    bool shortCastlingRight[2] = { true, true };
-    bool longCastlingRight[2] = { true,  true };
+    std::uint8_t castlingRights = ALL_CASTLING_RIGHTS;
 
-    void RemoveCastlingRights(Color color) {
-        shortCastlingRight[color] = false;
-        longCastlingRight[color] = false;
-    }
+    bool ShortCastlingRight(Color color) const { return castlingRights & SHORT_CASTLING_RIGHT[color]; }
+    bool LongCastlingRight(Color color) const { return castlingRights & LONG_CASTLING_RIGHT[color]; }
 
-    Bitboard WhiteOccupancy() const {
-        return whitePawns | whiteKnights | whiteBishops | whiteRooks | whiteQueens | whiteKing;
-    }
-
-    Bitboard BlackOccupancy() const {
-        return blackPawns | blackKnights | blackBishops | blackRooks | blackQueens | blackKing;
+    void RemoveCastlingRights(Color color) {
+        castlingRights &= ~(SHORT_CASTLING_RIGHT[color] | LONG_CASTLING_RIGHT[color]);
     }
 
-    Bitboard Occupancy(Color color) const {
-        return color == Color::White ? WhiteOccupancy() : BlackOccupancy(); 
-    }
+    Bitboard WhiteOccupancy() const { return colorOccupancy[White]; }
+    Bitboard BlackOccupancy() const { return colorOccupancy[Black]; }
+    Bitboard Occupancy(Color color) const { return colorOccupancy[color]; }
+    Bitboard Occupancy() const { return colorOccupancy[White] | colorOccupancy[Black]; }
 
-    Bitboard Occupancy() const { return WhiteOccupancy() | BlackOccupancy(); }
+    PieceType PieceTypeAt(Square square) const { return PieceType(mailbox[square] & 0x7); }
+    Piece PieceAt(Square square) const { return { PieceTypeAt(square), Color(mailbox[square] >> 3) }; }
 
     Bitboard EmptySquares() const { return ~Occupancy(); }
 
@@ -151,15 +192,49 @@ struct Board {
     Bitboard Queens(Color c) const { return bitboards[QUEEN_OFFSET + COLOR_OFFSET[c]]; }
     Bitboard Kings(Color c) const { return bitboards[KING_OFFSET + COLOR_OFFSET[c]]; }
 
+    void AddPiece(PieceType type, Color c, Square square) {
+        Bitboard squareBB = ToBitboard(square);
+        bitboards2D[c][(int)type] |= squareBB;
+        colorOccupancy[c] |= squareBB;
+        mailbox[square] = ToMailboxPiece(type, c);
+    }
+
+    void RemovePiece(PieceType type, Color c, Square square) {
+        Bitboard squareBB = ToBitboard(square);
+        bitboards2D[c][(int)type] &= ~squareBB;
+        colorOccupancy[c] &= ~squareBB;
+        mailbox[square] = EMPTY_SQUARE;
+    }
+
+    // to must be empty; remove a captured piece first
     void Move(PieceType type, Color c, Square from, Square to) {
-        bitboards[(int)type + COLOR_OFFSET[c]] &= ~ToBitboard(from);
-        bitboards[(int)type + COLOR_OFFSET[c]] |= ToBitboard(to);
+        Bitboard fromToBB = ToBitboard(from) | ToBitboard(to);
+        bitboards2D[c][(int)type] ^= fromToBB;
+        colorOccupancy[c] ^= fromToBB;
+        mailbox[to] = mailbox[from];
+        mailbox[from] = EMPTY_SQUARE;
     }
     
     void PromotePawn(PieceType promotionType, Color c, Square square) {
         Bitboard squareBB = ToBitboard(square);
         bitboards2D[c][(int)PieceType::Pawn] &= ~squareBB;
         bitboards2D[c][(int)promotionType] |= squareBB;
+        mailbox[square] = ToMailboxPiece(promotionType, c);
+    }
+
+    // Rebuilds mailbox and colorOccupancy from the piece bitboards
+    void RefreshCaches() {
+        mailbox.fill(EMPTY_SQUARE);
+        colorOccupancy[White] = colorOccupancy[Black] = 0;
+        for (int c = White; c <= Black; c++) {
+            for (int type = 0; type < 6; type++) {
+                Bitboard bb = bitboards2D[c][type];
+                colorOccupancy[c] |= bb;
+                while (bb) {
+                    mailbox[PopLSB(bb)] = ToMailboxPiece(PieceType(type), Color(c));
+                }
+            }
+        }
     }
 
     bool operator==(const Board& other) const {
@@ -176,10 +251,7 @@ struct Board {
                blackQueens == other.blackQueens &&
                blackKing == other.blackKing &&
                enPassant == other.enPassant &&
-               shortCastlingRight[White] == other.shortCastlingRight[White] &&
-               shortCastlingRight[Black] == other.shortCastlingRight[Black] &&
-               longCastlingRight[White] == other.longCastlingRight[White] &&
-               longCastlingRight[Black] == other.longCastlingRight[Black];
+               castlingRights == other.castlingRights;
     }
     bool operator!=(const Board& other) const {
         return !(*this == other);
@@ -215,5 +287,8 @@ struct Board {
             blackKing = 0;
             enPassant = -1;
         }
+        RefreshCaches();
     }
 };
+// Copy-make (FARIS_COPY_MAKE) relies on positions being plain memcpy-able values
+static_assert(std::is_trivially_copyable_v<Board>);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "board.h"
+#include "mapped_file.h"
+#include "movegen.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Polyglot opening books (.bin): a file of 16 byte big-endian entries {key, move, weight, learn} sorted by key,
+// where key is the Polyglot Zobrist hash of the position. The file is memory mapped and searched in place, so
+// opening a book costs nothing and a lookup is a binary search plus one move generation.
+
+// Polyglot's own Zobrist hash, unrelated to TT::Hash. En passant only counts when a pawn of the side to move could
+// actually capture.
+std::uint64_t PolyglotKey(const Board& board, Color colorToMove);
+
+struct BookMove {
+    Move move;
+    std::uint16_t weight;
+};
+
+struct OpeningBook {
+    // Replaces the current book; false if the file can't be read or isn't a whole number of entries
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return file.Size() > 0; }
+    // Legal book moves for the position in file order. Entries that don't decode to a legal move are skipped.
+    std::vector<BookMove> Moves(const Board& board, Color colorToMove) const;
+    // Picks one of Moves at random, proportionally to weight. False if the position isn't in the book.
+    bool Probe(const Board& board, Color colorToMove, Move& move);
+
+    std::mt19937_64 rng{std::random_device{}()};
+
+private:
+    MappedFile file;
+};
+
+extern OpeningBook openingBook;
@@ -0,0 +1,33 @@
+#include "cpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+static CpuFeatures DetectCpuFeatures() {
+    CpuFeatures features;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // May run from a static initializer, before libgcc has filled in its cpu model
+    __builtin_cpu_init();
+    features.bmi2 = __builtin_cpu_supports("bmi2");
+    features.avx2 = __builtin_cpu_supports("avx2");
+
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int family = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        family = (eax >> 8) & 0xF;
+        if (family == 0xF) {
+            family += (eax >> 20) & 0xFF;
+        }
+    }
+    // Zen 3 is family 19h, everything AMD before it implements PEXT in microcode
+    features.fastPext = features.bmi2 && (!__builtin_cpu_is("amd") || family >= 0x19);
+#endif
+    // Other compilers and architectures report nothing, which selects the portable code paths
+    return features;
+}
+
+const CpuFeatures& GetCpuFeatures() {
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Instruction set extensions of the CPU we are running on, detected once with cpuid. Code compiled for an extension
+// through a target attribute must only be reached when the matching flag is set, so one binary runs everywhere.
+struct CpuFeatures {
+    bool bmi2 = false;
+    bool avx2 = false;
+    bool fastPext = false; // PEXT is microcoded (tens to hundreds of cycles) on AMD before Zen 3
+};
+
+const CpuFeatures& GetCpuFeatures();
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "tunables.h"
+#include <array>
+
+// Tunable evaluation weights in centipawns. This file is written by tools/tune (faris-tune --out eval_params.h), so
+// hand edits are fine but are lost on the next tune; keep the layout when editing.
+
+// Piece-square tables from white's POV with a1 = 0, square XOR 56 to get the score from black's POV
+static constexpr std::array<int, 64> pawnScoreTable = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,   5,  10,  25,  25,  10,   5,   5,
+     10,  10,  20,  30,  30,  20,  10,  10,
+     50,  50,  50,  50,  50,  50,  50,  50,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static constexpr std::array<int, 64> knightScoreTable = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50
+};
+
+static constexpr std::array<int, 64> bishopScoreTable = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20
+};
+
+static constexpr std::array<int, 64> rookScoreTable = {
+      0,   0,   0,   5,   5,   0,   0,   0,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      5,  10,  10,  10,  10,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static constexpr std::array<int, 64> queenScoreTable = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+
+// Indexed by PieceType. The king value only orders captures made by the king, the last entry is PieceType::None.
+TUNABLE int pieceValues[7] = { 100, 300, 300, 500, 900, 2000, 0 };
+
+// Per pawn
+static constexpr int doubledPawnPenalty = -50;
+static constexpr int isolatedPawnPenalty = -50;
+static constexpr int blockedPawnPenalty = -50; // square in front occupied by any piece
+
+// Shelter, from the king's POV, summed over the king's file and its neighbours
+static constexpr int pawnShieldBonus[3] = { 0, 15, 8 };          // own pawn 1 or 2 ranks in front of the king
+static constexpr int pawnShieldMissing = -10;                    // own pawns on the file, but none close in front
+static constexpr int pawnStormPenalty[4] = { 0, -5, -20, -10 };  // closest enemy pawn 1, 2 or 3 ranks in front
+static constexpr int semiOpenFileNearKing = -15;                 // no own pawn on the file
+static constexpr int openFileNearKing = -25;                     // no pawn at all on the file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "board.h"
+
+// How often each tunable term of eval_params.h contributed to the last evaluation on this thread, per color, filled
+// in by Evaluate only in builds with USE_EVAL_TRACE (tools/tune). The tuner turns the counts into the position's
+// coefficients for each weight. Everywhere else EVAL_TRACE compiles away to nothing.
+struct EvalTrace {
+    int pieces[5][2];             // [PieceType up to queen][color]
+    int pieceSquares[5][64][2];   // [PieceType][square from white's POV][color]
+    int doubledPawns[2];
+    int isolatedPawns[2];
+    int blockedPawns[2];
+    // Shelter terms of color's king, scaled by kingSafetyScale[color] in the evaluation
+    int pawnShieldBonus[3][2];
+    int pawnShieldMissing[2];
+    int pawnStormPenalty[4][2];
+    int semiOpenFileNearKing[2];
+    int openFileNearKing[2];
+    double kingSafetyScale[2];
+};
+
+#ifdef USE_EVAL_TRACE
+extern thread_local EvalTrace evalTrace;
+#define EVAL_TRACE(statement) statement
+#else
+#define EVAL_TRACE(statement)
+#endif
@@ -1,6 +1,8 @@
 #include "fen.h"
 #include "board.h"
 #include "utilities.h"
+#include <algorithm>
+#include <sstream>
 #include <stdexcept>
 
 Fen ParseFen(const std::string& fenStr) {
@@ -14,7 +16,6 @@ Fen ParseFen(const std::string& fenStr) {
     {
         bool incrementFile = true;
         int squareIndex = rank * 8 + file;
-        Bitboard squareIndexBB = (Bitboard)1 << squareIndex;
         char c = fenStr[fenIdx++];
         switch (c)
         {
@@ -33,40 +34,40 @@ Fen ParseFen(const std::string& fenStr) {
             break;
         }
         case 'P':
-            board.whitePawns |= squareIndexBB;
+            board.AddPiece(PieceType::Pawn, White, squareIndex);
             break;
         case 'N':
-            board.whiteKnights |= squareIndexBB;
+            board.AddPiece(PieceType::Knight, White, squareIndex);
             break;
         case 'B':
-            board.whiteBishops |= squareIndexBB;
+            board.AddPiece(PieceType::Bishop, White, squareIndex);
             break;
         case 'R':
-            board.whiteRooks |= squareIndexBB;
+            board.AddPiece(PieceType::Rook, White, squareIndex);
             break;
         case 'Q':
-            board.whiteQueens |= squareIndexBB;
+            board.AddPiece(PieceType::Queen, White, squareIndex);
             break;
         case 'K':
-            board.whiteKing |= squareIndexBB;
+            board.AddPiece(PieceType::King, White, squareIndex);
             break;
         case 'p':
-            board.blackPawns |= squareIndexBB;
+            board.AddPiece(PieceType::Pawn, Black, squareIndex);
             break;
         case 'n':
-            board.blackKnights |= squareIndexBB;
+            board.AddPiece(PieceType::Knight, Black, squareIndex);
             break;
         case 'b':
-            board.blackBishops |= squareIndexBB;
+            board.AddPiece(PieceType::Bishop, Black, squareIndex);
             break;
         case 'r':
-            board.blackRooks |= squareIndexBB;
+            board.AddPiece(PieceType::Rook, Black, squareIndex);
             break;
         case 'q':
-            board.blackQueens |= squareIndexBB;
+            board.AddPiece(PieceType::Queen, Black, squareIndex);
             break;
         case 'k':
-            board.blackKing |= squareIndexBB;
+            board.AddPiece(PieceType::King, Black, squareIndex);
             break;
         case '/':
             incrementFile = false;
@@ -104,23 +105,22 @@ Fen ParseFen(const std::string& fenStr) {
         throw std::invalid_argument("Invalid FEN format");
     }
 
-    board.shortCastlingRight[White] = board.shortCastlingRight[Black] = false;
-    board.longCastlingRight[White] = board.longCastlingRight[Black] = false;
+    board.castlingRights = 0;
     if (fenStr[fenIdx] == '-') {
         fenIdx++;
     } else {
         while (fenStr[fenIdx] != ' ') {
             if (fenStr[fenIdx] == 'K') {
-                board.shortCastlingRight[White] = true;
+                board.castlingRights |= SHORT_CASTLING_RIGHT[White];
                 fenIdx++;
             } else if (fenStr[fenIdx] == 'Q') {
-                board.longCastlingRight[White] = true;
+                board.castlingRights |= LONG_CASTLING_RIGHT[White];
                 fenIdx++;
             } else if (fenStr[fenIdx] == 'k') {
-                board.shortCastlingRight[Black] = true;
+                board.castlingRights |= SHORT_CASTLING_RIGHT[Black];
                 fenIdx++;
             } else if (fenStr[fenIdx] == 'q') {
-                board.longCastlingRight[Black] = true;
+                board.castlingRights |= LONG_CASTLING_RIGHT[Black];
                 fenIdx++;
             } else {
                 throw std::invalid_argument("Invalid FEN format");
@@ -215,16 +215,16 @@ std::string ToFen(const Fen& fen) {
     fenStr += ' ';
     fenStr += fen.colorToMove == Color::White ? 'w' : 'b';
     fenStr += ' ';
-    if (fen.board.shortCastlingRight[White]) {
+    if (fen.board.ShortCastlingRight(White)) {
         fenStr += 'K';
     }
-    if (fen.board.longCastlingRight[White]) {
+    if (fen.board.LongCastlingRight(White)) {
         fenStr += 'Q';
     }
-    if (fen.board.shortCastlingRight[Black]) {
+    if (fen.board.ShortCastlingRight(Black)) {
         fenStr += 'k';
     }
-    if (fen.board.longCastlingRight[Black]) {
+    if (fen.board.LongCastlingRight(Black)) {
         fenStr += 'q';
     }
     if (fenStr.back() == ' ') {
@@ -249,3 +249,87 @@ std::string ToFen(const Fen& fen) {
     fenStr += std::to_string(fen.fullmoveNumber);
     return fenStr;
 }
+
+std::string EpdToFen(std::string_view line) {
+    std::istringstream stream{std::string(line)};
+    std::string fields[6];
+    int count = 0;
+    while (count < 6 && stream >> fields[count]) {
+        count++;
+    }
+    if (count < 4) {
+        throw std::invalid_argument("Expected at least 4 FEN fields");
+    }
+    auto isNumber = [](const std::string& field) {
+        return !field.empty() && std::all_of(field.begin(), field.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    std::string fen = fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[3];
+    if (count == 6 && isNumber(fields[4]) && isNumber(fields[5])) {
+        return fen + ' ' + fields[4] + ' ' + fields[5];
+    }
+    return fen + " 0 1";
+}
+
+std::map<std::string, std::string, std::less<>> EpdOperations(std::string_view line) {
+    auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; };
+    auto skipSpaces = [&] {
+        while (!line.empty() && isSpace(line.front())) {
+            line.remove_prefix(1);
+        }
+    };
+    auto nextField = [&] {
+        skipSpaces();
+        std::size_t end = 0;
+        while (end < line.size() && !isSpace(line[end])) {
+            end++;
+        }
+        std::string_view field = line.substr(0, end);
+        line.remove_prefix(end);
+        return field;
+    };
+    for (int i = 0; i < 4; i++) {
+        nextField();
+    }
+    auto isNumber = [](std::string_view field) {
+        return !field.empty() && std::all_of(field.begin(), field.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    std::string_view afterBoard = line;
+    if (!(isNumber(nextField()) && isNumber(nextField()))) {
+        line = afterBoard;
+    }
+
+    std::map<std::string, std::string, std::less<>> operations;
+    while (true) {
+        skipSpaces();
+        std::size_t opcodeEnd = 0;
+        while (opcodeEnd < line.size() && !isSpace(line[opcodeEnd]) && line[opcodeEnd] != ';') {
+            opcodeEnd++;
+        }
+        if (opcodeEnd == 0) {
+            if (line.empty()) {
+                break;
+            }
+            line.remove_prefix(1); // stray ';'
+            continue;
+        }
+        std::string opcode{line.substr(0, opcodeEnd)};
+        line.remove_prefix(opcodeEnd);
+        skipSpaces();
+        std::string operands;
+        bool quoted = false;
+        while (!line.empty() && (quoted || line.front() != ';')) {
+            if (line.front() == '"') {
+                quoted = !quoted;
+            }
+            else {
+                operands += line.front();
+            }
+            line.remove_prefix(1);
+        }
+        while (!operands.empty() && isSpace(operands.back())) {
+            operands.pop_back();
+        }
+        operations[std::move(opcode)] = std::move(operands);
+    }
+    return operations;
+}
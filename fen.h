@@ -1,7 +1,9 @@
 #pragma once
 
 #include "board.h"
+#include <map>
 #include <string>
+#include <string_view>
 
 // TODO: move elsewhere and rename to something generic like GameState. Also figure out what the hell halfmoveClock and fullmoveNumber are
 struct Fen {
@@ -17,6 +19,15 @@ struct Fen {
     }
 };
 
+inline constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
 // Assuming well-formed fen, minimal error checking 
 Fen ParseFen(const std::string& fen);
 std::string ToFen(const Fen& fen);
+// EPD lines have the first four FEN fields followed by operations ("bm e4; id ..."), FEN lines add the two counters.
+// Returns the line as a six field FEN, with counters 0 1 if it had none. Throws std::invalid_argument for fewer than
+// four fields.
+std::string EpdToFen(std::string_view line);
+// Operations of an EPD line ("bm Qg6 Rf7; id \"WAC.001\";") by opcode, with the operands as one string without quotes
+// or the terminating ';'. Lines with the two FEN counters before the operations work too.
+std::map<std::string, std::string, std::less<>> EpdOperations(std::string_view line);
@@ -0,0 +1,49 @@
+#include "game.h"
+#include "search.h"
+#include "transposition.h"
+#include "utilities.h"
+#include <bit>
+
+void Game::Reset(const std::string& fen) {
+    Fen parsed = ParseFen(fen);
+    startFen = fen;
+    moves.clear();
+    board = parsed.board;
+    colorToMove = parsed.colorToMove;
+    hash = transpositionTable.Hash(board, colorToMove);
+    halfmoveClock = parsed.halfmoveClock;
+    ply = 0;
+    threefoldRepetitionTable.clear();
+    threefoldRepetitionTable[hash]++;
+}
+
+void Game::Play(const Move& move) {
+    bool zeroing = board.PieceTypeAt(move.From()) == PieceType::Pawn || board.PieceTypeAt(move.To()) != PieceType::None;
+    MakeMove(move, board, colorToMove, hash);
+    moves.push_back(move);
+    halfmoveClock = zeroing ? 0 : halfmoveClock + 1;
+    threefoldRepetitionTable[hash]++;
+    colorToMove = ToggleColor(colorToMove);
+    ply++;
+}
+
+std::optional<int> Game::Result() const {
+    if (GenMoves(board, colorToMove).empty()) {
+        return !InCheck(board, colorToMove) ? 0 : colorToMove == White ? -1 : 1;
+    }
+    auto repetitions = threefoldRepetitionTable.find(hash);
+    if (halfmoveClock >= 100 || repetitions->second >= 3 || InsufficientMaterial(board)) {
+        return 0;
+    }
+    return std::nullopt;
+}
+
+bool InsufficientMaterial(const Board& board) {
+    Bitboard heavyAndPawns = board.Pawns(White) | board.Pawns(Black);
+    Bitboard minors = 0;
+    for (Color color : { White, Black }) {
+        heavyAndPawns |= board.bitboards2D[color][ROOK_OFFSET] | board.bitboards2D[color][QUEEN_OFFSET];
+        minors |= board.bitboards2D[color][KNIGHT_OFFSET] | board.bitboards2D[color][BISHOP_OFFSET];
+    }
+    return !heavyAndPawns && std::popcount(minors) <= 1;
+}
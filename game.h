@@ -0,0 +1,30 @@
+#pragma once
+
+#include "board.h"
+#include "fen.h"
+#include "movegen.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A game played out on this thread, for the self-play tools (gensfen, match). Positions are counted in the thread's
+// threefoldRepetitionTable, so searches started from the game see its history.
+struct Game {
+    std::string startFen;
+    std::vector<Move> moves;
+    Board board;
+    Color colorToMove = White;
+    std::uint64_t hash = 0;
+    int halfmoveClock = 0;
+    int ply = 0;
+
+    void Reset(const std::string& fen);
+    void Play(const Move& move);
+    // 1 if white has won, -1 if black has, 0 for a draw by the rules (stalemate, threefold repetition, fifty moves,
+    // insufficient material), nothing while the game goes on
+    std::optional<int> Result() const;
+};
+
+// Kings with at most one minor piece between them can't mate
+bool InsufficientMaterial(const Board& board);
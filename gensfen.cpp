@@ -0,0 +1,213 @@
+#include "gensfen.h"
+#include "fen.h"
+#include "game.h"
+#include "movegen.h"
+#include "packed_position.h"
+#include "search.h"
+#include "transposition.h"
+#include "utilities.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Positions whose score is beyond this carry a mate or tablebase score and aren't recorded
+constexpr int MAX_RECORDED_SCORE = 30000;
+// A game is adjudicated once the side to move's score stays beyond this for ADJUDICATE_PLIES plies in a row, with the
+// same side ahead all along
+constexpr int ADJUDICATE_SCORE = 2000;
+constexpr int ADJUDICATE_PLIES = 8;
+constexpr int MAX_GAME_PLIES = 400;
+// Iterative deepening limit for node limited searches, mates are found quickly and would otherwise iterate far past
+// any useful depth
+constexpr int MAX_SEARCH_DEPTH = 32;
+constexpr std::uint64_t REPORT_INTERVAL = 100'000;
+
+struct GensfenOptions {
+    std::string outPath;
+    std::uint64_t count = 0;
+    std::uint64_t nodes = 5000;
+    int depth = 0;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int randomPlies = 8;
+    int hashMB = 16; // per worker
+    std::uint64_t seed = std::random_device{}();
+    bool append = false;
+};
+
+// Plays one game and leaves its recorded positions in positions with results filled in. False if the random opening
+// ran into a finished game, in which case nothing is recorded.
+bool PlayGame(std::mt19937_64& rng, const GensfenOptions& options, std::vector<PackedPosition>& positions) {
+    positions.clear();
+    Game game;
+    game.Reset(START_FEN);
+    for (int i = 0; i < options.randomPlies; i++) {
+        MoveList moves = GenMoves(game.board, game.colorToMove);
+        if (moves.empty()) {
+            return false;
+        }
+        game.Play(moves[std::uniform_int_distribution<int>{0, moves.size() - 1}(rng)]);
+    }
+
+    searchTT->Clear();
+    searchHistory->Clear();
+    const SearchLimits limits{ .depth = options.depth > 0 ? options.depth : MAX_SEARCH_DEPTH, .nodes = options.nodes };
+    int whiteResult = 0;
+    int adjudicatePlies = 0;
+    int adjudicateSign = 0;
+    while (true) {
+        if (std::optional<int> result = game.Result()) {
+            whiteResult = *result;
+            break;
+        }
+        if (game.ply >= MAX_GAME_PLIES) {
+            break;
+        }
+        bool inCheck = InCheck(game.board, game.colorToMove);
+
+        Move move = Search(game.board, game.colorToMove, limits, false);
+        int score = rootLines[0].score;
+        int whiteScore = game.colorToMove == White ? score : -score;
+        int sign = whiteScore >= ADJUDICATE_SCORE ? 1 : whiteScore <= -ADJUDICATE_SCORE ? -1 : 0;
+        adjudicatePlies = sign != 0 && sign == adjudicateSign ? adjudicatePlies + 1 : 1;
+        adjudicateSign = sign;
+        if (sign != 0 && adjudicatePlies >= ADJUDICATE_PLIES) {
+            whiteResult = sign;
+            break;
+        }
+
+        // Only quiet positions, where the static evaluation can be expected to match the search score
+        bool quiet = !inCheck && move.Type() == Move::Normal && game.board.PieceTypeAt(move.To()) == PieceType::None;
+        if (quiet && std::abs(score) <= MAX_RECORDED_SCORE) {
+            positions.push_back(PackPosition(game.board, game.colorToMove, score, game.ply, 0, game.halfmoveClock));
+        }
+        game.Play(move);
+    }
+    for (PackedPosition& position : positions) {
+        position.result = (std::int8_t)((position.flags & 1) == White ? whiteResult : -whiteResult);
+    }
+    return true;
+}
+
+bool ParseOptions(int argc, char** argv, GensfenOptions& options) {
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--append") {
+            options.append = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--out") {
+            options.outPath = value;
+        }
+        else if (arg == "--count") {
+            options.count = std::strtoull(value, nullptr, 10);
+        }
+        else if (arg == "--nodes") {
+            options.nodes = std::strtoull(value, nullptr, 10);
+        }
+        else if (arg == "--depth") {
+            options.depth = std::atoi(value);
+        }
+        else if (arg == "--threads") {
+            options.threads = std::max(1, std::atoi(value));
+        }
+        else if (arg == "--random-plies") {
+            options.randomPlies = std::max(0, std::atoi(value));
+        }
+        else if (arg == "--hash") {
+            options.hashMB = std::max(1, std::atoi(value));
+        }
+        else if (arg == "--seed") {
+            options.seed = std::strtoull(value, nullptr, 10);
+        }
+        else {
+            std::cerr << "Unknown gensfen option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.outPath.empty() || options.count == 0 || (options.nodes == 0 && options.depth <= 0)) {
+        std::cerr << "Usage: faris-engine gensfen --out <file> --count <positions> [--nodes <n>] [--depth <d>] "
+                     "[--threads <t>] [--random-plies <p>] [--hash <MB>] [--seed <s>] [--append]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int Gensfen(int argc, char** argv) {
+    GensfenOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    PackedPositionWriter writer;
+    if (!writer.Open(options.outPath, options.append)) {
+        std::cerr << "Failed to open '" << options.outPath << "' for writing" << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t ttEntries = (std::size_t)options.hashMB * 1024 * 1024 / sizeof(TTEntry);
+    std::atomic<std::uint64_t> reserved{0};
+    std::atomic<std::uint64_t> games{0};
+    std::uint64_t written = 0;
+    std::mutex writerMutex;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; i++) {
+        workers.emplace_back([&, i] {
+            auto table = std::make_unique<TT>(ttEntries);
+            searchTT = table.get();
+            // Each worker plays its own reproducible sequence of games; which of them make it into the file before
+            // the count is reached still depends on scheduling
+            std::mt19937_64 rng{options.seed + i};
+            std::vector<PackedPosition> positions;
+            while (reserved.load() < options.count) {
+                if (!PlayGame(rng, options, positions)) {
+                    continue;
+                }
+                games++;
+                // Claim a slice of the remaining count so the file ends up with exactly count positions
+                std::uint64_t first = reserved.fetch_add(positions.size());
+                if (first >= options.count) {
+                    break;
+                }
+                std::size_t keep = (std::size_t)std::min<std::uint64_t>(positions.size(), options.count - first);
+                std::lock_guard lock{writerMutex};
+                writer.Write(positions.data(), keep);
+                if ((written + keep) / REPORT_INTERVAL != written / REPORT_INTERVAL) {
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    std::cerr << written + keep << " positions, " << games.load() << " games, "
+                              << (std::uint64_t)((written + keep) / seconds * 3600) << " positions/hour" << std::endl;
+                }
+                written += keep;
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (!writer.Flush()) {
+        std::cerr << "Failed to write '" << options.outPath << "'" << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Wrote " << written << " positions from " << games.load() << " games in " << seconds << " s" << std::endl;
+    return 0;
+}
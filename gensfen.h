@@ -0,0 +1,9 @@
+#pragma once
+
+// faris-engine gensfen --out <file> --count <positions> [--nodes <n>] [--depth <d>] [--threads <t>]
+//                      [--random-plies <p>] [--hash <MB>] [--seed <s>] [--append]
+// Plays self-play games on a pool of worker threads, one per core unless --threads says otherwise, each game starting
+// with random legal moves and continuing with fixed node (or depth) searches, and writes the quiet positions of every
+// finished game to a PackedPosition file together with the search score, the ply and the game result. Returns the
+// process exit code.
+int Gensfen(int argc, char** argv);
@@ -1,13 +1,39 @@
+#include "analyse.h"
+#include "bench.h"
 #include "board.h"
 #include <cassert>
+#include <cstdlib>
+#include "gensfen.h"
 #include "movegen.h"
 #include <iostream>
+#include "match.h"
+#include <string_view>
+#include "trace.h"
+#include "tsuite.h"
 #include "uci.h"
 
 int maxDepth;
 
 int main(int argc, char** argv) {
     maxDepth = 10;
+    TraceInit();
+    if (argc > 1 && std::string_view{argv[1]} == "bench") {
+        constexpr int defaultBenchDepth = 6;
+        Bench(argc > 2 ? std::atoi(argv[2]) : defaultBenchDepth);
+        return 0;
+    }
+    if (argc > 1 && std::string_view{argv[1]} == "analyse") {
+        return Analyse(argc, argv);
+    }
+    if (argc > 1 && std::string_view{argv[1]} == "gensfen") {
+        return Gensfen(argc, argv);
+    }
+    if (argc > 1 && std::string_view{argv[1]} == "match") {
+        return Match(argc, argv);
+    }
+    if (argc > 1 && std::string_view{argv[1]} == "tsuite") {
+        return Tsuite(argc, argv);
+    }
     ProcessInput();
     return 0;
 }
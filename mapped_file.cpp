@@ -0,0 +1,63 @@
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FARIS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path, bool randomAccess) {
+    Close();
+#ifdef FARIS_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        void* result = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (result != MAP_FAILED) {
+            mapping = result;
+            data = (const char*)result;
+            size = status.st_size;
+        }
+    }
+    close(fd);
+    if (mapping && randomAccess) {
+        madvise(mapping, size, MADV_RANDOM);
+    }
+#else
+    (void)randomAccess;
+    std::ifstream file{path, std::ios::binary};
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+#endif
+    if (size == 0) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close() {
+#ifdef FARIS_MMAP
+    if (mapping) {
+        munmap(mapping, size);
+    }
+#endif
+    mapping = nullptr;
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+}
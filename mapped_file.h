@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. Memory mapped where the platform supports it, so only the pages actually touched
+// are read from disk and several processes share them; read into memory elsewhere.
+struct MappedFile {
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // Replaces any previously opened file. randomAccess disables read-ahead for files probed all over the place.
+    // Returns false (leaving the view empty) if the file can't be read or is empty.
+    bool Open(const std::string& path, bool randomAccess);
+    void Close();
+    const char* Data() const { return data; }
+    std::size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+    void* mapping = nullptr;
+    std::vector<char> buffer;
+};
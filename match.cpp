@@ -0,0 +1,607 @@
+#include "match.h"
+#include "fen.h"
+#include "game.h"
+#include "movegen.h"
+#include "search.h"
+#include "transposition.h"
+#include "utilities.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FARIS_UCI_PROCESS
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr int MAX_GAME_PLIES = 500; // adjudicated as a draw
+// Iterative deepening limit for searches without a clock, as in gensfen
+constexpr int MAX_SEARCH_DEPTH = 32;
+constexpr int REPORT_INTERVAL = 20; // game pairs
+
+struct EngineSpec {
+    std::string command; // empty for the in-process search
+    bool useNewFeature = false;
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+struct MatchOptions {
+    EngineSpec engines[2];
+    std::string names[2];
+    int pairs = 500;
+    int concurrency = 1;
+    int time = 0; // ms per game
+    int inc = 0;
+    int timeMargin = 50; // ms a move may overrun the clock before it counts as a loss on time
+    std::uint64_t nodes = 0;
+    int depth = 0;
+    std::string openingsPath;
+    int randomPlies = 8;
+    bool sprt = false;
+    double elo0 = 0;
+    double elo1 = 5;
+    double alpha = 0.05;
+    double beta = 0.05;
+    int hashMB = 16;
+    std::uint64_t seed = std::random_device{}();
+};
+
+// A UCI engine in a child process, talking over its stdin and stdout. Its stderr goes to /dev/null.
+class UciProcess {
+public:
+    UciProcess() = default;
+    UciProcess(const UciProcess&) = delete;
+    UciProcess& operator=(const UciProcess&) = delete;
+    ~UciProcess() { Stop(); }
+
+    bool Start(const std::string& command);
+    void Stop();
+    void Send(const std::string& line);
+    // Reads lines until one starts with prefix; false if the engine exited first
+    bool WaitFor(std::string_view prefix, std::string& line);
+
+private:
+    bool ReadLine(std::string& line);
+
+    int pid = -1;
+    int toEngine = -1;
+    int fromEngine = -1;
+    std::string buffer;
+};
+
+#ifdef FARIS_UCI_PROCESS
+bool UciProcess::Start(const std::string& command) {
+    int input[2], output[2];
+    if (pipe(input) != 0) {
+        return false;
+    }
+    if (pipe(output) != 0) {
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+    // Engines are started before any worker thread, so no other fork can inherit the pipes in between
+    for (int fd : { input[0], input[1], output[0], output[1] }) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    pid = fork();
+    if (pid == 0) {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDERR_FILENO);
+        execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    close(input[0]);
+    close(output[1]);
+    toEngine = input[1];
+    fromEngine = output[0];
+    if (pid < 0) {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void UciProcess::Stop() {
+    if (toEngine >= 0) {
+        Send("quit");
+        close(toEngine);
+        toEngine = -1;
+    }
+    if (fromEngine >= 0) {
+        close(fromEngine);
+        fromEngine = -1;
+    }
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+        pid = -1;
+    }
+}
+
+void UciProcess::Send(const std::string& line) {
+    std::string text = line + '\n';
+    for (std::size_t written = 0; written < text.size();) {
+        ssize_t count = write(toEngine, text.data() + written, text.size() - written);
+        if (count <= 0) {
+            return;
+        }
+        written += count;
+    }
+}
+
+bool UciProcess::ReadLine(std::string& line) {
+    while (true) {
+        std::size_t end = buffer.find('\n');
+        if (end != std::string::npos) {
+            line.assign(buffer, 0, end);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            buffer.erase(0, end + 1);
+            return true;
+        }
+        char chunk[4096];
+        ssize_t count = read(fromEngine, chunk, sizeof(chunk));
+        if (count <= 0) {
+            return false;
+        }
+        buffer.append(chunk, count);
+    }
+}
+#else
+bool UciProcess::Start(const std::string&) {
+    std::cerr << "Child process engines are not supported on this platform" << std::endl;
+    return false;
+}
+void UciProcess::Stop() {}
+void UciProcess::Send(const std::string&) {}
+bool UciProcess::ReadLine(std::string&) {
+    return false;
+}
+#endif
+
+bool UciProcess::WaitFor(std::string_view prefix, std::string& line) {
+    while (ReadLine(line)) {
+        if (std::string_view{line}.starts_with(prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// One engine as used by one worker thread: its own TT and history when it searches in-process, its own child process
+// otherwise
+struct Player {
+    const EngineSpec* spec = nullptr;
+    std::unique_ptr<TT> tt;
+    std::unique_ptr<SearchHistory> history;
+    std::unique_ptr<UciProcess> process;
+    int clock = 0;
+
+    bool Start(const EngineSpec& engine, std::size_t ttEntries) {
+        spec = &engine;
+        if (engine.command.empty()) {
+            tt = std::make_unique<TT>(ttEntries);
+            history = std::make_unique<SearchHistory>();
+            return true;
+        }
+        process = std::make_unique<UciProcess>();
+        std::string line;
+        if (!process->Start(engine.command)) {
+            return false;
+        }
+        process->Send("uci");
+        if (!process->WaitFor("uciok", line)) {
+            return false;
+        }
+        for (const auto& [name, value] : engine.options) {
+            process->Send("setoption name " + name + " value " + value);
+        }
+        return true;
+    }
+
+    bool NewGame() {
+        if (tt) {
+            tt->Clear();
+            history->Clear();
+            return true;
+        }
+        std::string line;
+        process->Send("ucinewgame");
+        process->Send("isready");
+        return process->WaitFor("readyok", line);
+    }
+
+    // Null move if a child engine died or answered with something that isn't a legal move
+    Move Think(const Game& game, const MatchOptions& options, int opponentClock) {
+        bool timed = options.time > 0;
+        if (tt) {
+            searchTT = tt.get();
+            searchHistory = history.get();
+            SearchLimits limits{ .time = timed ? clock : 0, .inc = options.inc,
+                                 .depth = options.depth > 0 ? options.depth : timed ? 0 : MAX_SEARCH_DEPTH,
+                                 .nodes = options.nodes };
+            return Search(game.board, game.colorToMove, limits, spec->useNewFeature);
+        }
+        std::string command = "position fen " + game.startFen;
+        if (!game.moves.empty()) {
+            command += " moves";
+            for (const Move& move : game.moves) {
+                command += ' ' + MoveToUCINotation(move);
+            }
+        }
+        process->Send(command);
+        command = "go";
+        if (timed) {
+            int white = game.colorToMove == White ? clock : opponentClock;
+            int black = game.colorToMove == White ? opponentClock : clock;
+            command += " wtime " + std::to_string(std::max(white, 1)) + " btime " + std::to_string(std::max(black, 1)) +
+                       " winc " + std::to_string(options.inc) + " binc " + std::to_string(options.inc);
+        }
+        if (options.nodes) {
+            command += " nodes " + std::to_string(options.nodes);
+        }
+        if (options.depth > 0) {
+            command += " depth " + std::to_string(options.depth);
+        }
+        process->Send(command);
+        std::string line;
+        if (!process->WaitFor("bestmove", line)) {
+            return {};
+        }
+        std::string_view text = std::string_view{line}.substr(8);
+        text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+        text = text.substr(0, text.find(' '));
+        for (const Move& move : GenMoves(game.board, game.colorToMove)) {
+            if (MoveToUCINotation(move) == text) {
+                return move;
+            }
+        }
+        return {};
+    }
+};
+
+enum class Termination { Rules, MaxPlies, Time, Illegal, Count };
+
+struct GameResult {
+    int white; // 1, 0 or -1 from white's POV
+    Termination termination;
+};
+
+GameResult PlayGame(Player* players[2], const std::string& startFen, const MatchOptions& options) {
+    Game game;
+    game.Reset(startFen);
+    for (Color color : { White, Black }) {
+        players[color]->clock = options.time;
+        if (!players[color]->NewGame()) {
+            return { color == White ? -1 : 1, Termination::Illegal };
+        }
+    }
+    while (true) {
+        if (std::optional<int> result = game.Result()) {
+            return { *result, Termination::Rules };
+        }
+        if (game.ply >= MAX_GAME_PLIES) {
+            return { 0, Termination::MaxPlies };
+        }
+        Color color = game.colorToMove;
+        Player& player = *players[color];
+        auto start = std::chrono::steady_clock::now();
+        Move move = player.Think(game, options, players[ToggleColor(color)]->clock);
+        int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        int loss = color == White ? -1 : 1;
+        if (move == Move{}) {
+            return { loss, Termination::Illegal };
+        }
+        if (options.time > 0) {
+            player.clock -= elapsed;
+            if (player.clock < -options.timeMargin) {
+                return { loss, Termination::Time };
+            }
+            player.clock = std::max(player.clock, 0) + options.inc;
+        }
+        game.Play(move);
+    }
+}
+
+// Opening positions to play, each of them twice
+struct Openings {
+    std::vector<std::string> fens;
+    int randomPlies = 0;
+    std::uint64_t seed = 0;
+
+    // FEN of the opening for a game pair. Random openings are derived from the pair index alone, so a run with the
+    // same seed plays the same openings at any concurrency.
+    std::string Get(int pair) const {
+        if (!fens.empty()) {
+            return fens[pair % fens.size()];
+        }
+        std::mt19937_64 rng{seed + pair};
+        while (true) {
+            Game game;
+            game.Reset(START_FEN);
+            for (int i = 0; i < randomPlies && !game.Result(); i++) {
+                MoveList moves = GenMoves(game.board, game.colorToMove);
+                game.Play(moves[std::uniform_int_distribution<int>{0, moves.size() - 1}(rng)]);
+            }
+            if (!game.Result()) {
+                return ToFen({ game.board, game.halfmoveClock, 1 + game.ply / 2, game.colorToMove });
+            }
+        }
+    }
+};
+
+// Game pair results from engine A's POV: pentanomial counts of 0, 0.5, 1, 1.5 and 2 points per pair, plus the plain
+// game counts for the report
+struct Stats {
+    std::array<int, 5> pairs{};
+    int wins = 0, draws = 0, losses = 0;
+    std::array<int, (int)Termination::Count> terminations{};
+
+    int Pairs() const { return pairs[0] + pairs[1] + pairs[2] + pairs[3] + pairs[4]; }
+
+    // Mean score per game and variance of the per pair mean
+    std::pair<double, double> MeanAndVariance() const {
+        double n = Pairs(), mean = 0, variance = 0;
+        for (int i = 0; i < 5; i++) {
+            mean += pairs[i] * i / 4.0;
+        }
+        mean /= n;
+        for (int i = 0; i < 5; i++) {
+            variance += pairs[i] * (i / 4.0 - mean) * (i / 4.0 - mean);
+        }
+        return { mean, variance / n };
+    }
+};
+
+double ScoreToElo(double score) {
+    score = std::clamp(score, 1e-6, 1 - 1e-6);
+    return -400 * std::log10(1 / score - 1);
+}
+
+double EloToScore(double elo) {
+    return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+// Log-likelihood ratio of H1 (elo1) against H0 (elo0) in the normal approximation of the generalized SPRT, with the
+// pentanomial variance, which is what fishtest and cutechess report
+double LogLikelihoodRatio(const Stats& stats, double elo0, double elo1) {
+    if (stats.Pairs() == 0) {
+        return 0;
+    }
+    auto [mean, variance] = stats.MeanAndVariance();
+    if (variance <= 0) {
+        return 0;
+    }
+    double s0 = EloToScore(elo0), s1 = EloToScore(elo1);
+    return stats.Pairs() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+void Report(const Stats& stats, const MatchOptions& options, std::ostream& out) {
+    auto [mean, variance] = stats.MeanAndVariance();
+    double error = 1.96 * std::sqrt(variance / stats.Pairs());
+    double elo = ScoreToElo(mean);
+    double eloError = (ScoreToElo(mean + error) - ScoreToElo(mean - error)) / 2;
+    double los = variance > 0 ? 0.5 * (1 + std::erf((mean - 0.5) / std::sqrt(variance / stats.Pairs()) / std::sqrt(2.0))) : 0.5;
+    out << std::fixed << std::setprecision(2) << "Games " << 2 * stats.Pairs() << ": " << options.names[0] << " vs "
+        << options.names[1] << " +" << stats.wins << " -" << stats.losses << " =" << stats.draws << "  score "
+        << mean * 100 << "%  Elo " << elo << " +- " << eloError << "  LOS " << los * 100 << "%";
+    if (options.sprt) {
+        out << "  LLR " << LogLikelihoodRatio(stats, options.elo0, options.elo1) << " ("
+            << std::log(options.beta / (1 - options.alpha)) << ", " << std::log((1 - options.beta) / options.alpha)
+            << ") [" << options.elo0 << ", " << options.elo1 << "]";
+    }
+    out << "\n  pairs " << stats.pairs[0] << " " << stats.pairs[1] << " " << stats.pairs[2] << " " << stats.pairs[3]
+        << " " << stats.pairs[4] << "  time losses " << stats.terminations[(int)Termination::Time]
+        << "  illegal moves " << stats.terminations[(int)Termination::Illegal] << "  max length "
+        << stats.terminations[(int)Termination::MaxPlies] << std::endl;
+    out.unsetf(std::ios::fixed);
+}
+
+bool ParseEngine(std::string_view spec, EngineSpec& engine) {
+    if (spec == "base" || spec == "new") {
+        engine.useNewFeature = spec == "new";
+        return true;
+    }
+    engine.command = spec;
+    return !spec.empty();
+}
+
+// "10+0.1", seconds
+bool ParseTimeControl(std::string_view text, int& time, int& inc) {
+    std::string value{text};
+    std::size_t plus = value.find('+');
+    time = (int)(std::atof(value.substr(0, plus).c_str()) * 1000);
+    inc = plus == std::string::npos ? 0 : (int)(std::atof(value.substr(plus + 1).c_str()) * 1000);
+    return time > 0;
+}
+
+bool ParseOptions(int argc, char** argv, MatchOptions& options) {
+    options.names[0] = "base";
+    options.names[1] = "base";
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string_view value = argv[++i];
+        bool valid = true;
+        if (arg == "--engineA" || arg == "--engineB") {
+            int index = arg.back() - 'A';
+            options.names[index] = value;
+            valid = ParseEngine(value, options.engines[index]);
+        }
+        else if (arg == "--optionA" || arg == "--optionB") {
+            std::size_t equals = value.find('=');
+            valid = equals != std::string_view::npos;
+            options.engines[arg.back() - 'A'].options.emplace_back(value.substr(0, equals), value.substr(equals + 1));
+        }
+        else if (arg == "--games") {
+            options.pairs = std::max(1, (std::atoi(argv[i]) + 1) / 2);
+        }
+        else if (arg == "--concurrency") {
+            options.concurrency = std::max(1, std::atoi(argv[i]));
+        }
+        else if (arg == "--tc") {
+            valid = ParseTimeControl(value, options.time, options.inc);
+        }
+        else if (arg == "--nodes") {
+            options.nodes = std::strtoull(argv[i], nullptr, 10);
+        }
+        else if (arg == "--depth") {
+            options.depth = std::atoi(argv[i]);
+        }
+        else if (arg == "--openings") {
+            options.openingsPath = value;
+        }
+        else if (arg == "--random-plies") {
+            options.randomPlies = std::max(0, std::atoi(argv[i]));
+        }
+        else if (arg == "--sprt") {
+            options.sprt = true;
+            valid = std::sscanf(argv[i], "%lf,%lf", &options.elo0, &options.elo1) == 2 && options.elo0 < options.elo1;
+        }
+        else if (arg == "--alpha") {
+            options.alpha = std::atof(argv[i]);
+        }
+        else if (arg == "--beta") {
+            options.beta = std::atof(argv[i]);
+        }
+        else if (arg == "--hash") {
+            options.hashMB = std::max(1, std::atoi(argv[i]));
+        }
+        else if (arg == "--seed") {
+            options.seed = std::strtoull(argv[i], nullptr, 10);
+        }
+        else {
+            std::cerr << "Unknown match option " << arg << std::endl;
+            return false;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value '" << value << "' for " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.time <= 0 && options.nodes == 0 && options.depth <= 0) {
+        std::cerr << "Usage: faris-engine match --engineA <base|new|command> --engineB <base|new|command> [--games <n>] "
+                     "[--concurrency <c>] (--tc <s+inc> | --nodes <n> | --depth <d>) [--openings <epd>] "
+                     "[--random-plies <p>] [--sprt <elo0,elo1>] [--alpha <a>] [--beta <b>] [--hash <MB>] "
+                     "[--optionA <name=value>] [--optionB <name=value>] [--seed <s>]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int Match(int argc, char** argv) {
+    MatchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    Openings openings{ {}, options.randomPlies, options.seed };
+    if (!options.openingsPath.empty()) {
+        std::ifstream file{options.openingsPath};
+        if (!file) {
+            std::cerr << "Failed to open '" << options.openingsPath << "'" << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) {
+                openings.fens.push_back(EpdToFen(line));
+            }
+        }
+        if (openings.fens.empty()) {
+            std::cerr << "No openings in '" << options.openingsPath << "'" << std::endl;
+            return 1;
+        }
+    }
+#ifdef FARIS_UCI_PROCESS
+    // A child engine that exits would otherwise kill the runner on the next write to it
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    // All engines are started here, before any worker thread runs
+    const std::size_t ttEntries = (std::size_t)options.hashMB * 1024 * 1024 / sizeof(TTEntry);
+    std::vector<std::array<Player, 2>> players(options.concurrency);
+    for (std::array<Player, 2>& pair : players) {
+        for (int i = 0; i < 2; i++) {
+            if (!pair[i].Start(options.engines[i], ttEntries)) {
+                std::cerr << "Failed to start engine '" << options.names[i] << "'" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    const double lowerBound = std::log(options.beta / (1 - options.alpha));
+    const double upperBound = std::log((1 - options.beta) / options.alpha);
+    Stats stats;
+    std::mutex statsMutex;
+    std::atomic<int> nextPair{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    for (std::array<Player, 2>& pair : players) {
+        workers.emplace_back([&, &pair = pair] {
+            for (int index = nextPair++; index < options.pairs && !stop; index = nextPair++) {
+                std::string fen = openings.Get(index);
+                // Engine A plays white in the first game and black in the second
+                Player* first[2] = { &pair[0], &pair[1] };
+                Player* second[2] = { &pair[1], &pair[0] };
+                GameResult results[2] = { PlayGame(first, fen, options), PlayGame(second, fen, options) };
+                int scores[2] = { results[0].white, -results[1].white };
+
+                std::lock_guard lock{statsMutex};
+                stats.pairs[scores[0] + scores[1] + 2]++;
+                for (int i = 0; i < 2; i++) {
+                    stats.wins += scores[i] > 0;
+                    stats.draws += scores[i] == 0;
+                    stats.losses += scores[i] < 0;
+                    stats.terminations[(int)results[i].termination]++;
+                }
+                if (stats.Pairs() % REPORT_INTERVAL == 0) {
+                    Report(stats, options, std::cout);
+                }
+                double llr = LogLikelihoodRatio(stats, options.elo0, options.elo1);
+                if (options.sprt && (llr <= lowerBound || llr >= upperBound)) {
+                    stop = true;
+                }
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    Report(stats, options, std::cout);
+    if (options.sprt) {
+        double llr = LogLikelihoodRatio(stats, options.elo0, options.elo1);
+        std::cout << (llr >= upperBound ? "H1 accepted" : llr <= lowerBound ? "H0 accepted" : "SPRT inconclusive")
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// faris-engine match --engineA <spec> --engineB <spec> [--games <n>] [--concurrency <c>] (--tc <s+inc> | --nodes <n> |
+//                    --depth <d>) [--openings <epd>] [--random-plies <p>] [--sprt <elo0,elo1>] [--alpha <a>]
+//                    [--beta <b>] [--hash <MB>] [--optionA <name=value>] [--optionB <name=value>] [--seed <s>]
+// Plays engine A against engine B and reports the score, Elo and, with --sprt, the SPRT log-likelihood ratio,
+// stopping once a hypothesis is accepted. An engine spec is "base" or "new" for an in-process search with
+// UseNewFeature off or on, anything else is a command line that starts a UCI engine as a child process (with
+// --option settings sent as setoption). Every opening is played twice with colors swapped, and the statistics are
+// computed over these game pairs. Returns the process exit code.
+int Match(int argc, char** argv);
@@ -3,6 +3,7 @@
 #include <cmath>
 #include "board.h"
 #include "attack_bitboards.h"
+#include "trace.h"
 #include "utilities.h"
 
 int IncrementCastles() {
@@ -20,28 +21,24 @@ int IncrementEnPassant() {
     return ++enPassant;
 }
 
-// TODO: make move arrays constexpr
-// TODO: change whiteTurn to color and don't hardcode 0/1 for black/white
 // TODO: use Square instead of int or other integer types
-std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalOnly) {
-    std::vector<Move> moves;
-    const Color opponentColor = ToggleColor(colorToMove);
+template<Color colorToMove>
+MoveList GenMoves(const Board& board, bool tacticalOnly) {
+    TRACE_SAMPLE(TraceEvent::GenMoves);
+    MoveList moves;
+    constexpr Color opponentColor = ToggleColor(colorToMove);
     const Bitboard occupancy = board.Occupancy();
     const Bitboard enemyOccupancy = board.Occupancy(opponentColor);
     const Bitboard friendlyOccupancy = board.Occupancy(colorToMove);
-    const Bitboard promotionRankMask = PROMOTION_RANK_MASK[colorToMove];
-    constexpr int kingsideRookStartingSquare[2] = {7, 63};
-    constexpr int queensideRookStartingSquare[2] = {0, 56};
+    constexpr Bitboard promotionRankMask = PROMOTION_RANK_MASK[colorToMove];
 
     const Bitboard king = board.Kings(colorToMove);
     Square originalKingSquareIndex = LSB(king);
     
     Bitboard pawns = board.Pawns(colorToMove);
-    const int pawnDirection = colorToMove == White ? 8 : -8;
-    const int pawnStartRank = colorToMove == White ? 1 : 6;
+    constexpr int pawnDirection = colorToMove == White ? 8 : -8;
 
-    const Bitboard singlePushes = colorToMove == White ? (pawns << 8) & ~occupancy :
-                                                              (pawns >> 8) & ~occupancy;
+    const Bitboard singlePushes = Shift<pawnDirection>(pawns) & ~occupancy;
     Bitboard promotions = singlePushes & promotionRankMask;
     Bitboard nonPromotions = singlePushes & ~promotionRankMask;
     while (promotions) {
@@ -50,10 +47,9 @@ std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalO
         // TODO: consider makemove/unmakemove instead of creating a whole new board
         Board newBoard = board;
         newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        newBoard.enPassant = -1;
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
+        if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
             for (int i = 0; i < 4; i++) {
-                moves.emplace_back(from, to, PieceType::Pawn, PieceType::None, promotionTypes[i], newBoard.enPassant - board.enPassant);
+                moves.emplace_back(from, to, Move::Promotion, promotionTypes[i]);
             }
         }
     }
@@ -61,104 +57,63 @@ std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalO
         Square to = PopLSB(nonPromotions); 
         Square from = to - pawnDirection;
         Board newBoard = board;
-        newBoard.enPassant = -1;
         newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-            moves.emplace_back(from, to, PieceType::Pawn, PieceType::None, PieceType::None, newBoard.enPassant - board.enPassant);
+        if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
+            moves.emplace_back(from, to);
         }
     }
     
-    const Bitboard doublePushRankMask = colorToMove == White ? RANK_MASK[(int)Rank::Third] : RANK_MASK[(int)Rank::Sixth];
-    Bitboard doublePushes = colorToMove == White ? ((singlePushes & doublePushRankMask) << 8) & ~occupancy :
-                                                   ((singlePushes & doublePushRankMask) >> 8) & ~occupancy;
+    constexpr Bitboard doublePushRankMask = colorToMove == White ? RANK_MASK[(int)Rank::Third] : RANK_MASK[(int)Rank::Sixth];
+    Bitboard doublePushes = Shift<pawnDirection>(singlePushes & doublePushRankMask) & ~occupancy;
     while (!tacticalOnly && doublePushes) {
         Square to = PopLSB(doublePushes);
         Square from = to - pawnDirection * 2;
         Board newBoard = board;
         newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        newBoard.enPassant = to - pawnDirection;
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-            moves.emplace_back(from, to, PieceType::Pawn, PieceType::None, PieceType::None, newBoard.enPassant - board.enPassant);
+        if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
+            moves.emplace_back(from, to);
         }
     }
 
-    const int leftCaptureOffset = colorToMove == White ? 7 : -9; 
-    const int rightCaptureOffset = colorToMove == White ? 9 : -7;
+    constexpr int leftCaptureOffset = colorToMove == White ? 7 : -9; 
+    constexpr int rightCaptureOffset = colorToMove == White ? 9 : -7;
+    constexpr int captureOffsets[2] = { leftCaptureOffset, rightCaptureOffset };
     
     const Bitboard pawnAttackMask = board.enPassant < 0 ? enemyOccupancy : enemyOccupancy | ToBitboard(board.enPassant);
-    const Bitboard leftCaptures = (colorToMove == White ? (pawns << 7) & pawnAttackMask : (pawns >> 9) & pawnAttackMask) & ~FILE_MASK[7];
-    promotions = leftCaptures & promotionRankMask;
-    nonPromotions = leftCaptures & ~promotionRankMask;
-    while (promotions) {
-        Square to = PopLSB(promotions);
-        Square from = to - leftCaptureOffset;
-        Board newBoard = board;
-        newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        PieceType removedPieceType = RemovePiece(to, newBoard, opponentColor);
-        newBoard.enPassant = -1;
-        Move::CastlingFlags flags = Move::CastlingFlags((board.shortCastlingRight[opponentColor] && to == kingsideRookStartingSquare[opponentColor]) *
-                                         Move::RemovesOppShortCastlingRight) | 
-                            Move::CastlingFlags((board.longCastlingRight[opponentColor] && to == queensideRookStartingSquare[opponentColor]) *
-                                         Move::RemovesOppLongCastlingRight);
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-            for (int i = 0; i < 4; i++) {
-                moves.emplace_back(from, to, PieceType::Pawn, removedPieceType, promotionTypes[i], newBoard.enPassant - board.enPassant, flags);
+    const Bitboard pawnCaptures[2] = {
+        Shift<leftCaptureOffset>(pawns) & pawnAttackMask & ~FILE_MASK[7],
+        Shift<rightCaptureOffset>(pawns) & pawnAttackMask & ~FILE_MASK[0]
+    };
+    for (int side = 0; side < 2; side++) {
+        promotions = pawnCaptures[side] & promotionRankMask;
+        nonPromotions = pawnCaptures[side] & ~promotionRankMask;
+        while (promotions) {
+            Square to = PopLSB(promotions);
+            Square from = to - captureOffsets[side];
+            Board newBoard = board;
+            RemovePiece<opponentColor>(to, newBoard);
+            newBoard.Move(PieceType::Pawn, colorToMove, from, to);
+            if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
+                for (int i = 0; i < 4; i++) {
+                    moves.emplace_back(from, to, Move::Promotion, promotionTypes[i]);
+                }
             }
         }
-    }
-    while (nonPromotions) {
-        Square to = PopLSB(nonPromotions);
-        Square from = to - leftCaptureOffset;
-        Board newBoard = board;
-        newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        PieceType removedPieceType;
-        if (board.enPassant == to) {
-            removedPieceType = RemovePiece(to - pawnDirection, newBoard, opponentColor);
-        }
-        else {
-            removedPieceType = RemovePiece(to, newBoard, opponentColor);
-        }
-        newBoard.enPassant = -1;
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-            moves.emplace_back(from, to, PieceType::Pawn, removedPieceType, PieceType::None, newBoard.enPassant - board.enPassant);
-        }
-    }
-
-    const Bitboard rightCaptures = (colorToMove == White ? (pawns << 9) & pawnAttackMask : (pawns >> 7) & pawnAttackMask) & ~FILE_MASK[0];
-    promotions = rightCaptures & promotionRankMask;
-    nonPromotions = rightCaptures & ~promotionRankMask;
-    while (promotions) {
-        Square to = PopLSB(promotions);
-        Square from = to - rightCaptureOffset;
-        Board newBoard = board;
-        newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        PieceType removedPieceType = RemovePiece(to, newBoard, opponentColor);
-        newBoard.enPassant = -1;
-        Move::CastlingFlags flags = Move::CastlingFlags((board.shortCastlingRight[opponentColor] && to == kingsideRookStartingSquare[opponentColor]) *
-                                         Move::RemovesOppShortCastlingRight) | 
-                            Move::CastlingFlags((board.longCastlingRight[opponentColor] && to == queensideRookStartingSquare[opponentColor]) *
-                                         Move::RemovesOppLongCastlingRight);
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-            for (int i = 0; i < 4; i++) {
-                moves.emplace_back(from, to, PieceType::Pawn, removedPieceType, promotionTypes[i], newBoard.enPassant - board.enPassant, flags);
+        while (nonPromotions) {
+            Square to = PopLSB(nonPromotions);
+            Square from = to - captureOffsets[side];
+            Board newBoard = board;
+            bool enPassant = board.enPassant == to;
+            if (enPassant) {
+                RemovePiece<opponentColor>(to - pawnDirection, newBoard);
+            }
+            else {
+                RemovePiece<opponentColor>(to, newBoard);
+            }
+            newBoard.Move(PieceType::Pawn, colorToMove, from, to);
+            if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
+                moves.emplace_back(from, to, enPassant ? Move::EnPassant : Move::Normal);
             }
-        }
-    }
-    while (nonPromotions) {
-        Square to = PopLSB(nonPromotions);
-        Square from = to - rightCaptureOffset;
-        Board newBoard = board;
-        newBoard.Move(PieceType::Pawn, colorToMove, from, to);
-        PieceType removedPieceType;
-        if (board.enPassant == to) {
-            removedPieceType = RemovePiece(to - pawnDirection, newBoard, opponentColor);
-        }
-        else {
-            removedPieceType = RemovePiece(to, newBoard, opponentColor);
-        }
-        newBoard.enPassant = -1;
-        if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-            moves.emplace_back(from, to, PieceType::Pawn, removedPieceType, PieceType::None, newBoard.enPassant - board.enPassant);
         }
     }
 
@@ -174,18 +129,12 @@ std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalO
             Bitboard newSquareBB = ToBitboard(to);
             if ((friendlyOccupancy & newSquareBB) == 0) { // Can't move to a square occupied by a friendly piece
                 Board newBoard = board;
-                newBoard.Move(PieceType::Knight, colorToMove, from, to);
-                PieceType removedPieceType = PieceType::None;
                 if (enemyOccupancy & newSquareBB) { 
-                    removedPieceType = RemovePiece(to, newBoard, opponentColor);
+                    RemovePiece<opponentColor>(to, newBoard);
                 }
-                newBoard.enPassant = -1; 
-                if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-                    Move::CastlingFlags flags = Move::CastlingFlags((board.shortCastlingRight[opponentColor] && to == kingsideRookStartingSquare[opponentColor]) *
-                                                     Move::RemovesOppShortCastlingRight) | 
-                                        Move::CastlingFlags((board.longCastlingRight[opponentColor] && to == queensideRookStartingSquare[opponentColor]) *
-                                                     Move::RemovesOppLongCastlingRight);
-                    moves.emplace_back(from, to, PieceType::Knight, removedPieceType, PieceType::None, newBoard.enPassant - board.enPassant, flags);
+                newBoard.Move(PieceType::Knight, colorToMove, from, to);
+                if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
+                    moves.emplace_back(from, to);
                 }
             }
         }
@@ -216,24 +165,12 @@ std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalO
                 Bitboard newSquareBB = ToBitboard(to);
                 if (friendlyOccupancy & newSquareBB) continue; 
                 Board newBoard = board;
-                newBoard.Move(pieceInfo.type, colorToMove, from, to);
-                PieceType removedPieceType = PieceType::None;
                 if (enemyOccupancy & newSquareBB) {
-                    removedPieceType = RemovePiece(to, newBoard, opponentColor);
+                    RemovePiece<opponentColor>(to, newBoard);
                 } 
-                newBoard.enPassant = -1;
-                if (!underThreat(newBoard, originalKingSquareIndex, opponentColor)) {
-                    bool kingsideRookCondition = board.shortCastlingRight[colorToMove] && pieceInfo.type == PieceType::Rook && 
-                                                 from == kingsideRookStartingSquare[colorToMove];
-                    bool queensideRookCondition = board.longCastlingRight[colorToMove] && pieceInfo.type == PieceType::Rook && 
-                                                  from == queensideRookStartingSquare[colorToMove];
-                    Move::CastlingFlags flags = Move::CastlingFlags((board.shortCastlingRight[opponentColor] && to == kingsideRookStartingSquare[opponentColor]) *
-                                                     Move::RemovesOppShortCastlingRight) | 
-                                        Move::CastlingFlags((board.longCastlingRight[opponentColor] && to == queensideRookStartingSquare[opponentColor]) *
-                                                     Move::RemovesOppLongCastlingRight) |
-                                        Move::CastlingFlags(kingsideRookCondition * Move::RemovesShortCastlingRight) |
-                                        Move::CastlingFlags(queensideRookCondition * Move::RemovesLongCastlingRight);
-                    moves.emplace_back(from, to, pieceInfo.type, removedPieceType, PieceType::None, newBoard.enPassant - board.enPassant, flags);
+                newBoard.Move(pieceInfo.type, colorToMove, from, to);
+                if (!UnderThreat<opponentColor>(newBoard, originalKingSquareIndex)) {
+                    moves.emplace_back(from, to);
                 }
             }
         }
@@ -248,60 +185,46 @@ std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalO
         Bitboard newSquareBB = ToBitboard(to);
         if ((friendlyOccupancy & newSquareBB) == 0) {
             Board newBoard = board;
-            newBoard.Move(PieceType::King, colorToMove, originalKingSquareIndex, to);
-            
-            PieceType removedPieceType = PieceType::None;
             if (enemyOccupancy & newSquareBB) {
-                removedPieceType = RemovePiece(to, newBoard, opponentColor);
+                RemovePiece<opponentColor>(to, newBoard);
             }
-            if (!underThreat(newBoard, to, opponentColor)) {
-                // TODO: find a better way to handle resetting en passant. This is error 
-                // prone because it has to be done every recursive call
-                Move::CastlingFlags flags = Move::CastlingFlags((board.shortCastlingRight[opponentColor] && to == kingsideRookStartingSquare[opponentColor]) *
-                                                 Move::RemovesOppShortCastlingRight) | 
-                                    Move::CastlingFlags((board.longCastlingRight[opponentColor] && to == queensideRookStartingSquare[opponentColor]) *
-                                                 Move::RemovesOppLongCastlingRight) |
-                                    Move::CastlingFlags(board.shortCastlingRight[colorToMove] * Move::RemovesShortCastlingRight) |
-                                    Move::CastlingFlags(board.longCastlingRight[colorToMove] * Move::RemovesLongCastlingRight);
-                newBoard.enPassant = -1;
-                moves.emplace_back(originalKingSquareIndex, to, PieceType::King, removedPieceType, PieceType::None, newBoard.enPassant - board.enPassant, flags);
+            newBoard.Move(PieceType::King, colorToMove, originalKingSquareIndex, to);
+            if (!UnderThreat<opponentColor>(newBoard, to)) {
+                moves.emplace_back(originalKingSquareIndex, to);
             }
         }
     }
 
-    if (!tacticalOnly && board.shortCastlingRight[colorToMove]) {
+    if (!tacticalOnly && board.ShortCastlingRight(colorToMove)) {
         bool squaresVacant = (occupancy & ((Bitboard)1 << (originalKingSquareIndex + 1))) == 0 &&
                              (occupancy & ((Bitboard)1 << (originalKingSquareIndex + 2))) == 0;
         if (squaresVacant) {
-            bool enemyPrevents = underThreat(board, originalKingSquareIndex, opponentColor)     ||
-                                 underThreat(board, originalKingSquareIndex + 1, opponentColor) ||
-                                 underThreat(board, originalKingSquareIndex + 2, opponentColor);
+            bool enemyPrevents = UnderThreat<opponentColor>(board, originalKingSquareIndex)     ||
+                                 UnderThreat<opponentColor>(board, originalKingSquareIndex + 1) ||
+                                 UnderThreat<opponentColor>(board, originalKingSquareIndex + 2);
             if (!enemyPrevents) {
-                Square to = originalKingSquareIndex + 2;
                 // no need to check for threat, already checked above
-                Move::CastlingFlags flags = Move::CastlingFlags(board.shortCastlingRight[colorToMove] * Move::RemovesShortCastlingRight) |
-                                    Move::CastlingFlags(board.longCastlingRight[colorToMove] * Move::RemovesLongCastlingRight);
-                moves.emplace_back(originalKingSquareIndex, to, PieceType::King, PieceType::None, PieceType::None, -1 - board.enPassant, flags);
+                moves.emplace_back(originalKingSquareIndex, originalKingSquareIndex + 2, Move::Castling);
             }
         }
     }
-    if (!tacticalOnly && board.longCastlingRight[colorToMove]) {
+    if (!tacticalOnly && board.LongCastlingRight(colorToMove)) {
         bool squaresVacant = (occupancy & ((Bitboard)1 << (originalKingSquareIndex - 1))) == 0 &&
                              (occupancy & ((Bitboard)1 << (originalKingSquareIndex - 2))) == 0 &&
                              (occupancy & ((Bitboard)1 << (originalKingSquareIndex - 3))) == 0;
         if (squaresVacant) {
-            bool enemyPrevents = underThreat(board, originalKingSquareIndex, opponentColor)     ||
-                                 underThreat(board, originalKingSquareIndex - 1, opponentColor) ||
-                                 underThreat(board, originalKingSquareIndex - 2, opponentColor);
+            bool enemyPrevents = UnderThreat<opponentColor>(board, originalKingSquareIndex)     ||
+                                 UnderThreat<opponentColor>(board, originalKingSquareIndex - 1) ||
+                                 UnderThreat<opponentColor>(board, originalKingSquareIndex - 2);
             if (!enemyPrevents) {
-                Square to = originalKingSquareIndex - 2;
                 // no need to check for threat, already checked above
-                Move::CastlingFlags flags = Move::CastlingFlags(board.shortCastlingRight[colorToMove] * Move::RemovesShortCastlingRight) |
-                                    Move::CastlingFlags(board.longCastlingRight[colorToMove] * Move::RemovesLongCastlingRight);
-                moves.emplace_back(originalKingSquareIndex, to, PieceType::King, PieceType::None, PieceType::None, -1 - board.enPassant, flags);
+                moves.emplace_back(originalKingSquareIndex, originalKingSquareIndex - 2, Move::Castling);
             }
         }
     }
     
     return moves;
 }
+
+template MoveList GenMoves<White>(const Board& board, bool tacticalOnly);
+template MoveList GenMoves<Black>(const Board& board, bool tacticalOnly);
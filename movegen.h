@@ -1,37 +1,72 @@
 #pragma once
 
 #include "board.h"
+#include <array>
 #include <cstdint>
-#include <vector>
+#include <utility>
 
+// Packed 16 bit move: bits 0-5 from, 6-11 to, 12-13 promotion piece (knight to queen), 14-15 special move flag.
+// The moving and captured piece types are looked up from the board, and everything needed to take the move
+// back is returned by MakeMove as an UndoInfo.
 struct Move {
-    enum CastlingFlags : std::uint8_t {
-        None = 0,
-        RemovesShortCastlingRight = 1,
-        RemovesLongCastlingRight = 1 << 1,
-        RemovesOppShortCastlingRight = 1 << 2,
-        RemovesOppLongCastlingRight = 1 << 3
+    enum Flag : std::uint16_t {
+        Normal = 0,
+        Promotion = 1 << 14,
+        EnPassant = 2 << 14,
+        Castling = 3 << 14
     };
-    Square from, to;
-    PieceType type;
-    PieceType capturedPieceType = PieceType::None;
-    PieceType promotionType = PieceType::None;
-    std::int8_t enPassantDelta = 0;
-    CastlingFlags flags = None; 
-    // used for killer move comparison so doesn't check all members. Should probably not use equality operator tbh
-    bool operator==(const Move& other) const {
-        return from == other.from && to == other.to && promotionType == other.promotionType;
-        // return from == other.from && to == other.to && type == other.type && capturedPieceType == other.capturedPieceType;
+    std::uint16_t data;
+
+    // Trivial so move lists aren't zero filled; Move{} is the null move (a1a1)
+    Move() = default;
+    constexpr Move(Square from, Square to, Flag flag = Normal, PieceType promotionType = PieceType::Knight)
+        : data(std::uint16_t(from | (to << 6) | (((int)promotionType - (int)PieceType::Knight) << 12) | flag)) {}
+
+    constexpr Square From() const { return data & 0x3F; }
+    constexpr Square To() const { return (data >> 6) & 0x3F; }
+    constexpr Flag Type() const { return Flag(data & (3 << 14)); }
+    constexpr PieceType PromotionType() const {
+        return Type() == Promotion ? PieceType(((data >> 12) & 0x3) + (int)PieceType::Knight) : PieceType::None;
     }
+    constexpr bool operator==(const Move& other) const = default;
 };
+static_assert(sizeof(Move) == 2);
 
-inline Move::CastlingFlags operator|(Move::CastlingFlags lhs, Move::CastlingFlags rhs) {
-    return static_cast<Move::CastlingFlags>(static_cast<int>(lhs) | static_cast<int>(rhs));
-}
+// Position state a packed Move can't restore on its own. Returned by MakeMove and handed back to UndoMove.
+struct UndoInfo {
+    PieceType capturedPieceType;
+    Square enPassant;
+    std::uint8_t castlingRights;
+};
+
+// Fixed capacity move list so generating moves never allocates. 218 is the most legal moves known in any position.
+struct MoveList {
+    static constexpr int capacity = 256;
+    std::array<Move, capacity> moves;
+    int count = 0;
+
+    template<typename... Args>
+    void emplace_back(Args&&... args) { moves[count++] = Move(std::forward<Args>(args)...); }
+    void push_back(const Move& move) { moves[count++] = move; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    Move& operator[](int i) { return moves[i]; }
+    const Move& operator[](int i) const { return moves[i]; }
+    Move* begin() { return moves.data(); }
+    Move* end() { return moves.data() + count; }
+    const Move* begin() const { return moves.data(); }
+    const Move* end() const { return moves.data() + count; }
+};
 
 extern int maxDepth;
 // tacticalOnly -> captures and promotions
-std::vector<Move> GenMoves(const Board& board, Color colorToMove, bool tacticalOnly=false);
+// Specialized per color so pawn directions, promotion ranks and castling squares are compile-time constants
+template<Color colorToMove>
+MoveList GenMoves(const Board& board, bool tacticalOnly=false);
+
+inline MoveList GenMoves(const Board& board, Color colorToMove, bool tacticalOnly=false) {
+    return colorToMove == White ? GenMoves<White>(board, tacticalOnly) : GenMoves<Black>(board, tacticalOnly);
+}
 
 int IncrementCastles();
 int IncrementCaptures();
@@ -0,0 +1,93 @@
+#include "packed_position.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+constexpr std::size_t BUFFER_POSITIONS = 1 << 15; // 1 MB
+
+}
+
+PackedPosition PackPosition(const Board& board, Color colorToMove, int score, int ply, int result, int halfmoveClock) {
+    static_assert(std::endian::native == std::endian::little, "PackedPosition is written as raw little-endian memory");
+    PackedPosition position{};
+    position.occupancy = board.Occupancy();
+    Bitboard occupancy = position.occupancy;
+    for (int i = 0; occupancy; i++) {
+        std::uint8_t piece = board.mailbox[PopLSB(occupancy)];
+        position.pieces[i / 2] |= i % 2 ? piece << 4 : piece;
+    }
+    position.score = (std::int16_t)std::clamp(score, -32767, 32767);
+    position.ply = (std::uint16_t)std::min(ply, 65535);
+    position.enPassant = board.enPassant;
+    position.flags = (std::uint8_t)(colorToMove | board.castlingRights << 1);
+    position.result = (std::int8_t)result;
+    position.halfmoveClock = (std::uint8_t)std::min(halfmoveClock, 255);
+    return position;
+}
+
+void UnpackPosition(const PackedPosition& position, Board& board, Color& colorToMove) {
+    board = Board(false);
+    Bitboard occupancy = position.occupancy;
+    for (int i = 0; occupancy; i++) {
+        std::uint8_t piece = (position.pieces[i / 2] >> (i % 2 * 4)) & 0xF;
+        board.AddPiece(PieceType(piece & 7), Color(piece >> 3), PopLSB(occupancy));
+    }
+    board.enPassant = position.enPassant;
+    board.castlingRights = (position.flags >> 1) & ALL_CASTLING_RIGHTS;
+    colorToMove = Color(position.flags & 1);
+}
+
+bool PackedPositionReader::Open(const std::string& path) {
+    file = std::ifstream{path, std::ios::binary};
+    buffer.clear();
+    next = 0;
+    return (bool)file;
+}
+
+bool PackedPositionReader::Next(PackedPosition& position) {
+    if (next == buffer.size()) {
+        buffer.resize(BUFFER_POSITIONS);
+        file.read((char*)buffer.data(), buffer.size() * sizeof(PackedPosition));
+        buffer.resize(file.gcount() / sizeof(PackedPosition));
+        next = 0;
+        if (buffer.empty()) {
+            return false;
+        }
+    }
+    position = buffer[next++];
+    return true;
+}
+
+PackedPositionWriter::~PackedPositionWriter() {
+    Flush();
+}
+
+bool PackedPositionWriter::Open(const std::string& path, bool append) {
+    file = std::ofstream{path, std::ios::binary | (append ? std::ios::app : std::ios::trunc)};
+    buffer.clear();
+    buffer.reserve(BUFFER_POSITIONS);
+    return (bool)file;
+}
+
+void PackedPositionWriter::Write(const PackedPosition& position) {
+    buffer.push_back(position);
+    if (buffer.size() == BUFFER_POSITIONS) {
+        Flush();
+    }
+}
+
+void PackedPositionWriter::Write(const PackedPosition* positions, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+        Write(positions[i]);
+    }
+}
+
+bool PackedPositionWriter::Flush() {
+    if (!buffer.empty() && file.is_open()) {
+        file.write((const char*)buffer.data(), buffer.size() * sizeof(PackedPosition));
+        file.flush();
+    }
+    buffer.clear();
+    return (bool)file;
+}
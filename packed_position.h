@@ -0,0 +1,59 @@
+#pragma once
+
+#include "board.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Training positions as written by gensfen (.fpack files): a headerless stream of 32 byte little-endian records, so
+// files can be concatenated, split and shuffled record by record. The board is stored as its occupancy plus one
+// nibble (Board::mailbox encoding, type | color << 3) per occupied square in ascending square order, low nibble
+// first. 32 pieces fit in 16 bytes, which is as many as a legal position can have.
+struct PackedPosition {
+    Bitboard occupancy;
+    std::uint8_t pieces[16];
+    std::int16_t score;         // search score from the side to move's POV
+    std::uint16_t ply;          // plies since the start of the game
+    std::int8_t enPassant;      // Board::enPassant
+    std::uint8_t flags;         // bit 0 side to move, bits 1-4 castling rights
+    std::int8_t result;         // game result from the side to move's POV: 1 win, 0 draw, -1 loss
+    std::uint8_t halfmoveClock; // saturates at 255
+};
+static_assert(sizeof(PackedPosition) == 32);
+
+PackedPosition PackPosition(const Board& board, Color colorToMove, int score, int ply, int result, int halfmoveClock);
+void UnpackPosition(const PackedPosition& position, Board& board, Color& colorToMove);
+
+// Reads a position file front to back through a fixed size buffer, so files of any size stream in constant memory
+class PackedPositionReader {
+public:
+    bool Open(const std::string& path);
+    // False at the end of the file. A truncated last record is dropped.
+    bool Next(PackedPosition& position);
+
+private:
+    std::ifstream file;
+    std::vector<PackedPosition> buffer;
+    std::size_t next = 0;
+};
+
+// Collects positions and appends them to the file a buffer at a time
+class PackedPositionWriter {
+public:
+    PackedPositionWriter() = default;
+    PackedPositionWriter(const PackedPositionWriter&) = delete;
+    PackedPositionWriter& operator=(const PackedPositionWriter&) = delete;
+    ~PackedPositionWriter();
+
+    // Truncates the file unless append is set
+    bool Open(const std::string& path, bool append);
+    void Write(const PackedPosition& position);
+    void Write(const PackedPosition* positions, std::size_t count);
+    // False if any write so far failed
+    bool Flush();
+
+private:
+    std::ofstream file;
+    std::vector<PackedPosition> buffer;
+};
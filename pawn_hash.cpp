@@ -0,0 +1,20 @@
+#include "pawn_hash.h"
+
+thread_local PawnHashTable pawnHashTable;
+
+PawnHashTable::PawnHashTable() {
+    Clear();
+}
+
+void PawnHashTable::Clear() {
+    // An all-zero key would otherwise match pawnless positions with a stale shelter
+    for (PawnEntry& entry : table) {
+        entry = PawnEntry{ .pawns = { 0, 0 }, .structure = { 0, 0 }, .shelter = { 0, 0 }, .shelterKingSquare = { -1, -1 } };
+    }
+}
+
+PawnEntry& PawnHashTable::Probe(Bitboard whitePawns, Bitboard blackPawns) {
+    // Multiplicative hashing, the top bits of the product mix all bits of both bitboards
+    std::uint64_t key = whitePawns * 0x9E3779B97F4A7C15ULL ^ blackPawns * 0xC2B2AE3D27D4EB4FULL;
+    return table[key >> (64 - sizeBits)];
+}
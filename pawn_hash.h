@@ -0,0 +1,29 @@
+#pragma once
+
+#include "board.h"
+#include <cstdint>
+#include <vector>
+
+// Evaluation terms that depend only on the pawns (and, for the king shelter, on the king square) are cached here.
+// Entries are keyed by the pawn bitboards themselves, so there are no false hits; pawn structure changes rarely in
+// a search tree, so most evaluations find their entry.
+struct PawnEntry {
+    Bitboard pawns[2];             // [color], key
+    std::int16_t structure[2];     // [color], doubled and isolated pawn penalties, from color's POV
+    std::int16_t shelter[2];       // [color], pawn shield, storm and open files around the king, from color's POV
+    Square shelterKingSquare[2];   // [color], king square shelter[color] was computed for, -1 if not yet computed
+};
+
+struct PawnHashTable {
+    static constexpr int sizeBits = 14;
+
+    std::vector<PawnEntry> table{1 << sizeBits};
+
+    // Entry slot for this pawn configuration. The caller checks entry.pawns and fills the entry on a miss.
+    PawnEntry& Probe(Bitboard whitePawns, Bitboard blackPawns);
+    void Clear();
+    PawnHashTable();
+};
+
+// One per thread, like the rest of the search state
+extern thread_local PawnHashTable pawnHashTable;
@@ -5,17 +5,17 @@
 #include "utilities.h"
 
 static void printMoveWithCount(const Move& move, std::uint64_t count) {
-    int fromFile = move.from % 8;
-    int fromRank = move.from / 8;
-    int toFile = move.to % 8;
-    int toRank = move.to / 8;
+    int fromFile = move.From() % 8;
+    int fromRank = move.From() / 8;
+    int toFile = move.To() % 8;
+    int toRank = move.To() / 8;
     char fromFileChar = 'a' + fromFile;
     char toFileChar = 'a' + toFile;
     std::cout << fromFileChar << fromRank + 1 << toFileChar << toRank + 1 << ": " << count << '\n';
 }
 
 std::uint64_t perftest(Board& board, int depth, Color colorToMove, bool enablePerftDiagnostics) {
-    std::vector<Move> moves = GenMoves(board, colorToMove);
+    MoveList moves = GenMoves(board, colorToMove);
     if (depth == 1) {
         return moves.size();
     }
@@ -23,13 +23,20 @@ std::uint64_t perftest(Board& board, int depth, Color colorToMove, bool enablePe
     Color nextColorToMove = ToggleColor(colorToMove);
     Board oldBoard = board;
     for (const Move& move : moves) {
-        MakeMove(move, board, colorToMove);
-        std::uint64_t moveNodeCount = perftest(board, depth - 1, nextColorToMove, enablePerftDiagnostics);
+#ifdef USE_COPY_MAKE
+        Board childBoard = board;
+#else
+        Board& childBoard = board;
+#endif
+        [[maybe_unused]] UndoInfo undo = MakeMove(move, childBoard, colorToMove);
+        std::uint64_t moveNodeCount = perftest(childBoard, depth - 1, nextColorToMove, enablePerftDiagnostics);
         if (depth == maxDepth && enablePerftDiagnostics) {
             printMoveWithCount(move, moveNodeCount);
         }
         nodeCount += moveNodeCount;
-        UndoMove(move, board, colorToMove);
+#ifndef USE_COPY_MAKE
+        UndoMove(move, board, colorToMove, undo);
+#endif
         assert(board == oldBoard);
     }
     return nodeCount;
@@ -1,80 +1,33 @@
 #include "search.h"
 #include "attack_bitboards.h"
+#include "attack_info.h"
 #include "board.h"
 #include <chrono>
-#include "magic.h"
+#include "eval_params.h"
+#include "eval_trace.h"
 #include "movegen.h"
+#include "pawn_hash.h"
+#include "tablebase.h"
+#include "trace.h"
 #include "transposition.h"
+#include "tunables.h"
 #include "utilities.h"
 #include <algorithm>
 #include <bit>
 #include <cassert>
 #include <climits>
 #include <cstddef>
+#include <cstdlib>
 #include <cstring>
+#include <iostream>
 #include <iterator>
+#include <limits>
+#include <optional>
 #include <utility>
 #include <vector>
 
 // TODO: factor in 50 move draw rule
 
-// All of these scores from POV of white. Square XOR 56 to get score from black POV
-
-static constexpr std::array<int, 64> pawnScoreTable = {
-      0,   0,   0,   0,   0,   0,   0,   0,
-      5,  10,  10, -20, -20,  10,  10,   5,
-      5,  -5, -10,   0,   0, -10,  -5,   5,
-      0,   0,   0,  20,  20,   0,   0,   0,
-      5,   5,  10,  25,  25,  10,   5,   5,
-     10,  10,  20,  30,  30,  20,  10,  10,
-     50,  50,  50,  50,  50,  50,  50,  50,
-      0,   0,   0,   0,   0,   0,   0,   0
-};
-
-static constexpr std::array<int, 64> knightScoreTable = {
-    -50, -40, -30, -30, -30, -30, -40, -50,
-    -40, -20,   0,   5,   5,   0, -20, -40,
-    -30,   5,  10,  15,  15,  10,   5, -30,
-    -30,   0,  15,  20,  20,  15,   0, -30,
-    -30,   5,  15,  20,  20,  15,   5, -30,
-    -30,   0,  10,  15,  15,  10,   0, -30,
-    -40, -20,   0,   0,   0,   0, -20, -40,
-    -50, -40, -30, -30, -30, -30, -40, -50
-};
-
-static constexpr std::array<int, 64> bishopScoreTable = {
-    -20, -10, -10, -10, -10, -10, -10, -20,
-    -10,   5,   0,   0,   0,   0,   5, -10,
-    -10,  10,  10,  10,  10,  10,  10, -10,
-    -10,   0,  10,  10,  10,  10,   0, -10,
-    -10,   5,   5,  10,  10,   5,   5, -10,
-    -10,   0,   5,  10,  10,   5,   0, -10,
-    -10,   0,   0,   0,   0,   0,   0, -10,
-    -20, -10, -10, -10, -10, -10, -10, -20
-};
-
-static constexpr std::array<int, 64> rookScoreTable = {
-      0,   0,   0,   5,   5,   0,   0,   0,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-     -5,   0,   0,   0,   0,   0,   0,  -5,
-      5,  10,  10,  10,  10,  10,  10,   5,
-      0,   0,   0,   0,   0,   0,   0,   0
-};
-
-static constexpr std::array<int, 64> queenScoreTable = {
-    -20, -10, -10,  -5,  -5, -10, -10, -20,
-    -10,   0,   5,   0,   0,   0,   0, -10,
-    -10,   5,   5,   5,   5,   5,   0, -10,
-      0,   0,   5,   5,   5,   5,   0,  -5,
-     -5,   0,   5,   5,   5,   5,   0,  -5,
-    -10,   0,   5,   5,   5,   5,   0, -10,
-    -10,   0,   0,   0,   0,   0,   0, -10,
-    -20, -10, -10,  -5,  -5, -10, -10, -20
-};
-
 static constexpr std::array<int, 64> kingScoreTable = {
      20,  30,  10,   0,   0,  10,  30,  20,
      20,  20,   0,   0,   0,   0,  20,  20,
@@ -86,8 +39,6 @@ static constexpr std::array<int, 64> kingScoreTable = {
     -30, -40, -40, -50, -50, -40, -40, -30
 };
 
-static constexpr int pieceValues[7] = {100, 300, 300, 500, 900, 2000, 0};
-
 static int DoubledPawns(Bitboard pawns) {
     int doubled = 0;
     while (pawns) {
@@ -100,12 +51,13 @@ static int DoubledPawns(Bitboard pawns) {
     return doubled;
 }
 
-static int BlockedPawns(Bitboard pawns, Bitboard occupancy, Color color) {
-    constexpr int direction[2] = { 8, -8 };
+template<Color color>
+static int BlockedPawns(Bitboard pawns, Bitboard occupancy) {
+    constexpr int direction = color == White ? 8 : -8;
     int blocked = 0;
     while (pawns) {
         Square pawn = PopLSB(pawns);
-        Square oneForward = pawn + direction[color];
+        Square oneForward = pawn + direction;
         if (occupancy & ToBitboard(oneForward)) {
             blocked++;
         }
@@ -113,7 +65,7 @@ static int BlockedPawns(Bitboard pawns, Bitboard occupancy, Color color) {
     return blocked;
 }
 
-static int IsolatedPawns(Bitboard pawns, Color color) {
+static int IsolatedPawns(Bitboard pawns) {
     static constexpr Bitboard neighborFiles[8] = {
         FILE_MASK[1],
         FILE_MASK[0] | FILE_MASK[2],
@@ -135,44 +87,182 @@ static int IsolatedPawns(Bitboard pawns, Color color) {
     return isolated;
 }
 
-static int ComputePositionalScore(Bitboard bb, const std::array<int, 64>& scoreTable, bool black = false) {
+template<Color color>
+static int ComputePositionalScore(Bitboard bb, const std::array<int, 64>& scoreTable) {
+    constexpr int flip = color == Black ? 56 : 0;
     int score = 0;
     while (bb) {
         Square square = PopLSB(bb);
-        square ^= black * 56;
+        square ^= flip;
         score += scoreTable[square];
     }
     return score;
 }
 
-static int ComputeMobilityScore(Bitboard occupancy, Bitboard knights, Bitboard bishops, Bitboard rooks, Bitboard queens) {
-    int mobility = 0;
-    while (knights) {
-        Square knight = PopLSB(knights);
-        Bitboard moves = knightAttacks[knight];
-        mobility += std::popcount(moves);
+// Squares attacked per piece type, so several pieces of one type hitting the same square count it once
+static int ComputeMobilityScore(const AttackInfo& attacks) {
+    return std::popcount(attacks.byType[KNIGHT_OFFSET]) + std::popcount(attacks.byType[BISHOP_OFFSET]) +
+           std::popcount(attacks.byType[ROOK_OFFSET]) + std::popcount(attacks.byType[QUEEN_OFFSET]);
+}
+
+// King safety. The king zone is the king's square and the squares around it; each enemy attack on the zone costs a
+// weight by attacker type, scaled up by how many different piece types join the attack, so a lone attacker is
+// mostly ignored while a coordinated attack is expensive.
+static constexpr int kingZoneAttackWeights[6] = { 0, 20, 20, 40, 80, 0 }; // indexed by PieceType
+static constexpr int kingZoneAttackerScale[5] = { 0, 25, 60, 85, 100 };    // percent, by number of attacking types
+static constexpr int kingZoneUndefendedWeight = 10; // zone square attacked twice and not defended at all
+static constexpr int MAX_KING_ZONE_PENALTY = 500;
+
+// Non-pawn material of one side in the start position; king safety fades out as the attacker's pieces come off. A
+// function since the piece values are variables in tuning builds, otherwise it folds to a constant.
+static int StartNonPawnMaterial() {
+    return 2 * pieceValues[KNIGHT_OFFSET] + 2 * pieceValues[BISHOP_OFFSET] + 2 * pieceValues[ROOK_OFFSET] +
+           pieceValues[QUEEN_OFFSET];
+}
+
+static int PawnStructureScore(Bitboard pawns, Color color) {
+    int doubled = DoubledPawns(pawns);
+    int isolated = IsolatedPawns(pawns);
+    EVAL_TRACE(evalTrace.doubledPawns[color] = doubled; evalTrace.isolatedPawns[color] = isolated);
+    return doubledPawnPenalty * doubled + isolatedPawnPenalty * isolated;
+}
+
+// Squares on ranks strictly in front of rank, from color's POV
+template<Color color>
+static constexpr Bitboard RanksInFront(int rank) {
+    Bitboard ranks = 0;
+    for (int r = 0; r < 8; r++) {
+        if (color == White ? r > rank : r < rank) {
+            ranks |= RANK_MASK[r];
+        }
+    }
+    return ranks;
+}
+
+// Distance in ranks from the king to the closest pawn of the set in front of it, 0 if there is none
+template<Color color>
+static int ClosestPawnInFront(Bitboard pawns, int kingRank) {
+    pawns &= RanksInFront<color>(kingRank);
+    if (!pawns) {
+        return 0;
+    }
+    int pawnRank = color == White ? LSB(pawns) / 8 : (63 - std::countl_zero(pawns)) / 8;
+    return std::abs(pawnRank - kingRank);
+}
+
+template<Color color>
+static int KingShelterScore(Bitboard pawns, Bitboard oppPawns, Square kingSquare) {
+    int kingFile = kingSquare % 8;
+    int kingRank = kingSquare / 8;
+    int score = 0;
+    for (int file = std::max(kingFile - 1, 0); file <= std::min(kingFile + 1, 7); file++) {
+        Bitboard filePawns = pawns & FILE_MASK[file];
+        Bitboard fileOppPawns = oppPawns & FILE_MASK[file];
+        if (!filePawns && fileOppPawns) {
+            score += semiOpenFileNearKing;
+            EVAL_TRACE(evalTrace.semiOpenFileNearKing[color]++);
+        }
+        else if (!filePawns) {
+            score += openFileNearKing;
+            EVAL_TRACE(evalTrace.openFileNearKing[color]++);
+        }
+        else {
+            int shieldDistance = ClosestPawnInFront<color>(filePawns, kingRank);
+            if (shieldDistance >= 1 && shieldDistance <= 2) {
+                score += pawnShieldBonus[shieldDistance];
+                EVAL_TRACE(evalTrace.pawnShieldBonus[shieldDistance][color]++);
+            }
+            else {
+                score += pawnShieldMissing;
+                EVAL_TRACE(evalTrace.pawnShieldMissing[color]++);
+            }
+        }
+        int stormDistance = ClosestPawnInFront<color>(fileOppPawns, kingRank);
+        if (stormDistance >= 1 && stormDistance <= 3) {
+            score += pawnStormPenalty[stormDistance];
+            EVAL_TRACE(evalTrace.pawnStormPenalty[stormDistance][color]++);
+        }
+    }
+    return score;
+}
+
+static const PawnEntry& ProbePawnEntry(const Board& board) {
+    Bitboard whitePawns = board.Pawns(White);
+    Bitboard blackPawns = board.Pawns(Black);
+    PawnEntry& entry = pawnHashTable.Probe(whitePawns, blackPawns);
+    bool hit = entry.pawns[White] == whitePawns && entry.pawns[Black] == blackPawns;
+    // Terms taken from the cache wouldn't be traced
+    EVAL_TRACE(hit = false);
+    if (!hit) {
+        entry.pawns[White] = whitePawns;
+        entry.pawns[Black] = blackPawns;
+        entry.structure[White] = PawnStructureScore(whitePawns, White);
+        entry.structure[Black] = PawnStructureScore(blackPawns, Black);
+        entry.shelterKingSquare[White] = -1;
+        entry.shelterKingSquare[Black] = -1;
     }
-    while (bishops) {
-        Square bishop = PopLSB(bishops);
-        Bitboard moves = BishopAttack(bishop, occupancy);
-        mobility += std::popcount(moves);
+    for (Color c : { White, Black }) {
+        Square kingSquare = LSB(board.Kings(c));
+        if (entry.shelterKingSquare[c] != kingSquare) {
+            entry.shelterKingSquare[c] = kingSquare;
+            entry.shelter[c] = c == White ? KingShelterScore<White>(whitePawns, blackPawns, kingSquare)
+                                          : KingShelterScore<Black>(blackPawns, whitePawns, kingSquare);
+        }
     }
-    while (rooks) {
-        Square rook = PopLSB(rooks);
-        Bitboard moves = RookAttack(rook, occupancy);
-        mobility += std::popcount(moves);
+    return entry;
+}
+
+// Penalty for enemy attacks on the king zone of color's king, positive is bad for color
+template<Color color>
+static int KingZonePenalty(const Board& board, const AttackInfo& attacks, const AttackInfo& oppAttacks) {
+    Square kingSquare = LSB(board.Kings(color));
+    Bitboard kingZone = kingAttacks[kingSquare] | ToBitboard(kingSquare);
+    int attackUnits = 0;
+    int attackerTypes = 0;
+    for (int type = KNIGHT_OFFSET; type <= QUEEN_OFFSET; type++) {
+        int zoneAttacks = std::popcount(oppAttacks.byType[type] & kingZone);
+        attackUnits += kingZoneAttackWeights[type] * zoneAttacks;
+        attackerTypes += zoneAttacks > 0;
     }
-    while (queens) {
-        Square queen = PopLSB(queens);
-        Bitboard moves = QueenAttack(queen, occupancy);
-        mobility += std::popcount(moves);
+    if (attackerTypes == 0) {
+        return 0;
     }
-    return mobility;
+    attackUnits += kingZoneUndefendedWeight * std::popcount(oppAttacks.twice & kingZone & ~attacks.all);
+    return std::min(attackUnits * kingZoneAttackerScale[attackerTypes] / 100, MAX_KING_ZONE_PENALTY);
+}
+
+template<Color color>
+static int KingSafetyScore(const Board& board, const PawnEntry& pawnEntry, const AttackInfo& attacks,
+                           const AttackInfo& oppAttacks, int oppNonPawnMaterial) {
+    int score = pawnEntry.shelter[color] - KingZonePenalty<color>(board, attacks, oppAttacks);
+    const int startNonPawnMaterial = StartNonPawnMaterial();
+    EVAL_TRACE(evalTrace.kingSafetyScale[color] =
+                   std::min(oppNonPawnMaterial, startNonPawnMaterial) / (double)startNonPawnMaterial);
+    return score * std::min(oppNonPawnMaterial, startNonPawnMaterial) / startNonPawnMaterial;
 }
 
-bool gUseNewFeature = false;
+thread_local bool gUseNewFeature = false;
 
-static int Evaluate(const Board& board, Color color) {
+#ifdef USE_EVAL_TRACE
+thread_local EvalTrace evalTrace;
+
+static void TracePieces(const Board& board) {
+    for (Color color : { White, Black }) {
+        for (int type = PAWN_OFFSET; type <= QUEEN_OFFSET; type++) {
+            Bitboard pieces = board.bitboards2D[color][type];
+            evalTrace.pieces[type][color] = std::popcount(pieces);
+            while (pieces) {
+                evalTrace.pieceSquares[type][PopLSB(pieces) ^ (color == Black ? 56 : 0)][color]++;
+            }
+        }
+    }
+}
+#endif
+
+template<Color color>
+static int Evaluate(const Board& board) {
+    TRACE_SAMPLE(TraceEvent::Evaluate);
+    EVAL_TRACE(TracePieces(board));
     Bitboard pawnBB = board.bitboards2D[color][PAWN_OFFSET];
     Bitboard knightBB = board.bitboards2D[color][KNIGHT_OFFSET];
     Bitboard bishopBB = board.bitboards2D[color][BISHOP_OFFSET];
@@ -184,7 +274,7 @@ static int Evaluate(const Board& board, Color color) {
     int rookCount = std::popcount(rookBB);
     int queenCount = std::popcount(queenBB);
 
-    Color oppColor = ToggleColor(color);
+    constexpr Color oppColor = ToggleColor(color);
     Bitboard oppPawnBB = board.bitboards2D[oppColor][PAWN_OFFSET];
     Bitboard oppKnightBB = board.bitboards2D[oppColor][KNIGHT_OFFSET];
     Bitboard oppBishopBB = board.bitboards2D[oppColor][BISHOP_OFFSET];
@@ -203,57 +293,171 @@ static int Evaluate(const Board& board, Color color) {
                         pieceValues[QUEEN_OFFSET] * (queenCount - oppQueenCount);
 
     Bitboard occupancy = board.Occupancy();
-    int doubled = DoubledPawns(pawnBB);
-    int oppDoubled = DoubledPawns(oppPawnBB);
-    int blocked = BlockedPawns(pawnBB, occupancy, color);
-    int oppBlocked = BlockedPawns(oppPawnBB, occupancy, oppColor);
-    int isolated = IsolatedPawns(pawnBB, color);
-    int oppIsolated = IsolatedPawns(oppPawnBB, oppColor);
-    
+    const PawnEntry& pawnEntry = ProbePawnEntry(board);
+    int blocked = BlockedPawns<color>(pawnBB, occupancy);
+    int oppBlocked = BlockedPawns<oppColor>(oppPawnBB, occupancy);
+    EVAL_TRACE(evalTrace.blockedPawns[color] = blocked; evalTrace.blockedPawns[oppColor] = oppBlocked);
+
+    AttackInfo attacks = ComputeAttackInfo<color>(board);
+    AttackInfo oppAttacks = ComputeAttackInfo<oppColor>(board);
+
     // TODO: could compute mobility for sliding pieces and knights by bitwise ANDing the attack board with inverse friendly occupancy
-    // might be expensive
-    
     int mobilityScore = 0;
     if (gUseNewFeature) {
-         mobilityScore = ComputeMobilityScore(occupancy, knightBB, bishopBB, rookBB, queenBB);
-         int oppMobilityScore = ComputeMobilityScore(occupancy, oppKnightBB, oppBishopBB, oppRookBB, oppQueenBB);
-         mobilityScore -= oppMobilityScore;
+         mobilityScore = ComputeMobilityScore(attacks) - ComputeMobilityScore(oppAttacks);
     }
 
-    int pawnStructureScore = -50 * (doubled - oppDoubled + blocked - oppBlocked + isolated - oppIsolated);
-    
-    bool black = color == Black;
-    int pawnPosScore = ComputePositionalScore(pawnBB, pawnScoreTable, black);
-    int knightPosScore = ComputePositionalScore(knightBB, knightScoreTable, black);
-    int bishopPosScore = ComputePositionalScore(bishopBB, bishopScoreTable, black);
-    int rookPosScore = ComputePositionalScore(rookBB, rookScoreTable, black);
-    int queenPosScore = ComputePositionalScore(queenBB, queenScoreTable, black);
-
-    int oppPawnPosScore = ComputePositionalScore(oppPawnBB, pawnScoreTable, !black);
-    int oppKnightPosScore = ComputePositionalScore(oppKnightBB, knightScoreTable, !black);
-    int oppBishopPosScore = ComputePositionalScore(oppBishopBB, bishopScoreTable, !black);
-    int oppRookPosScore = ComputePositionalScore(oppRookBB, rookScoreTable, !black);
-    int oppQueenPosScore = ComputePositionalScore(oppQueenBB, queenScoreTable, !black);
+    int nonPawnMaterial = pieceValues[KNIGHT_OFFSET] * knightCount + pieceValues[BISHOP_OFFSET] * bishopCount +
+                          pieceValues[ROOK_OFFSET] * rookCount + pieceValues[QUEEN_OFFSET] * queenCount;
+    int oppNonPawnMaterial = pieceValues[KNIGHT_OFFSET] * oppKnightCount + pieceValues[BISHOP_OFFSET] * oppBishopCount +
+                             pieceValues[ROOK_OFFSET] * oppRookCount + pieceValues[QUEEN_OFFSET] * oppQueenCount;
+    int kingSafetyScore = KingSafetyScore<color>(board, pawnEntry, attacks, oppAttacks, oppNonPawnMaterial) -
+                          KingSafetyScore<oppColor>(board, pawnEntry, oppAttacks, attacks, nonPawnMaterial);
+
+    int pawnStructureScore = pawnEntry.structure[color] - pawnEntry.structure[oppColor] + blockedPawnPenalty * (blocked - oppBlocked);
+
+    int pawnPosScore = ComputePositionalScore<color>(pawnBB, pawnScoreTable);
+    int knightPosScore = ComputePositionalScore<color>(knightBB, knightScoreTable);
+    int bishopPosScore = ComputePositionalScore<color>(bishopBB, bishopScoreTable);
+    int rookPosScore = ComputePositionalScore<color>(rookBB, rookScoreTable);
+    int queenPosScore = ComputePositionalScore<color>(queenBB, queenScoreTable);
+
+    int oppPawnPosScore = ComputePositionalScore<oppColor>(oppPawnBB, pawnScoreTable);
+    int oppKnightPosScore = ComputePositionalScore<oppColor>(oppKnightBB, knightScoreTable);
+    int oppBishopPosScore = ComputePositionalScore<oppColor>(oppBishopBB, bishopScoreTable);
+    int oppRookPosScore = ComputePositionalScore<oppColor>(oppRookBB, rookScoreTable);
+    int oppQueenPosScore = ComputePositionalScore<oppColor>(oppQueenBB, queenScoreTable);
 
     int positionalScore = pawnPosScore - oppPawnPosScore + knightPosScore - oppKnightPosScore + bishopPosScore - oppBishopPosScore + 
                           rookPosScore - oppRookPosScore + queenPosScore - oppQueenPosScore;
 
-    return materialScore + pawnStructureScore + positionalScore + gUseNewFeature * mobilityScore;
+    return materialScore + pawnStructureScore + positionalScore + kingSafetyScore + gUseNewFeature * mobilityScore;
+}
+
+int Evaluate(const Board& board, Color color) {
+    return color == White ? Evaluate<White>(board) : Evaluate<Black>(board);
 }
 
-Move killerMoves[64][2] = {};
-int historyTable[2][64][64] = {};
-std::unordered_map<std::uint64_t, int> threefoldRepetitionTable;
-constexpr int MAX_PLY = 64;
-Move pvTable[MAX_PLY][MAX_PLY];
-int pvLength[MAX_PLY];
-std::vector<Move> principalVariation;
-Move PVmove{};
-bool isRootCall = false;
+// Search state is per thread, so independent searches can run on several threads at once
+thread_local TT* searchTT = &transpositionTable;
+thread_local std::unordered_map<std::uint64_t, int> threefoldRepetitionTable;
+static thread_local SearchHistory threadHistory{};
+thread_local SearchHistory* searchHistory = &threadHistory;
+// State of the line being searched, one frame per ply. A node at MAX_PLY returns its static evaluation without
+// searching, the extra frame is there for it to clear its PV.
+struct SearchFrame {
+    Move killers[2];
+    Move move;          // being searched from this ply
+    int piece = -1;     // PieceIndex of move, -1 for a null move
+    Move excludedMove;  // the TT move while a singular extension search runs at this ply, skipped by that search
+    int pvLength = 0;
+    Move pv[MAX_PLY];   // from this ply on
+};
+thread_local SearchFrame searchStack[MAX_PLY + 1];
+thread_local std::vector<Move> principalVariation;
+thread_local Move PVmove{};
+thread_local bool isRootCall = false;
+// MultiPV: moves already reported as better lines in this iteration are skipped at the root
+static thread_local int rootMultiPV = 1;
+static thread_local int rootDepth = 0; // of the current iteration
+static thread_local MoveList rootExcludedMoves;
+thread_local std::vector<RootLine> rootLines;
 constexpr Move NULL_MOVE = Move{};
 constexpr int INF_SCORE = 2'000'000;
+// Mate scores are MATE_SCORE - ply for a mate at that ply from the root, so shorter mates score higher. Quiescence can
+// go past MAX_PLY, but never by another MAX_PLY, so scores beyond MATE_BOUND are exactly the mate scores.
+constexpr int MATE_SCORE = 1'000'000;
+constexpr int MATE_BOUND = MATE_SCORE - 2 * MAX_PLY;
+// Below every mate score and above any evaluation
+constexpr int TB_WIN_SCORE = 900'000;
+
+// The TT stores mate scores counted from the node instead of the root, so an entry is right at any ply the position
+// is reached at
+static int ScoreToTT(int score, int ply) {
+    return score > MATE_BOUND ? score + ply : score < -MATE_BOUND ? score - ply : score;
+}
+
+static int ScoreFromTT(int score, int ply) {
+    return score > MATE_BOUND ? score - ply : score < -MATE_BOUND ? score + ply : score;
+}
+
+// The target square of an en passant capture is empty, so the captured pawn can't be read off the board there
+static PieceType CapturedPieceType(const Move& move, const Board& board, Color colorToMove) {
+    return move.Type() == Move::EnPassant ? PieceType::Pawn : PieceTypeAt(move.To(), board, ToggleColor(colorToMove));
+}
+
+// Most valuable victim, least valuable attacker
+static int CaptureScore(const Move& move, const Board& board, Color colorToMove) {
+    PieceType capturedPieceType = CapturedPieceType(move, board, colorToMove);
+    if (capturedPieceType == PieceType::None) {
+        return 0;
+    }
+    return pieceValues[(int)capturedPieceType] * 16 - pieceValues[(int)PieceTypeAt(move.From(), board, colorToMove)];
+}
+
+static int PieceIndex(const Move& move, const Board& board, Color colorToMove) {
+    return (int)board.PieceTypeAt(move.From()) * 2 + colorToMove;
+}
+
+// Continuation history entry of a quiet move with the move pliesBack plies earlier, null when there is none
+static std::int16_t* ContinuationEntry(int ply, int pliesBack, int piece, int to) {
+    if (ply < pliesBack || searchStack[ply - pliesBack].piece < 0) {
+        return nullptr;
+    }
+    const SearchFrame& previous = searchStack[ply - pliesBack];
+    return &searchHistory->continuation[previous.piece][previous.move.To()][piece][to];
+}
+
+static bool IsCounterMove(const Move& move, int ply) {
+    return ply > 0 && searchStack[ply - 1].piece >= 0 &&
+           searchHistory->counterMoves[searchStack[ply - 1].piece][searchStack[ply - 1].move.To()] == move;
+}
+
+// Sum of the butterfly and both continuation entries, scaled to stay below the killer and counter-move scores
+static int QuietHistoryScore(const Move& move, const Board& board, int ply, Color colorToMove) {
+    int piece = PieceIndex(move, board, colorToMove);
+    int score = searchHistory->butterfly[colorToMove][move.From()][move.To()];
+    for (int pliesBack = 1; pliesBack <= 2; pliesBack++) {
+        if (const std::int16_t* entry = ContinuationEntry(ply, pliesBack, piece, move.To())) {
+            score += *entry;
+        }
+    }
+    return score / 4;
+}
+
+// Gravity: the step shrinks as the entry approaches the bound on the bonus's side
+static void UpdateHistory(std::int16_t& entry, int bonus) {
+    entry = (std::int16_t)(entry + bonus - entry * std::abs(bonus) / SearchHistory::HISTORY_MAX);
+}
+
+// A quiet move caused a cutoff: reward it and penalise the quiet moves searched before it at this node, which failed to
+static void UpdateQuietHistories(const Board& board, int ply, Color colorToMove, int depth, const Move& move,
+                                 const Move* quietsTried, int quietCount) {
+    const int bonus = std::min(historyBonusScale * depth * depth, historyBonusMax);
+    auto update = [&](const Move& quiet, int quietBonus) {
+        int piece = PieceIndex(quiet, board, colorToMove);
+        UpdateHistory(searchHistory->butterfly[colorToMove][quiet.From()][quiet.To()], quietBonus);
+        for (int pliesBack = 1; pliesBack <= 2; pliesBack++) {
+            if (std::int16_t* entry = ContinuationEntry(ply, pliesBack, piece, quiet.To())) {
+                UpdateHistory(*entry, quietBonus);
+            }
+        }
+    };
+    update(move, bonus);
+    for (int i = 0; i < quietCount; i++) {
+        update(quietsTried[i], -bonus);
+    }
+    Move* killers = searchStack[ply].killers;
+    if (move != killers[0]) {
+        killers[1] = killers[0];
+        killers[0] = move;
+    }
+    if (ply > 0 && searchStack[ply - 1].piece >= 0) {
+        searchHistory->counterMoves[searchStack[ply - 1].piece][searchStack[ply - 1].move.To()] = move;
+    }
+}
 
-static int ScoreMove(const Move& move, int depth, int ply, Color colorToMove, const Move& ttMove, bool followPV) {
+static int ScoreMove(const Move& move, const Board& board, int ply, Color colorToMove, const Move& ttMove, bool followPV) {
     if (move == ttMove) {
         return 100'000;
     }
@@ -262,32 +466,42 @@ static int ScoreMove(const Move& move, int depth, int ply, Color colorToMove, co
     }
     
     int captureAndPromotionScore = 0;
-    if (move.capturedPieceType != PieceType::None) {
-        captureAndPromotionScore += 10000 + pieceValues[(int)move.capturedPieceType] * 16 - pieceValues[(int)move.type];
+    if (CapturedPieceType(move, board, colorToMove) != PieceType::None) {
+        captureAndPromotionScore += 10000 + CaptureScore(move, board, colorToMove);
     }
-    if (move.promotionType != PieceType::None) {
-        captureAndPromotionScore += 10000 + pieceValues[(int)move.promotionType];
+    if (move.Type() == Move::Promotion) {
+        captureAndPromotionScore += 10000 + pieceValues[(int)move.PromotionType()];
     }
     if (captureAndPromotionScore > 0) return captureAndPromotionScore;
     
-    // TODO: use ply for killerMoves
-    if (move == killerMoves[ply][0]) {
-        return 9000;
+    if (move == searchStack[ply].killers[0]) {
+        return killerScore1;
+    }
+    if (move == searchStack[ply].killers[1]) {
+        return killerScore2;
     }
-    if (move == killerMoves[ply][1]) {
-        return 8000;
+    if (IsCounterMove(move, ply)) {
+        return counterMoveScore;
     }
-    return historyTable[colorToMove][move.from][move.to];
+    return QuietHistoryScore(move, board, ply, colorToMove);
 }
 
-static bool MoveComparator(const Move& a, const Move& b, int depth, int ply, Color colorToMove, const Move& ttMove, bool followPV) {
-    int aScore = ScoreMove(a, depth, ply, colorToMove, ttMove, followPV);
-    int bScore = ScoreMove(b, depth, ply, colorToMove, ttMove, followPV);
-    return aScore > bScore;
+// Moves are scored once into a parallel array and picked lazily, so a cutoff on an early move skips ordering the rest
+static void PickNextMove(MoveList& moves, int* scores, int i) {
+    int best = i;
+    for (int j = i + 1; j < moves.size(); j++) {
+        if (scores[j] > scores[best]) {
+            best = j;
+        }
+    }
+    std::swap(moves[i], moves[best]);
+    std::swap(scores[i], scores[best]);
 }
 
-static constexpr int NODE_INTERVAL_CHECK = 4096;
-static int nodeCounter = NODE_INTERVAL_CHECK;
+static thread_local int nodeCounter = nodeCheckInterval;
+static thread_local std::uint64_t maxSearchNodes = 0; // 0 means no node limit
+thread_local std::uint64_t searchNodes = 0;
+thread_local std::uint64_t tablebaseHits = 0;
 static constexpr int ABORT_SEARCH_VALUE = INF_SCORE * 2;
 
 static std::uint64_t TimestampMS() {
@@ -298,81 +512,122 @@ static std::uint64_t TimestampMS() {
     return timestamp_milliseconds;
 }
 
-static int Quiesce(Board& board, int depth, Color colorToMove, Color engineColor, int alpha, int beta, std::uint64_t boardHash, std::uint64_t maxSearchTime) {
+// Checked every nodeCheckInterval nodes
+static bool LimitReached(std::uint64_t maxSearchTime) {
+    if (maxSearchNodes && searchNodes >= maxSearchNodes) {
+        return true;
+    }
+    std::uint64_t now = TimestampMS();
+    if (now >= maxSearchTime) {
+        TraceInstant(TraceEvent::TimeAbort, now - maxSearchTime);
+        return true;
+    }
+    return false;
+}
+
+// Specialized on the side to move; children call the opposite instantiation so color is never branched on per node
+template<Color colorToMove>
+static int Quiesce(Board& board, int depth, int ply, Color engineColor, int alpha, int beta, std::uint64_t boardHash, std::uint64_t maxSearchTime) {
+    constexpr Color oppColor = ToggleColor(colorToMove);
+    TRACE_SAMPLE(TraceEvent::Quiesce);
+    ++searchNodes;
     --nodeCounter;
     if (nodeCounter <= 0) {
-        nodeCounter = NODE_INTERVAL_CHECK;
+        nodeCounter = nodeCheckInterval;
         // TODO: check shared boolean variable 
-        if (TimestampMS() >= maxSearchTime) {
+        if (LimitReached(maxSearchTime)) {
             return ABORT_SEARCH_VALUE;
         }
     }
     bool engineTurn = colorToMove == engineColor;
     const int alphaOrig = alpha;
     const int betaOrig = beta;
-    const TTEntry* entry = transpositionTable.Search(boardHash);
-    if (entry &&  entry->depth == 0) {
+    const TTEntry* entry = searchTT->Search(boardHash);
+    // Any entry is at least as deep as a quiescence search, including the depth 0 ones stored here
+    if (entry && entry->depth >= 0) {
+        const int ttScore = ScoreFromTT(entry->score, ply);
         if (entry->scoreType == Exact) {
-            return entry->score;
+            return ttScore;
         }
         else if (entry->scoreType == LowerBound) {
-            if (entry->score >= beta) {
-                return entry->score;
+            if (ttScore >= beta) {
+                return ttScore;
             }
         }
         else if (entry->scoreType == UpperBound) {
-            if (entry->score <= alpha) {
-                return entry->score;
+            if (ttScore <= alpha) {
+                return ttScore;
             }
         }
     }
-    int bestScore = Evaluate(board, engineColor);
-    if (engineTurn && bestScore > alpha) {
-        alpha = bestScore;
-    }
-    if (!engineTurn && bestScore < beta) {
-        beta = bestScore;
+    const bool inCheck = InCheck<colorToMove>(board);
+    if (inCheck && depth <= -quiesceMaxDepth) {
+        // Past the depth cap the evaluation stands in even though it can't be trusted here, and isn't stored
+        return Evaluate(board, engineColor);
     }
-    if (alpha >= beta) {
-        transpositionTable.Add(board, colorToMove, 0, bestScore, engineTurn ? LowerBound : UpperBound, NULL_MOVE);
-        return bestScore;
+    int bestScore;
+    MoveList moves;
+    if (inCheck) {
+        // No standing pat in check: every evasion is searched, and having none is mate
+        moves = GenMoves<colorToMove>(board);
+        if (moves.empty()) {
+            return engineTurn ? -MATE_SCORE + ply : MATE_SCORE - ply;
+        }
+        bestScore = engineTurn ? -INF_SCORE : INF_SCORE;
     }
-    if (depth <= -8) { // stand-pat
-        transpositionTable.Add(board, colorToMove, 0, bestScore, Exact, NULL_MOVE);
-        return bestScore;
+    else {
+        bestScore = Evaluate(board, engineColor);
+        if (engineTurn && bestScore > alpha) {
+            alpha = bestScore;
+        }
+        if (!engineTurn && bestScore < beta) {
+            beta = bestScore;
+        }
+        if (alpha >= beta) {
+            searchTT->Add(boardHash, 0, bestScore, engineTurn ? LowerBound : UpperBound, NULL_MOVE);
+            return bestScore;
+        }
+        if (depth <= -quiesceMaxDepth) { // stand-pat
+            searchTT->Add(boardHash, 0, bestScore, Exact, NULL_MOVE);
+            return bestScore;
+        }
+        moves = GenMoves<colorToMove>(board, true);
+        if (moves.empty()) {
+            searchTT->Add(boardHash, 0, bestScore, Exact, NULL_MOVE);
+            return bestScore;
+        }
     }
-
-    std::vector<Move> tacticalMoves = GenMoves(board, colorToMove, true);
-    if (tacticalMoves.empty()) { 
-        transpositionTable.Add(board, colorToMove, 0, bestScore, Exact, NULL_MOVE);
-        return bestScore;
+    const Move ttMove = entry ? entry->bestMove : NULL_MOVE;
+    int moveScores[MoveList::capacity];
+    for (int i = 0; i < moves.size(); i++) {
+        const Move& move = moves[i];
+        if (move == ttMove) {
+            moveScores[i] = 100'000;
+            continue;
+        }
+        moveScores[i] = CaptureScore(move, board, colorToMove);
+        if (move.Type() == Move::Promotion) {
+            moveScores[i] += pieceValues[(int)move.PromotionType()] * 16;
+        }
     }
-    std::sort(tacticalMoves.begin(), tacticalMoves.end(), [](const Move& a, const Move& b) {
-            int aScore = 0;
-            if (a.capturedPieceType != PieceType::None) {
-                aScore += pieceValues[(int)a.capturedPieceType] * 16 - pieceValues[(int)a.type];
-            }
-            if (a.promotionType != PieceType::None) {
-                aScore += pieceValues[(int)a.promotionType] * 16;
-            }
-            int bScore = 0;
-            if (b.capturedPieceType != PieceType::None) {
-                bScore += pieceValues[(int)b.capturedPieceType] * 16 - pieceValues[(int)b.type];
-            }
-            if (b.promotionType != PieceType::None) {
-                bScore += pieceValues[(int)b.promotionType] * 16;
-            }
-            return aScore > bScore;
-    });
     ScoreType scoreType = Exact;
     Move bestMove = NULL_MOVE;
-    for (const Move& move : tacticalMoves) {
+    for (int i = 0; i < moves.size(); i++) {
+        PickNextMove(moves, moveScores, i);
+        const Move& move = moves[i];
         auto newBoardHash = boardHash;
-        MakeMove(move, board, colorToMove, newBoardHash);
+#ifdef USE_COPY_MAKE
+        Board childBoard = board;
+#else
+        Board& childBoard = board;
+#endif
+        UndoInfo undo = MakeMove<colorToMove>(move, childBoard, newBoardHash);
         int repetitionCount = ++threefoldRepetitionTable[newBoardHash];
         bool draw = repetitionCount >= 3;
-        int score = draw ? 0 : Quiesce(board, depth - 1, ToggleColor(colorToMove), engineColor, alpha, beta, newBoardHash, maxSearchTime);
-        UndoMove(move, board, colorToMove);
+        int score = draw ? 0 : Quiesce<oppColor>(childBoard, depth - 1, ply + 1, engineColor, alpha, beta, newBoardHash, maxSearchTime);
+#ifndef USE_COPY_MAKE
+        UndoMove<colorToMove>(move, board, undo);
+#endif
         --threefoldRepetitionTable[newBoardHash];
         if (score == ABORT_SEARCH_VALUE) {
             return ABORT_SEARCH_VALUE;
@@ -410,20 +665,26 @@ static int Quiesce(Board& board, int depth, Color colorToMove, Color engineColor
     if (bestScore >= betaOrig) {
         scoreType = LowerBound;
     }
-    transpositionTable.Add(board, colorToMove, 0, bestScore, scoreType, bestMove);
+    searchTT->Add(boardHash, 0, ScoreToTT(bestScore, ply), scoreType, bestMove);
     return bestScore;
 }
 
-static int Minimax(Board& board, int depth, int ply, Color colorToMove, Color engineColor, int alpha, int beta, const std::uint64_t boardHash, std::uint64_t maxSearchTime, bool followPV) {
+template<Color colorToMove>
+static int Minimax(Board& board, int depth, int ply, Color engineColor, int alpha, int beta, const std::uint64_t boardHash, std::uint64_t maxSearchTime, bool followPV) {
+    constexpr Color oppColor = ToggleColor(colorToMove);
+    ++searchNodes;
     --nodeCounter;
     if (nodeCounter <= 0) {
-        nodeCounter = NODE_INTERVAL_CHECK;
+        nodeCounter = nodeCheckInterval;
         // TODO: check shared boolean variable 
-        if (TimestampMS() >= maxSearchTime) {
+        if (LimitReached(maxSearchTime)) {
             return ABORT_SEARCH_VALUE;
         }
     }
-    pvLength[ply] = 0;
+    searchStack[ply].pvLength = 0;
+    if (ply >= MAX_PLY) {
+        return Evaluate(board, engineColor);
+    }
     bool root = isRootCall;
     if (isRootCall) {
         isRootCall = false;
@@ -431,59 +692,107 @@ static int Minimax(Board& board, int depth, int ply, Color colorToMove, Color en
     const int alphaOrig = alpha;
     const int betaOrig = beta;
     bool engineTurn = colorToMove == engineColor;
-    const TTEntry* entry = transpositionTable.Search(boardHash);
-    if (entry && entry->depth >= depth) {
+    // A singular extension search sees the position without its TT move, so the TT says nothing about it
+    const Move excludedMove = searchStack[ply].excludedMove;
+    const bool singularSearch = excludedMove != NULL_MOVE;
+    // A copy, the null move and singular searches below may replace the slot
+    std::optional<TTEntry> entry;
+    if (const TTEntry* found = searchTT->Search(boardHash)) {
+        entry = *found;
+    }
+    // With several lines the root has to be searched to get a PV per line, and its TT score is only the best line's
+    const bool rootCutoffAllowed = !root || rootMultiPV == 1;
+    if (entry && entry->depth >= depth && rootCutoffAllowed && !singularSearch) {
+        const int ttScore = ScoreFromTT(entry->score, ply);
         if (entry->scoreType == Exact) {
-            return entry->score;
+            return ttScore;
         }
         else if (entry->scoreType == LowerBound) {
-            if (entry->score >= beta) {
-                return entry->score;
+            if (ttScore >= beta) {
+                return ttScore;
             }
         }
         else if (entry->scoreType == UpperBound) {
-            if (entry->score <= alpha) {
-                return entry->score;
+            if (ttScore <= alpha) {
+                return ttScore;
             }
         }
     }
-    if (depth == 0) {
-        pvLength[ply + 1] = 0;
-        return Quiesce(board, 0, colorToMove, engineColor, alpha, beta, boardHash, maxSearchTime);
+    // Tables don't know about castling or en passant, positions with either are searched normally
+    if (!root && std::popcount(board.Occupancy()) <= TablebaseMaxPieces() && board.castlingRights == 0 && board.enPassant == -1) {
+        int wdl;
+        if (ProbeWDL(board, colorToMove, wdl)) {
+            ++tablebaseHits;
+            // Prefer wins closer to the root, like mate scores
+            int score = wdl * (TB_WIN_SCORE - ply);
+            return engineTurn ? score : -score;
+        }
+    }
+    // Internal iterative reduction: without a TT move the first move searched is mostly a guess and its subtree is
+    // often wasted, a shallower search is cheaper and leaves a TT move for the next iteration
+    if (!root && !singularSearch && depth >= iirMinDepth && (!entry || entry->bestMove == NULL_MOVE)) {
+        depth--;
+    }
+    if (depth <= 0) {
+        searchStack[ply + 1].pvLength = 0;
+        return Quiesce<colorToMove>(board, 0, ply, engineColor, alpha, beta, boardHash, maxSearchTime);
     }
 
-    std::vector<Move> moves = GenMoves(board, colorToMove);
-    bool inCheck = InCheck(board, colorToMove);
+    MoveList moves = GenMoves<colorToMove>(board);
+    bool inCheck = InCheck<colorToMove>(board);
     if (moves.empty()) { 
         if (inCheck) { // checkmate
-            return engineTurn ? -1'000'000 - depth : 1'000'000 + depth;
+            return engineTurn ? -MATE_SCORE + ply : MATE_SCORE - ply;
         }
         else { // stalemate
             return 0;
         }
     }
+    if (root && !rootExcludedMoves.empty()) {
+        // Search caps MultiPV at the number of legal moves, so some move always remains
+        MoveList remaining;
+        for (const Move& move : moves) {
+            if (std::find(rootExcludedMoves.begin(), rootExcludedMoves.end(), move) == rootExcludedMoves.end()) {
+                remaining.push_back(move);
+            }
+        }
+        moves = remaining;
+    }
+    if (singularSearch) {
+        Move* excluded = std::find(moves.begin(), moves.end(), excludedMove);
+        if (excluded != moves.end()) {
+            *excluded = moves[moves.size() - 1];
+            moves.count--;
+        }
+        // The TT move is the only legal move, which makes it as singular as a move gets
+        if (moves.empty()) {
+            return engineTurn ? alpha : beta;
+        }
+    }
     const bool pvNode = (beta - alpha) > 1;
-    bool enableNMP = !inCheck && depth > 3;
+    bool enableNMP = !inCheck && !singularSearch && depth >= nullMoveMinDepth;
     if (enableNMP) {
         Bitboard nonKingNonPawnBB = (board.Occupancy(colorToMove) & ~board.Pawns(colorToMove) & ~board.Kings(colorToMove));
         bool pawnEndgame = nonKingNonPawnBB == 0;
         enableNMP = !pawnEndgame;
     }
     if (enableNMP) {
-        int R = 2;
-        if (depth > 6) R = 3;
+        // Tuned values can make the reduction reach the depth, the null move search is then a quiescence search
+        int R = depth >= nullMoveDeepDepth ? nullMoveDeepReduction : nullMoveReduction;
 
         int a = alpha;
         int b = beta;
         if (engineTurn) a = b - 1;
         else b = a + 1;
-        auto newBoardHash = boardHash ^ transpositionTable.blackToMoveZobrist;
+        auto newBoardHash = boardHash ^ ZOBRIST_KEYS.blackToMove;
         auto originalEP = board.enPassant;
         if (board.enPassant != -1) {
-            newBoardHash ^= transpositionTable.enPassantFileZobrist[board.enPassant & 0x7];
+            newBoardHash ^= ZOBRIST_KEYS.enPassantFile[board.enPassant & 0x7];
             board.enPassant = -1;
         }
-        int nullScore = Minimax(board, depth - R, ply + 1, ToggleColor(colorToMove), engineColor, a, b, newBoardHash, maxSearchTime, false);
+        searchStack[ply].move = NULL_MOVE;
+        searchStack[ply].piece = -1;
+        int nullScore = Minimax<oppColor>(board, std::max(depth - R, 0), ply + 1, engineColor, a, b, newBoardHash, maxSearchTime, false);
         board.enPassant = originalEP; 
         if (nullScore == ABORT_SEARCH_VALUE) return ABORT_SEARCH_VALUE;
         if (engineTurn ? nullScore >= b : nullScore <= a){
@@ -491,18 +800,58 @@ static int Minimax(Board& board, int depth, int ply, Color colorToMove, Color en
         }
     }
     const Move ttMove = entry ? entry->bestMove : NULL_MOVE;
-    std::sort(moves.begin(), moves.end(), [&](const Move& a, const Move& b){ return MoveComparator(a, b, depth, ply, colorToMove, ttMove, followPV); });
+    // Singular extension: when the TT move's score is a bound that fails high for the side to move, and a reduced
+    // search without it can't get within a margin of that score, the TT move is the only good move here and its line
+    // is extended by a ply. Limited to twice the iteration depth so extensions can't chain without end.
+    int singularExtension = 0;
+    if (!root && !singularSearch && depth >= singularMinDepth && ply < 2 * rootDepth && ttMove != NULL_MOVE &&
+        entry->depth >= depth - 3 && entry->scoreType == (engineTurn ? LowerBound : UpperBound) &&
+        std::abs(entry->score) < TB_WIN_SCORE) {
+        const int margin = singularMarginPerDepth * depth;
+        const int ttScore = ScoreFromTT(entry->score, ply);
+        searchStack[ply].excludedMove = ttMove;
+        int score;
+        if (engineTurn) {
+            const int singularBeta = ttScore - margin;
+            score = Minimax<colorToMove>(board, (depth - 1) / 2, ply, engineColor, singularBeta - 1, singularBeta, boardHash, maxSearchTime, false);
+            singularExtension = score < singularBeta;
+        }
+        else {
+            const int singularAlpha = ttScore + margin;
+            score = Minimax<colorToMove>(board, (depth - 1) / 2, ply, engineColor, singularAlpha, singularAlpha + 1, boardHash, maxSearchTime, false);
+            singularExtension = score > singularAlpha;
+        }
+        searchStack[ply].excludedMove = NULL_MOVE;
+        if (score == ABORT_SEARCH_VALUE) {
+            return ABORT_SEARCH_VALUE;
+        }
+    }
+    int moveScores[MoveList::capacity];
+    for (int i = 0; i < moves.size(); i++) {
+        moveScores[i] = ScoreMove(moves[i], board, ply, colorToMove, ttMove, followPV);
+    }
     int bestScore = engineTurn ? -INF_SCORE : INF_SCORE;
     ScoreType scoreType = Exact;
     const Move* bestMove = &moves[0];
+    Move quietsTried[MoveList::capacity];
+    int quietCount = 0;
     for (int i = 0; i < moves.size(); i++) {
+        PickNextMove(moves, moveScores, i);
         const Move& move = moves[i];
+        searchStack[ply].move = move;
+        searchStack[ply].piece = PieceIndex(move, board, colorToMove);
         auto newBoardHash = boardHash;
-        MakeMove(move, board, colorToMove, newBoardHash);
+#ifdef USE_COPY_MAKE
+        Board childBoard = board;
+#else
+        Board& childBoard = board;
+#endif
+        UndoInfo undo = MakeMove<colorToMove>(move, childBoard, newBoardHash);
         int repetitionCount = ++threefoldRepetitionTable[newBoardHash];
         bool draw = repetitionCount >= 3;
         bool childFollowPV = followPV && ply < principalVariation.size() && move == principalVariation[ply];
 
+        const int newDepth = depth - 1 + (move == ttMove ? singularExtension : 0);
         bool fullWindow = !pvNode || i == 0;
         int score;
         if (draw) score = 0;
@@ -511,24 +860,28 @@ static int Minimax(Board& board, int depth, int ply, Color colorToMove, Color en
             int b = beta;
             if (engineTurn) b = a + 1;
             else a = b - 1;
-            score = Minimax(board, depth - 1, ply + 1, ToggleColor(colorToMove), engineColor, a, b, newBoardHash, maxSearchTime, childFollowPV);
+            score = Minimax<oppColor>(childBoard, newDepth, ply + 1, engineColor, a, b, newBoardHash, maxSearchTime, childFollowPV);
             if (score == ABORT_SEARCH_VALUE) goto abort;
             if (pvNode && (engineTurn ? score > a : score < b)) {
-                score = Minimax(board, depth - 1, ply + 1, ToggleColor(colorToMove), engineColor, alpha, beta, newBoardHash, maxSearchTime, childFollowPV);
+                score = Minimax<oppColor>(childBoard, newDepth, ply + 1, engineColor, alpha, beta, newBoardHash, maxSearchTime, childFollowPV);
             }
         }
-        else score = Minimax(board, depth - 1, ply + 1, ToggleColor(colorToMove), engineColor, alpha, beta, newBoardHash, maxSearchTime, childFollowPV);
+        else score = Minimax<oppColor>(childBoard, newDepth, ply + 1, engineColor, alpha, beta, newBoardHash, maxSearchTime, childFollowPV);
 
         if (score > alpha && score < beta) {
-            pvTable[ply][0] = move;
-            int n = pvLength[ply + 1];
-            std::copy(pvTable[ply + 1], pvTable[ply + 1] + n, pvTable[ply] + 1);
-            pvLength[ply] = 1 + n;
+            SearchFrame& frame = searchStack[ply];
+            const SearchFrame& child = searchStack[ply + 1];
+            frame.pv[0] = move;
+            std::copy(child.pv, child.pv + child.pvLength, frame.pv + 1);
+            frame.pvLength = 1 + child.pvLength;
         }
 
 abort:
-        UndoMove(move, board, colorToMove);
+#ifndef USE_COPY_MAKE
+        UndoMove<colorToMove>(move, board, undo);
+#endif
         --threefoldRepetitionTable[newBoardHash];
+        const bool quiet = undo.capturedPieceType == PieceType::None && move.Type() != Move::Promotion;
         if (score == ABORT_SEARCH_VALUE) {
             // TODO: find a better way to handle PV when a timeout occurs
             if (root) {
@@ -545,10 +898,8 @@ abort:
             }
             alpha = std::max(alpha, bestScore);
             if (beta <= alpha) {
-                historyTable[colorToMove][move.from][move.to] += depth * depth;
-                if (move.capturedPieceType == PieceType::None) {
-                    killerMoves[ply][1] = killerMoves[ply][0];
-                    killerMoves[ply][0] = move;
+                if (quiet) {
+                    UpdateQuietHistories(board, ply, colorToMove, depth, move, quietsTried, quietCount);
                 }
                 scoreType = LowerBound;
                 break;
@@ -561,15 +912,16 @@ abort:
             }
             beta = std::min(beta, bestScore);
             if (beta <= alpha) {
-                historyTable[colorToMove][move.from][move.to] += depth * depth;
-                if (move.capturedPieceType == PieceType::None) {
-                    killerMoves[ply][1] = killerMoves[ply][0];
-                    killerMoves[ply][0] = move;
+                if (quiet) {
+                    UpdateQuietHistories(board, ply, colorToMove, depth, move, quietsTried, quietCount);
                 }
                 scoreType = UpperBound;
                 break;
             }
         }
+        if (quiet) {
+            quietsTried[quietCount++] = move;
+        }
     }
     if (bestScore <= alphaOrig) {
         scoreType = UpperBound;
@@ -577,20 +929,68 @@ abort:
     if (bestScore >= betaOrig) {
         scoreType = LowerBound;
     }
-    transpositionTable.Add(board, colorToMove, depth, bestScore, scoreType, *bestMove);
+    // A root searched without its best moves would store a wrong score for the position, and so would a singular
+    // extension search, whose entry would also replace the one holding the TT move
+    if ((!root || rootExcludedMoves.empty()) && !singularSearch) {
+        searchTT->Add(boardHash, depth, ScoreToTT(bestScore, ply), scoreType, *bestMove);
+    }
     return bestScore;
 }
 
-Move Search(const Board& board, Color colorToMove, int totalTimeRemaining, int inc, bool useNewFeature) {
+void SearchHistory::Clear() {
+    std::memset(butterfly, 0, sizeof(butterfly));
+    std::fill(&counterMoves[0][0], &counterMoves[0][0] + PIECE_INDEXES * 64, NULL_MOVE);
+    std::memset(continuation, 0, sizeof(continuation));
+}
+
+int MateMoves(int score) {
+    if (std::abs(score) <= MATE_BOUND) {
+        return 0;
+    }
+    int plies = MATE_SCORE - std::abs(score);
+    return score > 0 ? (plies + 1) / 2 : -std::max(1, plies / 2);
+}
+
+static void PrintInfo(int depth, int multiPV, const RootLine& line, std::uint64_t elapsedMS) {
+    std::cout << "info depth " << depth << " multipv " << multiPV << " score ";
+    if (int mate = MateMoves(line.score)) {
+        std::cout << "mate " << mate;
+    }
+    else {
+        std::cout << "cp " << line.score;
+    }
+    std::cout << " nodes " << searchNodes << " time " << elapsedMS << " pv";
+    for (const Move& move : line.pv) {
+        std::cout << ' ' << MoveToUCINotation(move);
+    }
+    std::cout << std::endl;
+}
+
+Move Search(const Board& board, Color colorToMove, const SearchLimits& limits, bool useNewFeature) {
     gUseNewFeature = useNewFeature;
+    searchNodes = 0;
+    tablebaseHits = 0;
+    maxSearchNodes = limits.nodes;
+    nodeCounter = nodeCheckInterval;
+    // In a tablebase position just play the DTZ-optimal move, the table is exact
+    if (std::popcount(board.Occupancy()) <= TablebaseMaxPieces() && board.castlingRights == 0 && board.enPassant == -1) {
+        Move tablebaseMove;
+        int wdl, dtz;
+        if (ProbeRoot(board, colorToMove, tablebaseMove, wdl, dtz)) {
+            ++tablebaseHits;
+            rootLines.assign(1, RootLine{ wdl * TB_WIN_SCORE, 0, { tablebaseMove } });
+            if (limits.printInfo) {
+                PrintInfo(0, 1, rootLines[0], 0);
+            }
+            return tablebaseMove;
+        }
+    }
     std::uint64_t startTime = TimestampMS();
-    std::memset(killerMoves, 0, sizeof(killerMoves));
-    std::memset(historyTable, 0, sizeof(historyTable)); 
-    std::memset(pvLength, 0, sizeof(pvLength));
-    std::fill(&pvTable[0][0], &pvTable[0][0] + MAX_PLY * MAX_PLY, NULL_MOVE);
+    std::fill(std::begin(searchStack), std::end(searchStack), SearchFrame{});
     principalVariation.clear();
     PVmove = {};
-    int searchTime = totalTimeRemaining / 20 + inc / 2;
+    const int totalTimeRemaining = limits.time;
+    int searchTime = totalTimeRemaining / timeDivisor + limits.inc * incrementPercent / 100;
     if (searchTime > totalTimeRemaining) {
         searchTime = totalTimeRemaining - 500;
     }
@@ -598,46 +998,103 @@ Move Search(const Board& board, Color colorToMove, int totalTimeRemaining, int i
         searchTime = totalTimeRemaining;
     }
     auto maxSearchTime = startTime + searchTime;
+    if (limits.moveTime > 0) {
+        searchTime = limits.moveTime;
+        maxSearchTime = startTime + searchTime;
+    }
+    else if (limits.time <= 0) {
+        maxSearchTime = std::numeric_limits<std::uint64_t>::max();
+    }
+    TRACE_SCOPE(TraceEvent::Search, searchTime);
+    TraceInstant(TraceEvent::TimeBudget, searchTime);
     Color engineColor = colorToMove;
-    const auto boardHash = transpositionTable.Hash(board, colorToMove);
-    int score = 0;
+    const auto boardHash = searchTT->Hash(board, colorToMove);
+    rootMultiPV = std::clamp(limits.multiPV, 1, std::max(1, GenMoves(board, colorToMove).size()));
+    // Color dispatch happens once here; the rest of the tree runs on the color-specialized instantiations
+    auto searchRoot = [&](Board& rootBoard, int depth, int alpha, int beta) {
+        isRootCall = true;
+        return colorToMove == White ? Minimax<White>(rootBoard, depth, 0, engineColor, alpha, beta, boardHash, maxSearchTime, true) :
+                                      Minimax<Black>(rootBoard, depth, 0, engineColor, alpha, beta, boardHash, maxSearchTime, true);
+    };
     
-    for (int depth = 1; ;depth++) {
-        int alpha = -INF_SCORE;
-        int beta = INF_SCORE;
-        int delta = 50;
-        if (depth > 1) {
-            alpha = score - delta;
-            beta = score + delta;
-            while (true) {
+    // Lines of the last completed iteration, best first
+    rootLines.assign(rootMultiPV, RootLine{});
+    std::vector<RootLine> iterationLines(rootMultiPV);
+    for (int depth = 1; depth < MAX_PLY && (limits.depth <= 0 || depth <= limits.depth); depth++) {
+        TRACE_SCOPE(TraceEvent::Iteration, depth);
+        rootDepth = depth;
+        rootExcludedMoves.count = 0;
+        int line = 0;
+        // Each line gets its own aspiration window around its score from the previous iteration, later lines mostly
+        // hit TT entries stored while searching the earlier ones
+        for (; line < rootMultiPV; line++) {
+            principalVariation = rootLines[line].pv;
+            int alpha = -INF_SCORE;
+            int beta = INF_SCORE;
+            int delta = aspirationDelta;
+            int score = rootLines[line].score;
+            if (depth > 1) {
+                alpha = score - delta;
+                beta = score + delta;
+                while (true) {
+                    Board boardCopy = board;
+                    {
+                        TRACE_SCOPE(TraceEvent::AspirationSearch, beta - alpha);
+                        score = searchRoot(boardCopy, depth, alpha, beta);
+                    }
+                    if (score == ABORT_SEARCH_VALUE) break;
+                    if (score <= alpha) { alpha -= delta; delta *= 2; TraceInstant(TraceEvent::AspirationResearch, beta - alpha); continue; }
+                    if (score >= beta) { beta += delta; delta *= 2; TraceInstant(TraceEvent::AspirationResearch, beta - alpha); continue; }
+                    break;
+                }
+            }
+            else {
                 Board boardCopy = board;
-                isRootCall = true;
-                score = Minimax(boardCopy, depth, 0, colorToMove, engineColor, alpha, beta, boardHash, maxSearchTime, true);
-                if (score == ABORT_SEARCH_VALUE) break;
-                if (score <= alpha) { alpha -= delta; delta *= 2; continue; }
-                if (score >= beta) { beta += delta; delta *= 2; continue; }
+                score = searchRoot(boardCopy, depth, alpha, beta);
+            }
+            if (line == 0) {
+                const TTEntry* entry = searchTT->Search(boardHash);
+                if (entry) {
+                    PVmove = entry->bestMove;
+                }
+            }
+            if (score == ABORT_SEARCH_VALUE) {
                 break;
             }
+            iterationLines[line].score = score;
+            iterationLines[line].depth = depth;
+            iterationLines[line].pv.assign(searchStack[0].pv, searchStack[0].pv + searchStack[0].pvLength);
+            if (searchStack[0].pvLength > 0) {
+                rootExcludedMoves.push_back(searchStack[0].pv[0]);
+            }
         }
-        else {
-            Board boardCopy = board;
-            isRootCall = true;
-            score = Minimax(boardCopy, depth, 0, colorToMove, engineColor, alpha, beta, boardHash, maxSearchTime, true);
+        if (line < rootMultiPV) {
+            break;
+        }
+        // Lines searched later can come back better when the earlier ones were cut short by the window
+        std::stable_sort(iterationLines.begin(), iterationLines.end(),
+                         [](const RootLine& a, const RootLine& b) { return a.score > b.score; });
+        rootLines = iterationLines;
+        if (limits.printInfo) {
+            for (int i = 0; i < rootMultiPV; i++) {
+                PrintInfo(depth, i + 1, rootLines[i], TimestampMS() - startTime);
+            }
         }
-        const TTEntry* entry = transpositionTable.Search(boardHash);
-        if (entry) {
-            PVmove = entry->bestMove;
+        if (limits.onIteration) {
+            limits.onIteration(depth);
         }
-        if (score == ABORT_SEARCH_VALUE || TimestampMS() >= maxSearchTime) {
+        std::uint64_t now = TimestampMS();
+        if (now >= maxSearchTime) {
+            TraceInstant(TraceEvent::TimeAbort, now - maxSearchTime);
             break;
         }
-        else {
-            principalVariation.clear();
-            std::copy(pvTable[0], pvTable[0] + pvLength[0], std::back_inserter(principalVariation));
+        if (maxSearchNodes && searchNodes >= maxSearchNodes) {
+            break;
         }
     }
-    if (principalVariation.empty () && pvLength[0] == 0) {
-        return PVmove;
+    rootExcludedMoves.count = 0;
+    if (rootLines[0].pv.empty()) {
+        return searchStack[0].pvLength == 0 ? PVmove : searchStack[0].pv[0];
     }
-    return principalVariation.empty() ? pvTable[0][0] : principalVariation[0];
+    return rootLines[0].pv[0];
 }
@@ -2,9 +2,64 @@
 
 #include "board.h"
 #include "movegen.h"
+#include "transposition.h"
 #include <cstdint>
+#include <functional>
 #include <unordered_map>
+#include <vector>
 
-extern std::unordered_map<std::uint64_t, int> threefoldRepetitionTable;
-// Searches for the best move for colorToMove using the minimax algorithm. The move tree is searched up to a depth of maxDepth
-Move Search(const Board& board, Color colorToMove, int time, int inc, bool useNewFeature);
+// Deepest ply the search goes to. Iterations stop short of it, lines extended that far end in a static evaluation.
+constexpr int MAX_PLY = 128;
+
+struct SearchLimits {
+    int time = 0; // remaining clock time in ms, 0 means no clock
+    int inc = 0;
+    int moveTime = 0; // ms for this move regardless of the clock, 0 means none
+    int depth = 0; // 0 means iterate until time runs out
+    int multiPV = 1; // number of best root moves to search lines for, capped at the number of legal moves
+    std::uint64_t nodes = 0; // 0 means no node limit, checked every few thousand nodes
+    bool printInfo = false; // UCI info lines for every line after each completed iteration
+    // Called after each completed iteration with its depth, rootLines and searchNodes are up to date by then
+    std::function<void(int depth)> onIteration;
+};
+
+struct RootLine {
+    int score = 0; // from the side to move's POV
+    int depth = 0; // iteration the line comes from
+    std::vector<Move> pv;
+};
+
+// Quiet move ordering history. Entries are kept within +-HISTORY_MAX by gravity updates, so they follow recent cutoffs
+// rather than saturating. Searches within a game build on each other's history, Clear it when a new game or an
+// unrelated position comes up.
+struct SearchHistory {
+    static constexpr int HISTORY_MAX = 8192;
+    static constexpr int PIECE_INDEXES = 12; // PieceType * 2 + Color
+
+    std::int16_t butterfly[2][64][64]; // [color][from][to]
+    // Quiet reply that last refuted a move, by the refuted move's [piece][to]
+    Move counterMoves[PIECE_INDEXES][64];
+    // [piece][to] of the move one or two plies back, then [piece][to] of the quiet move
+    std::int16_t continuation[PIECE_INDEXES][64][PIECE_INDEXES][64];
+
+    void Clear();
+};
+
+// Search state below is thread_local: every thread runs its own independent searches
+extern thread_local std::unordered_map<std::uint64_t, int> threefoldRepetitionTable;
+// TT used by searches on this thread, the global transpositionTable unless the thread points it at its own
+extern thread_local TT* searchTT;
+// History used by searches on this thread, one per thread unless the thread points it at its own (an engine of a match)
+extern thread_local SearchHistory* searchHistory;
+// Nodes (Minimax and Quiesce calls) visited by the last call to Search
+extern thread_local std::uint64_t searchNodes;
+// Tablebase probes that ended the search of a node, including the root
+extern thread_local std::uint64_t tablebaseHits;
+// Lines of the last completed iteration of the last call to Search, best first, limits.multiPV of them
+extern thread_local std::vector<RootLine> rootLines;
+// Static evaluation in centipawns from color's POV
+int Evaluate(const Board& board, Color color);
+// Moves to mate for a root mate score (negative when getting mated), 0 for other scores
+int MateMoves(int score);
+// Searches for the best move for colorToMove using the minimax algorithm with iterative deepening until limits are reached
+Move Search(const Board& board, Color colorToMove, const SearchLimits& limits, bool useNewFeature);
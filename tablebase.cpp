@@ -0,0 +1,987 @@
+#include "tablebase.h"
+#include "mapped_file.h"
+#include "utilities.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+namespace {
+
+// Piece order inside a side of a table name, strongest first
+constexpr PieceType nameOrder[5] = { PieceType::Queen, PieceType::Rook, PieceType::Bishop, PieceType::Knight, PieceType::Pawn };
+constexpr char pieceLetters[6] = { 'P', 'N', 'B', 'R', 'Q', 'K' };
+
+constexpr std::uint8_t WDL_MAGIC[4] = { 0x71, 0xE8, 0x23, 0x5D };
+constexpr std::uint8_t DTZ_MAGIC[4] = { 0xD7, 0x66, 0x0C, 0xA5 };
+
+// Table header flags
+constexpr std::uint8_t SPLIT = 1;    // both sides to move are stored
+constexpr std::uint8_t HAS_PAWNS = 2;
+// Flags of each side and file
+constexpr std::uint8_t STM = 1;      // DTZ: the side to move stored
+constexpr std::uint8_t MAPPED = 2;   // DTZ: values go through a map
+constexpr std::uint8_t WIN_PLIES = 4;
+constexpr std::uint8_t LOSS_PLIES = 8;
+constexpr std::uint8_t WIDE = 16;    // DTZ: the map has 16 bit entries
+constexpr std::uint8_t SINGLE_VALUE = 128;
+
+// Lookup tables of the index encoding
+struct IndexTables {
+    int mapB1H1H7[64] = {};                    // squares below the a1-h8 diagonal to 0..27
+    int mapA1D1D4[64] = {};                    // the a1-d1-d4 triangle to 0..9, diagonal last
+    int mapKK[10][64] = {};                    // the 462 legal king pairs with the first king in the triangle
+    std::uint64_t binomial[7][64] = {};        // binomial[k][n] ways to choose k of n squares
+    int mapPawns[64] = {};                     // a2..h7 to 0..47, the leading pawn has the highest value
+    std::uint64_t leadPawnIdx[7][64] = {};
+    std::uint64_t leadPawnsSize[7][4] = {};
+};
+
+constexpr int DiagonalOffset(Square square) {
+    return (square >> 3) - (square & 7);
+}
+
+constexpr IndexTables GenIndexTables() {
+    IndexTables t;
+    int code = 0;
+    for (Square square = 0; square < 64; square++) {
+        if (DiagonalOffset(square) < 0) {
+            t.mapB1H1H7[square] = code++;
+        }
+    }
+    code = 0;
+    for (Square square = 0; square < 64; square++) {
+        if (DiagonalOffset(square) < 0 && (square & 7) <= 3 && (square >> 3) <= 3) {
+            t.mapA1D1D4[square] = code++;
+        }
+    }
+    for (Square square = 0; square <= 27; square += 9) { // a1, b2, c3, d4
+        t.mapA1D1D4[square] = code++;
+    }
+    code = 0;
+    int diagonalPairs[64][2] = {};
+    int diagonalPairCount = 0;
+    for (int idx = 0; idx < 10; idx++) {
+        for (Square first = 0; first <= 27; first++) {
+            if ((first & 7) > 3 || t.mapA1D1D4[first] != idx || (idx == 0 && first != 1)) { // b1 maps to 0
+                continue;
+            }
+            for (Square second = 0; second < 64; second++) {
+                int fileDistance = (first & 7) - (second & 7);
+                int rankDistance = (first >> 3) - (second >> 3);
+                if (fileDistance >= -1 && fileDistance <= 1 && rankDistance >= -1 && rankDistance <= 1) {
+                    continue; // adjacent or the same square
+                }
+                if (DiagonalOffset(first) == 0 && DiagonalOffset(second) > 0) {
+                    continue; // mirrored below the diagonal
+                }
+                if (DiagonalOffset(first) == 0 && DiagonalOffset(second) == 0) {
+                    diagonalPairs[diagonalPairCount][0] = idx;
+                    diagonalPairs[diagonalPairCount++][1] = second;
+                }
+                else {
+                    t.mapKK[idx][second] = code++;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < diagonalPairCount; i++) {
+        t.mapKK[diagonalPairs[i][0]][diagonalPairs[i][1]] = code++;
+    }
+    t.binomial[0][0] = 1;
+    for (int n = 1; n < 64; n++) {
+        for (int k = 0; k < 7 && k <= n; k++) {
+            t.binomial[k][n] = (k > 0 ? t.binomial[k - 1][n - 1] : 0) + (k < n ? t.binomial[k][n - 1] : 0);
+        }
+    }
+    int available = 47;
+    for (int leadPawns = 1; leadPawns < 7; leadPawns++) {
+        for (int file = 0; file < 4; file++) {
+            std::uint64_t idx = 0;
+            for (int rank = 1; rank <= 6; rank++) {
+                Square square = rank * 8 + file;
+                if (leadPawns == 1) {
+                    t.mapPawns[square] = available--;
+                    t.mapPawns[square ^ 7] = available--;
+                }
+                t.leadPawnIdx[leadPawns][square] = idx;
+                idx += t.binomial[leadPawns - 1][t.mapPawns[square]];
+            }
+            t.leadPawnsSize[leadPawns][file] = idx;
+        }
+    }
+    return t;
+}
+
+constexpr IndexTables indexTables = GenIndexTables();
+
+constexpr std::uint8_t SyzygyPiece(PieceType type, Color color) {
+    return (std::uint8_t)((int)type + 1 + 8 * color);
+}
+
+// Tables are looked up by material key on every probe, so it is built from piece counts without allocating: 4 bits
+// per piece type and side (kings left out), white in the low 20 bits and black above
+using MaterialKey = std::uint64_t;
+constexpr int SIDE_MATERIAL_BITS = 20;
+
+constexpr int MaterialShift(PieceType type) {
+    return 4 * (int)(std::find(nameOrder, nameOrder + 5, type) - nameOrder);
+}
+
+MaterialKey SideMaterial(const Board& board, Color color) {
+    MaterialKey material = 0;
+    for (PieceType type : nameOrder) {
+        material |= (MaterialKey)std::popcount(board.bitboards2D[color][(int)type]) << MaterialShift(type);
+    }
+    return material;
+}
+
+std::uint64_t ReadLE(const std::uint8_t* data, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (std::uint64_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+std::uint64_t ReadBE(const std::uint8_t* data, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = value << 8 | data[i];
+    }
+    return value;
+}
+
+// One side to move and leading pawn file of a table: the encoding and the compressed values, which are Huffman
+// coded symbols that each expand into a pair of symbols until a single value
+struct PairsData {
+    SyzygyEncoding encoding;
+    std::uint8_t flags = 0;
+    std::uint64_t blockSize = 0;
+    std::uint64_t span = 0;           // indices between sparse index entries
+    std::uint32_t blockCount = 0;
+    int minSymLen = 0;                // the value itself for SINGLE_VALUE
+    int maxSymLen = 0;
+    const std::uint8_t* lowestSym = nullptr;
+    const std::uint8_t* btree = nullptr;
+    std::vector<std::uint64_t> base64;
+    std::vector<std::uint8_t> symlen; // values a symbol expands into, minus one
+    const std::uint8_t* sparseIndex = nullptr;
+    std::uint64_t sparseIndexSize = 0;
+    const std::uint8_t* blockLength = nullptr;
+    std::uint64_t blockLengthSize = 0;
+    const std::uint8_t* data = nullptr;
+    std::uint16_t mapIdx[4] = {};     // DTZ map offsets for win, loss, cursed win, blessed loss
+};
+
+struct TableFile {
+    MappedFile file;
+    PairsData pairs[2][4];            // [side to move][leading pawn file]
+    const std::uint8_t* dtzMap = nullptr;
+};
+
+struct Table {
+    SyzygyMaterial material;
+    TableFile wdl;
+    std::unique_ptr<TableFile> dtz;
+};
+
+std::vector<std::unique_ptr<Table>> loadedTables;
+std::unordered_map<MaterialKey, const Table*> tables; // both color orders of each table
+int maxPieces = 0;
+
+int SymbolLeft(const PairsData& pairs, int symbol) {
+    const std::uint8_t* lr = pairs.btree + 3 * symbol;
+    return (lr[1] & 0xF) << 8 | lr[0];
+}
+
+int SymbolRight(const PairsData& pairs, int symbol) {
+    const std::uint8_t* lr = pairs.btree + 3 * symbol;
+    return lr[2] << 4 | lr[1] >> 4;
+}
+
+bool SetSymlen(PairsData& pairs, int symbol, std::vector<bool>& visited) {
+    visited[symbol] = true;
+    int right = SymbolRight(pairs, symbol);
+    if (right == 0xFFF) {
+        pairs.symlen[symbol] = 0;
+        return true;
+    }
+    int left = SymbolLeft(pairs, symbol);
+    if (left >= (int)pairs.symlen.size() || right >= (int)pairs.symlen.size()) {
+        return false;
+    }
+    if ((!visited[left] && !SetSymlen(pairs, left, visited)) || (!visited[right] && !SetSymlen(pairs, right, visited))) {
+        return false;
+    }
+    pairs.symlen[symbol] = (std::uint8_t)(pairs.symlen[left] + pairs.symlen[right] + 1);
+    return true;
+}
+
+// Reads the sizes of one side and file, returns nullptr if the file is cut short or inconsistent
+const std::uint8_t* ParseSizes(PairsData& pairs, const std::uint8_t* data, const std::uint8_t* end) {
+    if (end - data < 2) {
+        return nullptr;
+    }
+    pairs.flags = *data++;
+    if (pairs.flags & SINGLE_VALUE) {
+        pairs.minSymLen = *data++;
+        return data;
+    }
+    if (end - data < 10) {
+        return nullptr;
+    }
+    std::uint64_t tableSize = pairs.encoding.groupIdx[std::find(pairs.encoding.groupLen, pairs.encoding.groupLen + TABLEBASE_MAX_PIECES, 0) - pairs.encoding.groupLen];
+    int blockSizeBits = *data++;
+    int spanBits = *data++;
+    if (blockSizeBits > 31 || spanBits > 31) {
+        return nullptr;
+    }
+    pairs.blockSize = (std::uint64_t)1 << blockSizeBits;
+    pairs.span = (std::uint64_t)1 << spanBits;
+    pairs.sparseIndexSize = (tableSize + pairs.span - 1) / pairs.span;
+    int padding = *data++;
+    pairs.blockCount = (std::uint32_t)ReadLE(data, 4);
+    data += 4;
+    pairs.blockLengthSize = (std::uint64_t)pairs.blockCount + padding;
+    pairs.maxSymLen = *data++;
+    pairs.minSymLen = *data++;
+    if (pairs.minSymLen < 1 || pairs.maxSymLen < pairs.minSymLen || pairs.maxSymLen > 63) {
+        return nullptr;
+    }
+    pairs.lowestSym = data;
+    pairs.base64.assign(pairs.maxSymLen - pairs.minSymLen + 1, 0);
+    if (end - data < (std::ptrdiff_t)(2 * pairs.base64.size() + 2)) {
+        return nullptr;
+    }
+    // Canonical Huffman code: longer codes have lower values. base64[len] is the lowest code of that length
+    // left-aligned in 64 bits, so a code's length is the first len with base64[len] <= code.
+    for (int i = (int)pairs.base64.size() - 2; i >= 0; i--) {
+        pairs.base64[i] = (pairs.base64[i + 1] + ReadLE(pairs.lowestSym + 2 * i, 2) - ReadLE(pairs.lowestSym + 2 * (i + 1), 2)) / 2;
+    }
+    for (std::size_t i = 0; i < pairs.base64.size(); i++) {
+        pairs.base64[i] <<= 64 - i - pairs.minSymLen;
+    }
+    data += 2 * pairs.base64.size();
+    pairs.symlen.assign(ReadLE(data, 2), 0);
+    data += 2;
+    pairs.btree = data;
+    if (end - data < (std::ptrdiff_t)(3 * pairs.symlen.size() + (pairs.symlen.size() & 1))) {
+        return nullptr;
+    }
+    std::vector<bool> visited(pairs.symlen.size());
+    for (std::size_t symbol = 0; symbol < pairs.symlen.size(); symbol++) {
+        if (!visited[symbol] && !SetSymlen(pairs, (int)symbol, visited)) {
+            return nullptr;
+        }
+    }
+    return data + 3 * pairs.symlen.size() + (pairs.symlen.size() & 1);
+}
+
+// The pieces of every encoding must be the table's, with the groups the index encoding expects
+bool CheckEncoding(const SyzygyMaterial& material, const SyzygyEncoding& encoding, const std::uint8_t* expected) {
+    std::uint8_t pieces[TABLEBASE_MAX_PIECES];
+    std::copy(encoding.pieces, encoding.pieces + material.pieceCount, pieces);
+    std::sort(pieces, pieces + material.pieceCount);
+    if (!std::equal(pieces, pieces + material.pieceCount, expected)) {
+        return false;
+    }
+    if (material.hasPawns) {
+        std::uint8_t leadPawn = SyzygyPiece(PieceType::Pawn, material.leadColor);
+        return encoding.pieces[0] == leadPawn && encoding.groupLen[0] == material.pawnCount[0] &&
+               (!material.pawnCount[1] || (encoding.pieces[material.pawnCount[0]] == (leadPawn ^ 8) && encoding.groupLen[1] == material.pawnCount[1]));
+    }
+    return encoding.groupLen[0] == (material.hasUniquePieces ? 3 : 2);
+}
+
+bool ParseTableFile(TableFile& table, const SyzygyMaterial& material, bool dtz) {
+    const std::uint8_t* base = (const std::uint8_t*)table.file.Data();
+    const std::uint8_t* end = base + table.file.Size();
+    const std::uint8_t* data = base;
+    if (end - data < 5 || !std::equal(data, data + 4, dtz ? DTZ_MAGIC : WDL_MAGIC)) {
+        return false;
+    }
+    data += 4;
+    bool split = *data & SPLIT;
+    if (split != (material.key != material.key2) || bool(*data & HAS_PAWNS) != material.hasPawns) {
+        return false;
+    }
+    data++;
+
+    std::uint8_t expected[TABLEBASE_MAX_PIECES];
+    int count = 0;
+    for (Color color : { White, Black }) {
+        MaterialKey side = (color == White ? material.key : material.key >> SIDE_MATERIAL_BITS) & ((1 << SIDE_MATERIAL_BITS) - 1);
+        expected[count++] = SyzygyPiece(PieceType::King, color);
+        for (PieceType type : nameOrder) {
+            for (MaterialKey i = 0; i < (side >> MaterialShift(type) & 0xF); i++) {
+                expected[count++] = SyzygyPiece(type, color);
+            }
+        }
+    }
+    std::sort(expected, expected + count);
+
+    const int sides = !dtz && split ? 2 : 1;
+    const int files = material.hasPawns ? 4 : 1;
+    const bool bothPawns = material.hasPawns && material.pawnCount[1];
+    for (int file = 0; file < files; file++) {
+        if (end - data < 1 + bothPawns + material.pieceCount) {
+            return false;
+        }
+        const int order[2][2] = { { *data & 0xF, bothPawns ? data[1] & 0xF : 0xF },
+                                  { *data >> 4, bothPawns ? data[1] >> 4 : 0xF } };
+        data += 1 + bothPawns;
+        for (int i = 0; i < material.pieceCount; i++, data++) {
+            for (int stm = 0; stm < sides; stm++) {
+                table.pairs[stm][file].encoding.pieces[i] = stm ? *data >> 4 : *data & 0xF;
+            }
+        }
+        for (int stm = 0; stm < sides; stm++) {
+            SyzygyEncoding& encoding = table.pairs[stm][file].encoding;
+            SetSyzygyGroups(material, encoding, order[stm], file);
+            if (!CheckEncoding(material, encoding, expected)) {
+                return false;
+            }
+        }
+    }
+    data += (data - base) & 1;
+
+    for (int file = 0; file < files; file++) {
+        for (int stm = 0; stm < sides; stm++) {
+            data = ParseSizes(table.pairs[stm][file], data, end);
+            if (!data) {
+                return false;
+            }
+        }
+    }
+
+    if (dtz) {
+        table.dtzMap = data;
+        for (int file = 0; file < files; file++) {
+            PairsData& pairs = table.pairs[0][file];
+            if (!(pairs.flags & MAPPED)) {
+                continue;
+            }
+            if (pairs.flags & WIDE) {
+                data += (data - base) & 1;
+                for (int i = 0; i < 4; i++) {
+                    if (end - data < 2) {
+                        return false;
+                    }
+                    pairs.mapIdx[i] = (std::uint16_t)((data - table.dtzMap) / 2 + 1);
+                    data += 2 * ReadLE(data, 2) + 2;
+                }
+            }
+            else {
+                for (int i = 0; i < 4; i++) {
+                    if (end - data < 1) {
+                        return false;
+                    }
+                    pairs.mapIdx[i] = (std::uint16_t)(data - table.dtzMap + 1);
+                    data += *data + 1;
+                }
+            }
+        }
+        data += (data - base) & 1;
+    }
+
+    for (int file = 0; file < files; file++) {
+        for (int stm = 0; stm < sides; stm++) {
+            PairsData& pairs = table.pairs[stm][file];
+            pairs.sparseIndex = data;
+            data += 6 * pairs.sparseIndexSize;
+        }
+    }
+    for (int file = 0; file < files; file++) {
+        for (int stm = 0; stm < sides; stm++) {
+            PairsData& pairs = table.pairs[stm][file];
+            pairs.blockLength = data;
+            data += 2 * pairs.blockLengthSize;
+        }
+    }
+    for (int file = 0; file < files; file++) {
+        for (int stm = 0; stm < sides; stm++) {
+            PairsData& pairs = table.pairs[stm][file];
+            data += (64 - (data - base) % 64) % 64;
+            pairs.data = data;
+            data += pairs.blockCount * pairs.blockSize;
+        }
+    }
+    return data <= end;
+}
+
+int DecompressPairs(const PairsData& pairs, std::uint64_t index) {
+    if (pairs.flags & SINGLE_VALUE) {
+        return pairs.minSymLen;
+    }
+    // Sparse index entry k points at the block and offset of index k * span + span / 2, walk from there
+    std::uint64_t k = index / pairs.span;
+    const std::uint8_t* entry = pairs.sparseIndex + 6 * k;
+    std::uint32_t block = (std::uint32_t)ReadLE(entry, 4);
+    std::int64_t offset = (std::int64_t)ReadLE(entry + 4, 2) + (std::int64_t)(index % pairs.span) - (std::int64_t)(pairs.span / 2);
+    while (offset < 0) {
+        offset += (std::int64_t)ReadLE(pairs.blockLength + 2 * --block, 2) + 1;
+    }
+    while (offset > (std::int64_t)ReadLE(pairs.blockLength + 2 * block, 2)) {
+        offset -= (std::int64_t)ReadLE(pairs.blockLength + 2 * block++, 2) + 1;
+    }
+
+    const std::uint8_t* ptr = pairs.data + block * pairs.blockSize;
+    std::uint64_t buffer = ReadBE(ptr, 8);
+    ptr += 8;
+    int bufferBits = 64;
+    int symbol;
+    while (true) {
+        int len = 0;
+        while (buffer < pairs.base64[len]) {
+            len++;
+        }
+        symbol = (int)((buffer - pairs.base64[len]) >> (64 - len - pairs.minSymLen));
+        symbol += (int)ReadLE(pairs.lowestSym + 2 * len, 2);
+        if (offset < pairs.symlen[symbol] + 1) {
+            break;
+        }
+        offset -= pairs.symlen[symbol] + 1;
+        len += pairs.minSymLen;
+        buffer <<= len;
+        bufferBits -= len;
+        if (bufferBits <= 32) {
+            bufferBits += 32;
+            buffer |= ReadBE(ptr, 4) << (64 - bufferBits);
+            ptr += 4;
+        }
+    }
+    // The symbol stands for symlen + 1 values, descend its pairs to the one at offset
+    while (pairs.symlen[symbol]) {
+        int left = SymbolLeft(pairs, symbol);
+        if (offset < pairs.symlen[left] + 1) {
+            symbol = left;
+        }
+        else {
+            offset -= pairs.symlen[left] + 1;
+            symbol = SymbolRight(pairs, symbol);
+        }
+    }
+    return SymbolLeft(pairs, symbol);
+}
+
+// WDL values including the fifty move rule: cursed wins and blessed losses are decided but take too long
+enum WDLScore { WDLLoss = -2, WDLBlessedLoss = -1, WDLDraw = 0, WDLCursedWin = 1, WDLWin = 2 };
+
+enum class ProbeState {
+    Fail,
+    Ok,
+    ChangeSTM,        // the DTZ table only stores the other side to move
+    ZeroingBestMove   // the best move is a capture or pawn move, the table value doesn't matter
+};
+
+int Sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+// Reads a WDL value, or for dtz the DTZ of a position with the given WDL value in plies
+int ProbeTable(const Board& board, Color colorToMove, bool dtz, WDLScore wdl, ProbeState& state) {
+    MaterialKey white = SideMaterial(board, White);
+    MaterialKey black = SideMaterial(board, Black);
+    if (white == 0 && black == 0) { // KvK
+        return 0;
+    }
+    MaterialKey key = white | black << SIDE_MATERIAL_BITS;
+    auto it = tables.find(key);
+    const TableFile* file = it == tables.end() ? nullptr : dtz ? it->second->dtz.get() : &it->second->wdl;
+    if (!file) {
+        state = ProbeState::Fail;
+        return 0;
+    }
+    const SyzygyMaterial& material = it->second->material;
+    // Tables store the stronger side as white, and symmetric material only with white to move
+    bool flip = key != material.key || (material.key == material.key2 && colorToMove == Black);
+    SyzygyPosition position = NormalizeSyzygyPosition(material, board, colorToMove, flip);
+    const PairsData& pairs = file->pairs[dtz ? 0 : position.stm][position.file];
+    if (dtz && (pairs.flags & STM) != position.stm && !(material.key == material.key2 && !material.hasPawns)) {
+        state = ProbeState::ChangeSTM;
+        return 0;
+    }
+    std::uint64_t index = SyzygyIndex(material, pairs.encoding, position);
+    if (!(pairs.flags & SINGLE_VALUE) && index >= pairs.sparseIndexSize * pairs.span) {
+        state = ProbeState::Fail;
+        return 0;
+    }
+    int value = DecompressPairs(pairs, index);
+    if (!dtz) {
+        return value - 2;
+    }
+    constexpr int wdlMap[5] = { 1, 3, 0, 2, 0 };
+    if (pairs.flags & MAPPED) {
+        int mapIndex = pairs.mapIdx[wdlMap[wdl + 2]] + value;
+        value = pairs.flags & WIDE ? (int)ReadLE(file->dtzMap + 2 * mapIndex, 2) : file->dtzMap[mapIndex];
+    }
+    // Values are in moves unless the table says plies; within the fifty move rule they always are in moves
+    if ((wdl == WDLWin && !(pairs.flags & WIN_PLIES)) || (wdl == WDLLoss && !(pairs.flags & LOSS_PLIES)) ||
+        wdl == WDLCursedWin || wdl == WDLBlessedLoss) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+bool IsCapture(const Board& board, const Move& move) {
+    return move.Type() == Move::EnPassant || board.PieceTypeAt(move.To()) != PieceType::None;
+}
+
+// Tables don't store positions where a capture (or, for DTZ, a pawn move) is at least as good as the table value
+// would be, so those moves are searched before the table is read. state is ZeroingBestMove if one of them is best.
+WDLScore SearchWDL(const Board& board, Color colorToMove, bool checkZeroingMoves, ProbeState& state) {
+    WDLScore bestValue = WDLLoss;
+    MoveList moves = GenMoves(board, colorToMove);
+    std::size_t moveCount = 0;
+    for (const Move& move : moves) {
+        if (!IsCapture(board, move) && (!checkZeroingMoves || board.PieceTypeAt(move.From()) != PieceType::Pawn)) {
+            continue;
+        }
+        moveCount++;
+        Board child = board;
+        MakeMove(move, child, colorToMove);
+        WDLScore value = WDLScore(-SearchWDL(child, ToggleColor(colorToMove), false, state));
+        if (state == ProbeState::Fail) {
+            return WDLDraw;
+        }
+        if (value > bestValue) {
+            bestValue = value;
+            if (value >= WDLWin) {
+                state = ProbeState::ZeroingBestMove;
+                return value;
+            }
+        }
+    }
+    // With only zeroing moves available the table value isn't needed, and may not even be stored
+    bool noMoreMoves = moveCount && moveCount == moves.size();
+    WDLScore value = bestValue;
+    if (!noMoreMoves) {
+        state = ProbeState::Ok;
+        value = WDLScore(ProbeTable(board, colorToMove, false, WDLDraw, state));
+        if (state == ProbeState::Fail) {
+            return WDLDraw;
+        }
+    }
+    if (bestValue >= value) {
+        state = bestValue > WDLDraw || noMoreMoves ? ProbeState::ZeroingBestMove : ProbeState::Ok;
+        return bestValue;
+    }
+    state = ProbeState::Ok;
+    return value;
+}
+
+int DTZBeforeZeroing(WDLScore wdl) {
+    return wdl == WDLWin ? 1 : wdl == WDLCursedWin ? 101 : wdl == WDLBlessedLoss ? -101 : wdl == WDLLoss ? -1 : 0;
+}
+
+// Signed DTZ in plies, 100 more for cursed wins and blessed losses
+int SearchDTZ(const Board& board, Color colorToMove, WDLScore& wdl, ProbeState& state) {
+    state = ProbeState::Ok;
+    wdl = SearchWDL(board, colorToMove, true, state);
+    if (state == ProbeState::Fail || wdl == WDLDraw) {
+        return 0;
+    }
+    if (state == ProbeState::ZeroingBestMove) {
+        return DTZBeforeZeroing(wdl);
+    }
+    int dtz = ProbeTable(board, colorToMove, true, wdl, state);
+    if (state == ProbeState::Fail) {
+        return 0;
+    }
+    if (state != ProbeState::ChangeSTM) {
+        return (dtz + 100 * (wdl == WDLBlessedLoss || wdl == WDLCursedWin)) * Sign(wdl);
+    }
+    // The table only has the other side to move: take the best DTZ over our moves, one ply deeper
+    int minDTZ = INT_MAX;
+    for (const Move& move : GenMoves(board, colorToMove)) {
+        bool zeroing = IsCapture(board, move) || board.PieceTypeAt(move.From()) == PieceType::Pawn;
+        Board child = board;
+        MakeMove(move, child, colorToMove);
+        Color opponent = ToggleColor(colorToMove);
+        WDLScore childWdl;
+        if (zeroing) {
+            childWdl = SearchWDL(child, opponent, false, state);
+            dtz = -DTZBeforeZeroing(childWdl);
+        }
+        else {
+            dtz = -SearchDTZ(child, opponent, childWdl, state);
+        }
+        if (state == ProbeState::Fail) {
+            return 0;
+        }
+        // Mate zeroes like a capture
+        if (dtz == 1 && InCheck(child, opponent) && GenMoves(child, opponent).empty()) {
+            minDTZ = 1;
+        }
+        if (!zeroing) {
+            dtz += Sign(dtz);
+        }
+        if (dtz < minDTZ && Sign(dtz) == Sign(wdl)) {
+            minDTZ = dtz;
+        }
+    }
+    return minDTZ == INT_MAX ? -1 : minDTZ;
+}
+
+std::string SideName(const Board& board, Color color) {
+    std::string name = "K";
+    for (PieceType type : nameOrder) {
+        name.append(std::popcount(board.bitboards2D[color][(int)type]), pieceLetters[(int)type]);
+    }
+    return name;
+}
+
+// Sorts like Syzygy names: more pieces first, then piece by piece from the strongest
+std::string SideRank(const std::string& side) {
+    std::string rank(1, (char)side.size());
+    for (std::size_t i = 1; i < side.size(); i++) {
+        rank += (char)(5 - (std::find_if(nameOrder, nameOrder + 5, [&](PieceType type) { return pieceLetters[(int)type] == side[i]; }) - nameOrder));
+    }
+    return rank;
+}
+
+std::vector<std::string> SplitPath(const std::string& path) {
+#ifdef _WIN32
+    constexpr char separator = ';';
+#else
+    constexpr char separator = ':';
+#endif
+    std::vector<std::string> directories;
+    std::size_t start = 0;
+    while (start <= path.size()) {
+        std::size_t end = std::min(path.find(separator, start), path.size());
+        if (end > start) {
+            directories.push_back(path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return directories;
+}
+
+}
+
+std::string TablebaseName(const Board& board, bool& flipped) {
+    std::string white = SideName(board, White);
+    std::string black = SideName(board, Black);
+    flipped = SideRank(black) > SideRank(white);
+    return flipped ? black + 'v' + white : white + 'v' + black;
+}
+
+std::vector<Piece> TablebasePieces(const std::string& name) {
+    std::size_t separator = name.find('v');
+    if (separator == std::string::npos) {
+        return {};
+    }
+    std::vector<Piece> pieces;
+    const std::string sides[2] = { name.substr(0, separator), name.substr(separator + 1) };
+    for (Color color : { White, Black }) {
+        const std::string& side = sides[color];
+        if (side.empty() || side[0] != 'K') {
+            return {};
+        }
+        pieces.push_back({ PieceType::King, color });
+        int order = 0;
+        for (std::size_t i = 1; i < side.size(); i++) {
+            while (order < 5 && pieceLetters[(int)nameOrder[order]] != side[i]) {
+                order++;
+            }
+            if (order == 5) { // unknown letter, second king or out of order
+                return {};
+            }
+            pieces.push_back({ nameOrder[order], color });
+        }
+    }
+    if (pieces.size() > TABLEBASE_MAX_PIECES) {
+        return {};
+    }
+    return pieces;
+}
+
+bool ParseSyzygyMaterial(const std::string& name, SyzygyMaterial& material) {
+    std::vector<Piece> pieces = TablebasePieces(name);
+    if (pieces.empty()) {
+        return false;
+    }
+    material = SyzygyMaterial{};
+    int counts[2][6] = {};
+    for (const Piece& piece : pieces) {
+        counts[piece.color][(int)piece.type]++;
+        if (piece.type != PieceType::King) {
+            material.key += (MaterialKey)1 << (MaterialShift(piece.type) + SIDE_MATERIAL_BITS * piece.color);
+            material.key2 += (MaterialKey)1 << (MaterialShift(piece.type) + SIDE_MATERIAL_BITS * ToggleColor(piece.color));
+        }
+    }
+    material.pieceCount = (int)pieces.size();
+    for (Color color : { White, Black }) {
+        for (int type = (int)PieceType::Pawn; type < (int)PieceType::King; type++) {
+            material.hasUniquePieces |= counts[color][type] == 1;
+        }
+    }
+    int whitePawns = counts[White][(int)PieceType::Pawn];
+    int blackPawns = counts[Black][(int)PieceType::Pawn];
+    material.hasPawns = whitePawns || blackPawns;
+    // With pawns on both sides the one with fewer leads, it compresses better
+    material.leadColor = !blackPawns || (whitePawns && blackPawns >= whitePawns) ? White : Black;
+    material.pawnCount[0] = material.leadColor == White ? whitePawns : blackPawns;
+    material.pawnCount[1] = material.leadColor == White ? blackPawns : whitePawns;
+    return true;
+}
+
+void SetSyzygyGroups(const SyzygyMaterial& material, SyzygyEncoding& encoding, const int order[2], int file) {
+    // The leading group is the leading pawns, or the first three (two if no piece is unique) pieces of a pawnless
+    // table; after it come runs of equal pieces
+    int groups = 0;
+    int firstLen = material.hasPawns ? 0 : material.hasUniquePieces ? 3 : 2;
+    encoding.groupLen[0] = 1;
+    for (int i = 1; i < material.pieceCount; i++) {
+        if (--firstLen > 0 || encoding.pieces[i] == encoding.pieces[i - 1]) {
+            encoding.groupLen[groups]++;
+        }
+        else {
+            encoding.groupLen[++groups] = 1;
+        }
+    }
+    encoding.groupLen[++groups] = 0;
+
+    const bool bothPawns = material.hasPawns && material.pawnCount[1];
+    int next = bothPawns ? 2 : 1;
+    int freeSquares = 64 - encoding.groupLen[0] - (bothPawns ? encoding.groupLen[1] : 0);
+    std::uint64_t idx = 1;
+    for (int k = 0; next < groups || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            encoding.groupIdx[0] = idx;
+            idx *= material.hasPawns ? indexTables.leadPawnsSize[encoding.groupLen[0]][file] : material.hasUniquePieces ? 31332 : 462;
+        }
+        else if (k == order[1]) {
+            encoding.groupIdx[1] = idx;
+            idx *= indexTables.binomial[encoding.groupLen[1]][48 - encoding.groupLen[0]];
+        }
+        else {
+            encoding.groupIdx[next] = idx;
+            idx *= indexTables.binomial[encoding.groupLen[next]][freeSquares];
+            freeSquares -= encoding.groupLen[next++];
+        }
+    }
+    encoding.groupIdx[groups] = idx;
+}
+
+SyzygyPosition NormalizeSyzygyPosition(const SyzygyMaterial& material, const Board& board, Color colorToMove, bool flip) {
+    SyzygyPosition position;
+    const int flipColor = flip ? 8 : 0;
+    const int flipSquares = flip ? 56 : 0;
+    position.stm = flip ^ (colorToMove == Black);
+    int size = 0;
+    Bitboard leadPawns = 0;
+    if (material.hasPawns) {
+        leadPawns = board.Pawns(flip ? ToggleColor(material.leadColor) : material.leadColor);
+        for (Bitboard pawns = leadPawns; pawns;) {
+            position.squares[size++] = PopLSB(pawns) ^ flipSquares;
+        }
+        position.leadPawnCount = size;
+        auto byMapPawns = [](Square a, Square b) { return indexTables.mapPawns[a] < indexTables.mapPawns[b]; };
+        std::swap(position.squares[0], *std::max_element(position.squares, position.squares + size, byMapPawns));
+        int file = position.squares[0] & 7;
+        position.file = std::min(file, 7 - file);
+    }
+    for (Bitboard pieces = board.Occupancy() ^ leadPawns; pieces;) {
+        Square square = PopLSB(pieces);
+        Piece piece = board.PieceAt(square);
+        position.squares[size] = square ^ flipSquares;
+        position.pieces[size++] = SyzygyPiece(piece.type, piece.color) ^ flipColor;
+    }
+    return position;
+}
+
+std::uint64_t SyzygyIndex(const SyzygyMaterial& material, const SyzygyEncoding& encoding, SyzygyPosition position) {
+    const int size = std::min(material.pieceCount, TABLEBASE_MAX_PIECES);
+    const int leadPawnCount = position.leadPawnCount;
+    Square* squares = position.squares;
+    std::uint8_t* pieces = position.pieces;
+    // Put the pieces in the table's order
+    for (int i = leadPawnCount; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (encoding.pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+    // Mirror so the leading piece is on files a..d
+    if ((squares[0] & 7) > 3) {
+        for (int i = 0; i < size; i++) {
+            squares[i] ^= 7;
+        }
+    }
+
+    std::uint64_t idx;
+    if (material.hasPawns) {
+        idx = indexTables.leadPawnIdx[leadPawnCount][squares[0]];
+        auto byMapPawns = [](Square a, Square b) { return indexTables.mapPawns[a] < indexTables.mapPawns[b]; };
+        std::stable_sort(squares + 1, squares + leadPawnCount, byMapPawns);
+        for (int i = 1; i < leadPawnCount; i++) {
+            idx += indexTables.binomial[i][indexTables.mapPawns[squares[i]]];
+        }
+    }
+    else {
+        // Without pawns the board also mirrors vertically and along the a1-h8 diagonal, bringing the leading piece
+        // into the a1-d1-d4 triangle and the first leading piece off the diagonal below it
+        if ((squares[0] >> 3) > 3) {
+            for (int i = 0; i < size; i++) {
+                squares[i] ^= 56;
+            }
+        }
+        for (int i = 0; i < encoding.groupLen[0]; i++) {
+            if (DiagonalOffset(squares[i]) == 0) {
+                continue;
+            }
+            if (DiagonalOffset(squares[i]) > 0) {
+                for (int j = i; j < size; j++) {
+                    squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+                }
+            }
+            break;
+        }
+        if (material.hasUniquePieces) {
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (DiagonalOffset(squares[0])) {
+                idx = ((std::uint64_t)indexTables.mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            }
+            else if (DiagonalOffset(squares[1])) {
+                idx = (6 * 63 + (squares[0] >> 3) * 28 + indexTables.mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            }
+            else if (DiagonalOffset(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + (squares[0] >> 3) * 7 * 28 + ((squares[1] >> 3) - adjust1) * 28 +
+                      indexTables.mapB1H1H7[squares[2]];
+            }
+            else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (squares[0] >> 3) * 7 * 6 + ((squares[1] >> 3) - adjust1) * 6 +
+                      ((squares[2] >> 3) - adjust2);
+            }
+        }
+        else {
+            idx = indexTables.mapKK[indexTables.mapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // The other groups are combinations of the squares left, counted without the pieces before them
+    idx *= encoding.groupIdx[0];
+    Square* groupSquares = squares + encoding.groupLen[0];
+    bool remainingPawns = material.hasPawns && material.pawnCount[1];
+    for (int next = 1; encoding.groupLen[next]; next++) {
+        std::stable_sort(groupSquares, groupSquares + encoding.groupLen[next]);
+        std::uint64_t n = 0;
+        for (int i = 0; i < encoding.groupLen[next]; i++) {
+            int adjust = (int)std::count_if(squares, groupSquares, [&](Square square) { return groupSquares[i] > square; });
+            n += indexTables.binomial[i + 1][groupSquares[i] - adjust - 8 * remainingPawns];
+        }
+        remainingPawns = false;
+        idx += n * encoding.groupIdx[next];
+        groupSquares += encoding.groupLen[next];
+    }
+    return idx;
+}
+
+int LoadTablebases(const std::string& path) {
+    tables.clear();
+    loadedTables.clear();
+    maxPieces = 0;
+    // The first file of a name found along the path wins
+    std::map<std::string, std::filesystem::path> wdlFiles, dtzFiles;
+    for (const std::string& directory : SplitPath(path)) {
+        std::error_code error;
+        for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+            std::string extension = file.path().extension().string();
+            if (extension == ".rtbw" || extension == ".rtbz") {
+                (extension == ".rtbw" ? wdlFiles : dtzFiles).emplace(file.path().stem().string(), file.path());
+            }
+        }
+        if (error) {
+            std::cerr << "Failed to read tablebase directory '" << directory << "': " << error.message() << std::endl;
+        }
+    }
+    for (const auto& [name, wdlPath] : wdlFiles) {
+        auto table = std::make_unique<Table>();
+        // Probes jump all over the tables, read-ahead would only waste memory
+        if (!ParseSyzygyMaterial(name, table->material) || !table->wdl.file.Open(wdlPath.string(), true) ||
+            !ParseTableFile(table->wdl, table->material, false)) {
+            std::cerr << "Ignoring invalid tablebase file '" << wdlPath.string() << "'" << std::endl;
+            continue;
+        }
+        auto dtzPath = dtzFiles.find(name);
+        if (dtzPath != dtzFiles.end()) {
+            table->dtz = std::make_unique<TableFile>();
+            if (!table->dtz->file.Open(dtzPath->second.string(), true) || !ParseTableFile(*table->dtz, table->material, true)) {
+                std::cerr << "Ignoring invalid tablebase file '" << dtzPath->second.string() << "'" << std::endl;
+                table->dtz.reset();
+            }
+        }
+        maxPieces = std::max(maxPieces, table->material.pieceCount);
+        tables[table->material.key] = table.get();
+        tables[table->material.key2] = table.get();
+        loadedTables.push_back(std::move(table));
+    }
+    return (int)loadedTables.size();
+}
+
+int TablebaseMaxPieces() {
+    return maxPieces;
+}
+
+bool ProbeDTZ(const Board& board, Color colorToMove, int& wdl, int& dtz) {
+    WDLScore score;
+    ProbeState state;
+    int value = SearchDTZ(board, colorToMove, score, state);
+    if (state == ProbeState::Fail) {
+        return false;
+    }
+    wdl = score == WDLWin ? 1 : score == WDLLoss ? -1 : 0;
+    // A mated position has DTZ -1 in Syzygy terms, the same as one where the loser's every move zeroes
+    dtz = wdl == 0 ? 0 : wdl < 0 && GenMoves(board, colorToMove).empty() ? 0 : std::abs(value);
+    return true;
+}
+
+bool ProbeWDL(const Board& board, Color colorToMove, int& wdl) {
+    ProbeState state = ProbeState::Ok;
+    WDLScore score = SearchWDL(board, colorToMove, false, state);
+    if (state == ProbeState::Fail) {
+        return false;
+    }
+    wdl = score == WDLWin ? 1 : score == WDLLoss ? -1 : 0;
+    return true;
+}
+
+bool ProbeRoot(const Board& board, Color colorToMove, Move& bestMove, int& wdl, int& dtz) {
+    if (!ProbeDTZ(board, colorToMove, wdl, dtz)) {
+        return false;
+    }
+    MoveList moves = GenMoves(board, colorToMove);
+    int bestRank = INT_MIN;
+    for (const Move& move : moves) {
+        bool zeroing = move.Type() != Move::Normal || board.PieceTypeAt(move.From()) == PieceType::Pawn ||
+                       board.PieceTypeAt(move.To()) != PieceType::None;
+        Board child = board;
+        MakeMove(move, child, colorToMove);
+        int childWdl, childDtz;
+        if (!ProbeDTZ(child, ToggleColor(colorToMove), childWdl, childDtz)) {
+            return false;
+        }
+        int moveDtz = zeroing ? 1 : childDtz + 1;
+        bool mates = childWdl < 0 && childDtz == 0;
+        // Wins rank above draws above losses; fastest win first, with mate breaking the tie among 1-ply zeroing
+        // moves, and slowest loss first
+        int rank = childWdl < 0 ? 1000 - 2 * moveDtz + mates : childWdl == 0 ? 0 : -1000 + moveDtz;
+        if (rank > bestRank) {
+            bestRank = rank;
+            bestMove = move;
+        }
+    }
+    return bestRank != INT_MIN;
+}
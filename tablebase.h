@@ -0,0 +1,74 @@
+#pragma once
+
+#include "board.h"
+#include "movegen.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Syzygy endgame tablebases: WDL tables (.rtbw) for the search and DTZ tables (.rtbz) for the root, one file per
+// material signature named like KQvKR, with the stronger side first. The decoder follows the file layout and
+// position indexing of the published tables as implemented by Stockfish and Fathom. Castling rights aren't part of
+// the tables, positions with castling rights must not be probed; en passant captures are resolved by a capture
+// search before the table is read, the way Syzygy tables expect.
+
+static constexpr int TABLEBASE_MAX_PIECES = 7; // kings included
+
+// Canonical table name for the material on the board, and whether colors have to be swapped to look it up
+std::string TablebaseName(const Board& board, bool& flipped);
+// Pieces of a table in name order: white king, white pieces from queen down to pawn, then the same for black.
+// Empty if the name is malformed.
+std::vector<Piece> TablebasePieces(const std::string& name);
+
+// Index encoding, shared with tools/tbgen which writes test tables in the same format.
+// What the encoding needs to know about a table's material, from its name. Colors are those of the name, white being
+// the stronger side.
+struct SyzygyMaterial {
+    std::uint64_t key = 0;        // material of the name
+    std::uint64_t key2 = 0;       // the same with colors swapped, equal to key for symmetric material
+    int pieceCount = 0;
+    bool hasPawns = false;
+    bool hasUniquePieces = false; // a side has exactly one piece of some non-king type
+    Color leadColor = White;      // the side whose pawns are the leading group, the one with fewer of them
+    int pawnCount[2] = {};        // pawns of the leading side and of the other one
+};
+bool ParseSyzygyMaterial(const std::string& name, SyzygyMaterial& material);
+
+// How the positions of one side to move and leading pawn file are numbered: the order the pieces are taken in and
+// how they are grouped. Pieces are Syzygy codes, 1..6 for the white pawn..king and 9..14 for black.
+struct SyzygyEncoding {
+    std::uint8_t pieces[TABLEBASE_MAX_PIECES] = {};
+    int groupLen[TABLEBASE_MAX_PIECES + 1] = {};           // zero terminated
+    std::uint64_t groupIdx[TABLEBASE_MAX_PIECES + 1] = {}; // weight of each group, the last one is the table size
+};
+// order is the position of the leading group, and of the other side's pawns if both sides have some, among the
+// groups; file is the leading pawn's file folded to a..d.
+void SetSyzygyGroups(const SyzygyMaterial& material, SyzygyEncoding& encoding, const int order[2], int file);
+
+// A position in the table's colors and orientation, ready for SyzygyIndex
+struct SyzygyPosition {
+    int stm = 0;                        // 0 if the table's white is to move
+    int file = 0;                       // leading pawn file folded to a..d, 0 without pawns
+    int leadPawnCount = 0;
+    Square squares[TABLEBASE_MAX_PIECES] = {};
+    std::uint8_t pieces[TABLEBASE_MAX_PIECES] = {};
+};
+// flip swaps colors and mirrors ranks, needed when the board's black has the table's white material and for
+// symmetric material with black to move
+SyzygyPosition NormalizeSyzygyPosition(const SyzygyMaterial& material, const Board& board, Color colorToMove, bool flip);
+std::uint64_t SyzygyIndex(const SyzygyMaterial& material, const SyzygyEncoding& encoding, SyzygyPosition position);
+
+// Maps every table in path, a list of directories separated by ':' (';' on Windows), replacing previously loaded
+// tables. Returns the number of WDL tables loaded; an empty path unloads everything.
+int LoadTablebases(const std::string& path);
+// Largest piece count (kings included) covered by a loaded table, 0 if none are loaded
+int TablebaseMaxPieces();
+
+// wdl is 1, 0 or -1 from the side to move's POV; wins and losses that the fifty move rule turns into draws count as
+// draws. Return false if a needed table isn't loaded.
+bool ProbeWDL(const Board& board, Color colorToMove, int& wdl);
+// dtz is the number of plies to the next capture, pawn move or mate in a won or lost position, 0 when mated
+bool ProbeDTZ(const Board& board, Color colorToMove, int& wdl, int& dtz);
+// DTZ-optimal move for the root: keeps the best reachable WDL, wins by the fastest zeroing move (mate first) and
+// loses by the slowest. wdl and dtz describe the position before the move.
+bool ProbeRoot(const Board& board, Color colorToMove, Move& bestMove, int& wdl, int& dtz);
@@ -0,0 +1,154 @@
+#include "gtest/gtest.h"
+#include "analyse.h"
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// Just enough of a JSON parser to tell whether a line is a single valid value
+class JsonValidator {
+public:
+    static bool Valid(std::string_view text) {
+        JsonValidator validator{text};
+        return validator.Value() && validator.AtEnd();
+    }
+
+private:
+    explicit JsonValidator(std::string_view text) : text(text) {}
+
+    void SkipSpaces() {
+        while (pos < text.size() && std::isspace((unsigned char)text[pos])) {
+            pos++;
+        }
+    }
+
+    bool AtEnd() {
+        SkipSpaces();
+        return pos == text.size();
+    }
+
+    bool Consume(char c) {
+        SkipSpaces();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool Literal(std::string_view literal) {
+        if (text.substr(pos, literal.size()) != literal) {
+            return false;
+        }
+        pos += literal.size();
+        return true;
+    }
+
+    bool String() {
+        if (!Consume('"')) {
+            return false;
+        }
+        while (pos < text.size() && text[pos] != '"') {
+            if ((unsigned char)text[pos] < 0x20) {
+                return false;
+            }
+            pos += text[pos] == '\\' ? 2 : 1;
+        }
+        return pos++ < text.size();
+    }
+
+    bool Number() {
+        std::size_t start = pos;
+        Consume('-');
+        while (pos < text.size() && (std::isdigit((unsigned char)text[pos]) || text[pos] == '.' || text[pos] == 'e' ||
+                                     text[pos] == 'E' || text[pos] == '+' || text[pos] == '-')) {
+            pos++;
+        }
+        return pos > start && std::isdigit((unsigned char)text[pos - 1]);
+    }
+
+    bool Value() {
+        SkipSpaces();
+        if (pos == text.size()) {
+            return false;
+        }
+        switch (text[pos]) {
+        case '{':
+            pos++;
+            if (Consume('}')) {
+                return true;
+            }
+            do {
+                if (!String() || !Consume(':') || !Value()) {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume('}');
+        case '[':
+            pos++;
+            if (Consume(']')) {
+                return true;
+            }
+            do {
+                if (!Value()) {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume(']');
+        case '"':
+            return String();
+        case 't':
+            return Literal("true");
+        case 'f':
+            return Literal("false");
+        case 'n':
+            return Literal("null");
+        default:
+            return Number();
+        }
+    }
+
+    std::string_view text;
+    std::size_t pos = 0;
+};
+
+}
+
+TEST(Analyse, EveryLineIsJson) {
+    EXPECT_TRUE(JsonValidator::Valid(R"({"a":[1,-2.5e3,"x\"y"],"b":null})"));
+    EXPECT_FALSE(JsonValidator::Valid(R"({"fen":"8/8 w - - 0 1"null})"));
+
+    const std::string epdPath = testing::TempDir() + "analyse_test.epd";
+    const std::string outPath = testing::TempDir() + "analyse_test.jsonl";
+    {
+        std::ofstream epd{epdPath};
+        epd << "8/8/8/8/8/1Q6/2K5/k7 w - - bm Qb2;\n"
+            << "rnbqkbnr/ppxppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n" // FEN fields, but not a position
+            << "garbage\n"
+            << "8/8/8/8/8/1QK5/8/k7 b - - 0 1\n";
+    }
+    const char* argv[] = { "faris-engine", "analyse", "--epd", epdPath.c_str(), "--depth", "2", "--out", outPath.c_str() };
+    ASSERT_EQ(Analyse(8, (char**)argv), 0);
+
+    std::ifstream out{outPath};
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(out, line);) {
+        EXPECT_TRUE(JsonValidator::Valid(line)) << line;
+        lines.push_back(line);
+    }
+    EXPECT_EQ(lines.size(), 4u);
+    for (const std::string& line : lines) {
+        if (line.find("\"index\":1,") != std::string::npos) {
+            EXPECT_NE(line.find(R"("fen":"rnbqkbnr/ppxppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1","error":)"), std::string::npos) << line;
+        }
+        if (line.find("\"index\":2,") != std::string::npos) {
+            EXPECT_NE(line.find(R"("fen":null,"error":)"), std::string::npos) << line;
+        }
+    }
+    std::remove(epdPath.c_str());
+    std::remove(outPath.c_str());
+}
@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+#include "attack_bitboards.h"
+#include "cpu.h"
+#include <random>
+#include <vector>
+
+// Both slider implementations index the same compact tables in different orders, so they must agree everywhere
+TEST(SliderAttacks, PextMatchesMagic) {
+    if (!SetSliderAttackImpl(SliderAttackImpl::Pext)) {
+        GTEST_SKIP() << "PEXT path not compiled in or not supported by this CPU";
+    }
+    std::mt19937_64 rng{12345};
+    std::vector<Bitboard> occupancies(4096);
+    for (Bitboard& occupancy : occupancies) {
+        occupancy = rng() & rng();
+    }
+
+    std::vector<Bitboard> pextAttacks;
+    for (Square square = 0; square < 64; square++) {
+        for (Bitboard occupancy : occupancies) {
+            pextAttacks.push_back(RookAttack(square, occupancy));
+            pextAttacks.push_back(BishopAttack(square, occupancy));
+        }
+    }
+
+    SliderAttackImpl defaultImpl = DefaultSliderAttackImpl();
+    ASSERT_TRUE(SetSliderAttackImpl(SliderAttackImpl::Magic));
+    std::size_t i = 0;
+    for (Square square = 0; square < 64; square++) {
+        for (Bitboard occupancy : occupancies) {
+            EXPECT_EQ(pextAttacks[i++], RookAttack(square, occupancy)) << "rook on " << square;
+            EXPECT_EQ(pextAttacks[i++], BishopAttack(square, occupancy)) << "bishop on " << square;
+        }
+    }
+    SetSliderAttackImpl(defaultImpl);
+}
+
+// Set-wise attacks of a whole piece set must equal the union of the per-square lookups, for every implementation
+TEST(SetwiseAttacks, MatchPerSquareLookups) {
+    std::mt19937_64 rng{67890};
+    SetwiseAttackImpl defaultImpl = DefaultSetwiseAttackImpl();
+    for (SetwiseAttackImpl impl : { SetwiseAttackImpl::Scalar, SetwiseAttackImpl::Avx2 }) {
+        if (!SetSetwiseAttackImpl(impl)) {
+            continue;
+        }
+        for (int i = 0; i < 10000; i++) {
+            Bitboard occupancy = rng() & rng();
+            Bitboard knights = rng() & rng() & rng();
+            Bitboard bishops = rng() & rng() & rng() & occupancy;
+            Bitboard rooks = rng() & rng() & rng() & occupancy;
+            Bitboard queens = rng() & rng() & rng() & occupancy;
+
+            Bitboard expectedKnights = 0, expectedBishops = 0, expectedRooks = 0, expectedQueens = 0;
+            for (Bitboard b = knights; b;) {
+                expectedKnights |= knightAttacks[PopLSB(b)];
+            }
+            for (Bitboard b = bishops; b;) {
+                expectedBishops |= BishopAttack(PopLSB(b), occupancy);
+            }
+            for (Bitboard b = rooks; b;) {
+                expectedRooks |= RookAttack(PopLSB(b), occupancy);
+            }
+            for (Bitboard b = queens; b;) {
+                expectedQueens |= QueenAttack(PopLSB(b), occupancy);
+            }
+
+            SliderAttacks attacks = SetwiseSliderAttacks(bishops, rooks, queens, occupancy);
+            ASSERT_EQ(expectedKnights, KnightAttacks(knights));
+            ASSERT_EQ(expectedBishops, attacks.bishops) << SetwiseAttackImplName(impl);
+            ASSERT_EQ(expectedRooks, attacks.rooks) << SetwiseAttackImplName(impl);
+            ASSERT_EQ(expectedQueens, attacks.queens) << SetwiseAttackImplName(impl);
+        }
+    }
+    SetSetwiseAttackImpl(defaultImpl);
+}
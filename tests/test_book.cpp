@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+#include "book.h"
+#include "fen.h"
+#include "utilities.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Reference keys from the Polyglot book format specification
+TEST(Book, PolyglotKeys) {
+    const std::pair<const char*, std::uint64_t> positions[] = {
+        { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9c },
+        { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196 },
+        { "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0 },
+        { "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4 },
+        { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78 },
+        { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1 },
+        { "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9 },
+        { "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637 },
+        { "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560 },
+    };
+    for (const auto& [fenString, key] : positions) {
+        Fen fen = ParseFen(fenString);
+        EXPECT_EQ(PolyglotKey(fen.board, fen.colorToMove), key) << fenString;
+    }
+}
+
+namespace {
+
+void WriteEntry(std::ofstream& file, std::uint64_t key, std::uint16_t move, std::uint16_t weight) {
+    char bytes[16] = {};
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = char(key >> (56 - 8 * i));
+    }
+    bytes[8] = char(move >> 8);
+    bytes[9] = char(move);
+    bytes[10] = char(weight >> 8);
+    bytes[11] = char(weight);
+    file.write(bytes, sizeof(bytes));
+}
+
+std::uint16_t PolyglotMove(Square from, Square to) {
+    return std::uint16_t(from << 6 | to);
+}
+
+}
+
+TEST(Book, ProbeDecodesAndWeighsMoves) {
+    Fen start = ParseFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    Fen castle = ParseFen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+    std::uint64_t startKey = PolyglotKey(start.board, start.colorToMove);
+    std::uint64_t castleKey = PolyglotKey(castle.board, castle.colorToMove);
+
+    std::string path = testing::TempDir() + "book_test.bin";
+    {
+        std::ofstream file{path, std::ios::binary};
+        // Sorted by key, like every Polyglot book
+        std::vector<std::pair<std::uint64_t, std::vector<std::pair<std::uint16_t, std::uint16_t>>>> positions = {
+            { startKey, { { PolyglotMove(12, 28), 3 }, { PolyglotMove(11, 27), 1 }, { PolyglotMove(12, 36), 5 } } },
+            { castleKey, { { PolyglotMove(4, 7), 1 } } },
+        };
+        std::sort(positions.begin(), positions.end());
+        WriteEntry(file, 0, 0, 1);
+        for (const auto& [key, moves] : positions) {
+            for (auto [move, weight] : moves) {
+                WriteEntry(file, key, move, weight);
+            }
+        }
+        WriteEntry(file, ~0ull, 0, 1);
+    }
+
+    OpeningBook book;
+    ASSERT_TRUE(book.Open(path));
+    // e2e5 isn't legal and is dropped
+    std::vector<BookMove> moves = book.Moves(start.board, start.colorToMove);
+    ASSERT_EQ(moves.size(), 2u);
+    EXPECT_EQ(MoveToUCINotation(moves[0].move), "e2e4");
+    EXPECT_EQ(moves[0].weight, 3);
+    EXPECT_EQ(MoveToUCINotation(moves[1].move), "d2d4");
+
+    // King takes rook is Polyglot's castling
+    moves = book.Moves(castle.board, castle.colorToMove);
+    ASSERT_EQ(moves.size(), 1u);
+    EXPECT_EQ(moves[0].move.Type(), Move::Castling);
+    EXPECT_EQ(MoveToUCINotation(moves[0].move), "e1g1");
+
+    int e2e4 = 0;
+    for (int i = 0; i < 4000; i++) {
+        Move move;
+        ASSERT_TRUE(book.Probe(start.board, start.colorToMove, move));
+        e2e4 += MoveToUCINotation(move) == "e2e4";
+    }
+    EXPECT_NEAR(e2e4 / 4000.0, 0.75, 0.05);
+
+    Fen outOfBook = ParseFen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    Move move;
+    EXPECT_FALSE(book.Probe(outOfBook.board, outOfBook.colorToMove, move));
+    book.Close();
+    std::remove(path.c_str());
+}
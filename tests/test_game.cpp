@@ -0,0 +1,47 @@
+#include "gtest/gtest.h"
+#include "game.h"
+#include "utilities.h"
+#include <string>
+
+namespace {
+
+void PlayMoves(Game& game, std::initializer_list<const char*> moves) {
+    for (const char* move : moves) {
+        game.Play(ParseUCIMove(move, game.board));
+    }
+}
+
+}
+
+TEST(Game, ResultByTheRules) {
+    Game game;
+    game.Reset(START_FEN);
+    EXPECT_FALSE(game.Result());
+    // Fool's mate
+    PlayMoves(game, { "f2f3", "e7e5", "g2g4", "d8h4" });
+    EXPECT_EQ(game.Result(), -1);
+
+    game.Reset("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+    EXPECT_EQ(game.Result(), 0); // stalemate
+
+    game.Reset("7k/8/6K1/8/8/8/8/6N1 w - - 0 1");
+    EXPECT_EQ(game.Result(), 0); // insufficient material
+    game.Reset("7k/8/6K1/8/8/8/8/5BN1 w - - 0 1");
+    EXPECT_FALSE(game.Result());
+
+    game.Reset("7k/8/6K1/8/8/8/8/R7 w - - 99 80");
+    EXPECT_FALSE(game.Result());
+    PlayMoves(game, { "a1a2" });
+    EXPECT_EQ(game.Result(), 0); // fifty moves
+}
+
+TEST(Game, ThreefoldRepetition) {
+    Game game;
+    game.Reset(START_FEN);
+    PlayMoves(game, { "g1f3", "g8f6", "f3g1", "f6g8", "g1f3", "g8f6", "f3g1" });
+    EXPECT_FALSE(game.Result());
+    PlayMoves(game, { "f6g8" });
+    EXPECT_EQ(game.Result(), 0);
+    EXPECT_EQ(game.moves.size(), 8u);
+    EXPECT_EQ(game.ply, 8);
+}
@@ -0,0 +1,58 @@
+#include "gtest/gtest.h"
+#include "fen.h"
+#include "packed_position.h"
+#include <cstdio>
+#include <string>
+
+TEST(PackedPosition, RoundTrip) {
+    const std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "7k/8/8/8/8/8/8/K7 b - - 0 1",
+    };
+    for (const std::string& fenString : fens) {
+        Fen fen = ParseFen(fenString);
+        PackedPosition packed = PackPosition(fen.board, fen.colorToMove, -123, 42, -1, 17);
+        Board board;
+        Color colorToMove;
+        UnpackPosition(packed, board, colorToMove);
+        EXPECT_TRUE(board == fen.board) << fenString;
+        EXPECT_EQ(colorToMove, fen.colorToMove) << fenString;
+        EXPECT_EQ(packed.score, -123);
+        EXPECT_EQ(packed.ply, 42);
+        EXPECT_EQ(packed.result, -1);
+        EXPECT_EQ(packed.halfmoveClock, 17);
+    }
+    // Mate scores don't fit and are clamped
+    EXPECT_EQ(PackPosition(Board(), White, 1'000'005, 0, 0, 0).score, 32767);
+}
+
+// More positions than one reader buffer, written through separately opened writers
+TEST(PackedPosition, WriteAndStream) {
+    const std::string path = testing::TempDir() + "packed_position_test.fpack";
+    const int count = 70000;
+    Board board;
+    for (bool append : { false, true }) {
+        PackedPositionWriter writer;
+        ASSERT_TRUE(writer.Open(path, append));
+        for (int i = append ? count / 2 : 0; i < (append ? count : count / 2); i++) {
+            writer.Write(PackPosition(board, Color(i % 2), i % 30000, i % 65536, 0, 0));
+        }
+        ASSERT_TRUE(writer.Flush());
+    }
+
+    PackedPositionReader reader;
+    ASSERT_TRUE(reader.Open(path));
+    PackedPosition position;
+    int read = 0;
+    while (reader.Next(position)) {
+        ASSERT_EQ(position.score, read % 30000);
+        ASSERT_EQ(position.ply, read % 65536);
+        ASSERT_EQ(position.flags & 1, read % 2);
+        read++;
+    }
+    EXPECT_EQ(read, count);
+    std::remove(path.c_str());
+}
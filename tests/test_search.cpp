@@ -0,0 +1,181 @@
+#include "gtest/gtest.h"
+#include "fen.h"
+#include "pawn_hash.h"
+#include "search.h"
+#include "transposition.h"
+#include "tunables.h"
+#include "utilities.h"
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace {
+
+struct SearchResult {
+    Move move;
+    std::uint64_t nodes;
+};
+
+SearchResult SearchFresh(const std::string& fenString, int depth) {
+    transpositionTable.Clear();
+    pawnHashTable.Clear();
+    searchHistory->Clear();
+    threefoldRepetitionTable.clear();
+    Fen fen = ParseFen(fenString);
+    Move move = Search(fen.board, fen.colorToMove, SearchLimits{ .depth = depth }, false);
+    return { move, searchNodes };
+}
+
+}
+
+// Keys are generated at compile time, so the start position hashes the same in every run and build
+TEST(Search, ZobristKeysAreFixed) {
+    Board board;
+    EXPECT_EQ(transpositionTable.Hash(board, White), 0x98253fd2f772de28);
+    EXPECT_EQ(transpositionTable.Hash(board, White) ^ transpositionTable.Hash(board, Black), ZOBRIST_KEYS.blackToMove);
+}
+
+// A fixed depth search from fresh tables must visit exactly the same tree every time
+TEST(Search, FixedDepthSearchIsReproducible) {
+    const std::string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    };
+    for (const std::string& fen : fens) {
+        SearchResult first = SearchFresh(fen, 5);
+        SearchResult second = SearchFresh(fen, 5);
+        EXPECT_EQ(first.move, second.move) << fen;
+        EXPECT_EQ(first.nodes, second.nodes) << fen;
+        EXPECT_GT(first.nodes, 0u) << fen;
+    }
+}
+
+TEST(Search, MultiPVReportsDistinctLinesBestFirst) {
+    transpositionTable.Clear();
+    threefoldRepetitionTable.clear();
+    Fen fen = ParseFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    Move best = Search(fen.board, fen.colorToMove, SearchLimits{ .depth = 4, .multiPV = 4 }, false);
+    ASSERT_EQ(rootLines.size(), 4u);
+    EXPECT_EQ(rootLines[0].pv.at(0), best);
+    for (std::size_t i = 0; i < rootLines.size(); i++) {
+        ASSERT_FALSE(rootLines[i].pv.empty());
+        for (std::size_t j = 0; j < i; j++) {
+            EXPECT_NE(rootLines[i].pv[0], rootLines[j].pv[0]);
+            EXPECT_GE(rootLines[j].score, rootLines[i].score);
+        }
+    }
+
+    // Capped at the number of legal moves, here two king moves
+    fen = ParseFen("k7/8/8/1N6/8/8/8/7K b - - 0 1");
+    Search(fen.board, fen.colorToMove, SearchLimits{ .depth = 3, .multiPV = 5 }, false);
+    EXPECT_EQ(rootLines.size(), 2u);
+}
+
+// The node limit is checked every few thousand nodes, so the search may overshoot it by one check interval
+TEST(Search, NodeLimitStopsSearch) {
+    transpositionTable.Clear();
+    threefoldRepetitionTable.clear();
+    Fen fen = ParseFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    Move best = Search(fen.board, fen.colorToMove, SearchLimits{ .depth = 64, .nodes = 50000 }, false);
+    EXPECT_NE(best, Move{});
+    EXPECT_LE(searchNodes, 50000u + 4096u);
+    EXPECT_GE(searchNodes, 50000u);
+}
+
+// Search state is per thread: a search on another thread with its own table of the same size must visit the same
+// tree as one here
+TEST(Search, SearchOnWorkerThreadMatchesMainThread) {
+    const std::string fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    SearchResult expected = SearchFresh(fen, 4);
+    SearchResult worker;
+    std::thread thread{[&] {
+        TT table{TT::DEFAULT_SIZE};
+        searchTT = &table;
+        Fen parsed = ParseFen(fen);
+        threefoldRepetitionTable.clear();
+        worker.move = Search(parsed.board, parsed.colorToMove, SearchLimits{ .depth = 4 }, false);
+        worker.nodes = searchNodes;
+    }};
+    thread.join();
+    EXPECT_EQ(worker.move, expected.move);
+    EXPECT_EQ(worker.nodes, expected.nodes);
+}
+
+// History is bounded by the gravity updates and carries over to the next search until cleared
+TEST(Search, HistoryStaysBoundedAcrossSearches) {
+    SearchResult result = SearchFresh("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 6);
+    EXPECT_NE(result.move, Move{});
+    Fen fen = ParseFen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1");
+    Search(fen.board, fen.colorToMove, SearchLimits{ .depth = 6 }, false);
+    const std::int16_t* begin = &searchHistory->continuation[0][0][0][0];
+    const std::int16_t* end = begin + sizeof(searchHistory->continuation) / sizeof(std::int16_t);
+    auto [min, max] = std::minmax_element(begin, end);
+    EXPECT_GE(*min, -SearchHistory::HISTORY_MAX);
+    EXPECT_LE(*max, SearchHistory::HISTORY_MAX);
+    EXPECT_LT(*min, 0); // malus
+    EXPECT_GT(*max, 0);
+    bool learnedWhite = false;
+    bool learnedBlack = false;
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            learnedWhite |= searchHistory->butterfly[White][from][to] != 0;
+            learnedBlack |= searchHistory->butterfly[Black][from][to] != 0;
+        }
+    }
+    EXPECT_TRUE(learnedWhite);
+    EXPECT_TRUE(learnedBlack);
+    searchHistory->Clear();
+    EXPECT_EQ(*std::max_element(begin, end), 0);
+}
+
+// Iterations stop short of MAX_PLY however deep the limit, here in a locked position where they are cheap
+TEST(Search, DepthIsCappedBelowMaxPly) {
+    SearchResult result = SearchFresh("k7/8/8/p1p1p1p1/P1P1P1P1/8/8/K7 w - - 0 1", 1000);
+    EXPECT_NE(result.move, Move{});
+    EXPECT_EQ(rootLines[0].depth, MAX_PLY - 1);
+    EXPECT_LE(rootLines[0].pv.size(), (std::size_t)MAX_PLY);
+}
+
+// At depth 1 the mate is only seen by quiescence, which must search the evasions rather than stand pat in check
+TEST(Search, QuiescenceSeesMateAfterCapture) {
+    SearchResult result = SearchFresh("3r2k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 1);
+    EXPECT_EQ(MoveToUCINotation(result.move), "d1d8");
+    EXPECT_EQ(MateMoves(rootLines[0].score), 1);
+}
+
+// Mate scores count plies from the root, so reductions and extensions below it can't change the reported distance
+TEST(Search, MateDistanceIsExactAtDepth) {
+    const std::pair<std::string, int> mates[] = {
+        { "3r2k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 1 },
+        { "7k/5Q2/6K1/8/8/8/8/8 w - - 0 1", 1 },
+        { "7k/8/5K2/8/8/8/8/6R1 w - - 0 1", 2 },
+        { "7k/5K2/8/8/8/8/8/6R1 b - - 0 1", -1 },
+    };
+    for (const auto& [fen, mate] : mates) {
+        for (int depth : { 6, 8 }) {
+            SearchFresh(fen, depth);
+            EXPECT_EQ(MateMoves(rootLines[0].score), mate) << fen << " depth " << depth;
+        }
+    }
+}
+
+// Null move reductions at the top of their ranges reach past the depth at the smallest null move depth, the null move
+// search must then drop into quiescence instead of recursing at full width
+TEST(Search, NullMoveReductionBeyondDepthStaysShallow) {
+    if (Tunables().empty()) {
+        GTEST_SKIP() << "tunables are constants outside tuning builds";
+    }
+    SetTunable("NullMoveMinDepth", 2);
+    SetTunable("NullMoveReduction", 4);
+    SetTunable("NullMoveDeepDepth", 4);
+    SetTunable("NullMoveDeepReduction", 5);
+    transpositionTable.Clear();
+    searchHistory->Clear();
+    threefoldRepetitionTable.clear();
+    Fen fen = ParseFen("rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2");
+    Search(fen.board, fen.colorToMove, SearchLimits{ .depth = 6, .nodes = 5'000'000 }, false);
+    for (const Tunable& tunable : Tunables()) {
+        SetTunable(tunable.name, tunable.defaultValue);
+    }
+    EXPECT_EQ(rootLines[0].depth, 6);
+}
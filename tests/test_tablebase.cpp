@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "fen.h"
+#include "movegen.h"
+#include "tablebase.h"
+#include "utilities.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// The tables are generated next to the test binary by tbgen at build time (see CMakeLists.txt). KPvK promotes into
+// KBvK and KNvK, so those are generated along with it.
+class TablebaseTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() { ASSERT_EQ(LoadTablebases("tablebases"), 5); }
+    static void TearDownTestSuite() { LoadTablebases(""); }
+
+    static int WDL(const std::string& fenString) {
+        Fen fen = ParseFen(fenString);
+        int wdl;
+        EXPECT_TRUE(ProbeWDL(fen.board, fen.colorToMove, wdl)) << fenString;
+        return wdl;
+    }
+};
+
+TEST_F(TablebaseTest, NamesAndPieces) {
+    bool flipped;
+    EXPECT_EQ(TablebaseName(ParseFen("8/8/8/8/8/1q6/2k5/K7 w - - 0 1").board, flipped), "KQvK");
+    EXPECT_TRUE(flipped);
+    EXPECT_EQ(TablebaseName(ParseFen("8/8/8/3k4/8/8/1R6/K5n1 w - - 0 1").board, flipped), "KRvKN");
+    EXPECT_FALSE(flipped);
+    // Syzygy order: more pieces first, then the strongest piece
+    EXPECT_EQ(TablebaseName(ParseFen("8/8/8/3k4/8/2q5/1NN5/K7 w - - 0 1").board, flipped), "KNNvKQ");
+    EXPECT_FALSE(flipped);
+    EXPECT_EQ(TablebaseName(ParseFen("8/8/8/3k4/8/2b5/1N6/K7 w - - 0 1").board, flipped), "KBvKN");
+    EXPECT_TRUE(flipped);
+    EXPECT_EQ(TablebasePieces("KRvKN").size(), 4u);
+    EXPECT_TRUE(TablebasePieces("KPQvK").empty());
+    EXPECT_TRUE(TablebasePieces("QvK").empty());
+    EXPECT_EQ(TablebaseMaxPieces(), 3);
+}
+
+// Table sizes follow from the encoding: three unique pieces take 31332 indices, two kings 462 and a leading pawn 6
+// per file, other groups are combinations of the squares left
+TEST_F(TablebaseTest, EncodingSizes) {
+    auto tableSize = [](const std::string& name, int file) {
+        SyzygyMaterial material;
+        EXPECT_TRUE(ParseSyzygyMaterial(name, material)) << name;
+        SyzygyEncoding encoding;
+        std::vector<Piece> pieces = TablebasePieces(name);
+        std::stable_partition(pieces.begin(), pieces.end(), [](const Piece& piece) { return piece.type == PieceType::King; });
+        for (std::size_t i = 0; i < pieces.size(); i++) {
+            encoding.pieces[i] = (std::uint8_t)((int)pieces[i].type + 1 + 8 * pieces[i].color);
+        }
+        std::stable_partition(encoding.pieces, encoding.pieces + pieces.size(), [](std::uint8_t piece) { return (piece & 7) == 1; });
+        const int order[2] = { 0, material.hasPawns && material.pawnCount[1] ? 1 : 0xF };
+        SetSyzygyGroups(material, encoding, order, file);
+        return encoding.groupIdx[std::find(encoding.groupLen, encoding.groupLen + TABLEBASE_MAX_PIECES, 0) - encoding.groupLen];
+    };
+    EXPECT_EQ(tableSize("KQvK", 0), 31332u);
+    EXPECT_EQ(tableSize("KRRvK", 0), 462u * 1891);     // 62 choose 2
+    EXPECT_EQ(tableSize("KPvK", 0), 6u * 63 * 62);
+    EXPECT_EQ(tableSize("KPvKP", 3), 6u * 47 * 62 * 61); // a d pawn, the other pawn on 47 squares
+    SyzygyMaterial material;
+    ASSERT_TRUE(ParseSyzygyMaterial("KRvKR", material));
+    EXPECT_EQ(material.key, material.key2);
+    ASSERT_TRUE(ParseSyzygyMaterial("KPPvKP", material));
+    EXPECT_EQ(material.leadColor, Black);
+    EXPECT_FALSE(ParseSyzygyMaterial("KvQ", material));
+}
+
+TEST_F(TablebaseTest, WinDrawLoss) {
+    EXPECT_EQ(WDL("8/8/8/8/8/1Q6/2K5/k7 w - - 0 1"), 1);
+    // Same position with colors swapped goes through the flipped table
+    EXPECT_EQ(WDL("8/8/8/8/8/1q6/2k5/K7 b - - 0 1"), 1);
+    // Stalemate
+    EXPECT_EQ(WDL("8/8/8/8/8/1QK5/8/k7 b - - 0 1"), 0);
+    EXPECT_EQ(WDL("8/8/8/8/8/8/1Q6/k1K5 b - - 0 1"), -1);
+    // Queen hangs
+    EXPECT_EQ(WDL("8/8/8/8/8/8/1Q6/k3K3 b - - 0 1"), 0);
+    EXPECT_EQ(WDL("8/8/8/8/4k3/8/8/R3K3 b - - 0 1"), -1);
+    // King and pawn: a defending king that reaches the square in front of the pawn draws, an attacking king in front
+    // of its pawn on the sixth wins regardless of the move
+    EXPECT_EQ(WDL("4k3/8/4P3/4K3/8/8/8/8 w - - 0 1"), 0);
+    EXPECT_EQ(WDL("4k3/8/4P3/4K3/8/8/8/8 b - - 0 1"), 0);
+    EXPECT_EQ(WDL("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1"), 1);
+    EXPECT_EQ(WDL("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1"), -1);
+    // Rook pawn with the defending king in the corner
+    EXPECT_EQ(WDL("k7/8/8/P7/8/8/8/K7 w - - 0 1"), 0);
+    EXPECT_EQ(WDL("8/8/8/8/4k3/8/8/B3K3 w - - 0 1"), 0);
+    // Bare kings need no table
+    EXPECT_EQ(WDL("8/8/8/3k4/8/8/8/K7 w - - 0 1"), 0);
+    // No 4 piece tables
+    Fen fen = ParseFen("8/8/8/3k4/8/8/1R6/K5n1 w - - 0 1");
+    int wdl;
+    EXPECT_FALSE(ProbeWDL(fen.board, fen.colorToMove, wdl));
+}
+
+TEST_F(TablebaseTest, RootMoveMates) {
+    Fen fen = ParseFen("8/8/8/8/8/1Q6/2K5/k7 w - - 0 1");
+    Move move;
+    int wdl, dtz;
+    ASSERT_TRUE(ProbeRoot(fen.board, fen.colorToMove, move, wdl, dtz));
+    EXPECT_EQ(wdl, 1);
+    EXPECT_EQ(dtz, 1);
+    MakeMove(move, fen.board, fen.colorToMove);
+    EXPECT_TRUE(GenMoves(fen.board, Black).empty());
+    EXPECT_TRUE(InCheck(fen.board, Black));
+}
+
+// Both sides playing ProbeRoot moves must follow the DTZ line exactly: the winner shortens it by one every move and
+// the loser can't do better than lengthen it by none, ending in mate after exactly dtz plies
+TEST_F(TablebaseTest, DTZLineEndsInMate) {
+    Fen fen = ParseFen("8/8/8/3k4/8/8/8/R3K3 w - - 0 1");
+    int wdl, dtz;
+    ASSERT_TRUE(ProbeDTZ(fen.board, fen.colorToMove, wdl, dtz));
+    ASSERT_EQ(wdl, 1);
+    Color colorToMove = fen.colorToMove;
+    for (int ply = 0; ply < dtz; ply++) {
+        Move move;
+        int moveWdl, moveDtz;
+        ASSERT_TRUE(ProbeRoot(fen.board, colorToMove, move, moveWdl, moveDtz));
+        EXPECT_EQ(moveDtz, dtz - ply);
+        MakeMove(move, fen.board, colorToMove);
+        colorToMove = ToggleColor(colorToMove);
+    }
+    EXPECT_TRUE(GenMoves(fen.board, colorToMove).empty());
+    EXPECT_TRUE(InCheck(fen.board, colorToMove));
+}
@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+#include "fen.h"
+#include "movegen.h"
+#include "search.h"
+#include "tunables.h"
+#include "uci.h"
+#include "utilities.h"
+#include <string>
+
+// Castling, en passant, promotions with and without capture
+TEST(UCI, ParseMoveMatchesGeneratedMoves) {
+    const char* fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/Pp2P3/2N2Q1p/1PPBBPPP/R3K2R b KQkq a3 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N w - - 0 1",
+    };
+    for (const char* fenString : fens) {
+        Fen fen = ParseFen(fenString);
+        for (const Move& move : GenMoves(fen.board, fen.colorToMove)) {
+            EXPECT_EQ(ParseUCIMove(MoveToUCINotation(move), fen.board), move) << fenString << " " << MoveToUCINotation(move);
+        }
+    }
+    Board board;
+    EXPECT_EQ(ParseUCIMove("e3e4", board), Move{});
+    EXPECT_EQ(ParseUCIMove("e2e9", board), Move{});
+    EXPECT_EQ(ParseUCIMove("e7e8x", board), Move{});
+}
+
+// Every legal move written in SAN parses back to itself, including disambiguated knight and rook moves
+TEST(UCI, SANRoundTripsGeneratedMoves) {
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/Pp2P3/2N2Q1p/1PPBBPPP/R3K2R b KQkq a3 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "R6R/8/8/8/6k1/1Q1Q4/8/1Q2K3 w - - 0 1",
+    };
+    for (const char* fenString : fens) {
+        Fen fen = ParseFen(fenString);
+        for (const Move& move : GenMoves(fen.board, fen.colorToMove)) {
+            std::string san = MoveToSAN(move, fen.board, fen.colorToMove);
+            EXPECT_EQ(ParseSANMove(san, fen.board, fen.colorToMove), move) << fenString << " " << san;
+        }
+    }
+    Fen fen = ParseFen("R6R/8/8/8/6k1/1Q1Q4/8/1Q2K3 w - - 0 1");
+    EXPECT_EQ(MoveToSAN(ParseUCIMove("a8d8", fen.board), fen.board, White), "Rad8");
+    EXPECT_EQ(MoveToSAN(ParseUCIMove("a8g8", fen.board), fen.board, White), "Rag8+");
+    EXPECT_EQ(MoveToSAN(ParseUCIMove("b3c2", fen.board), fen.board, White), "Qb3c2");
+    EXPECT_EQ(MoveToSAN(ParseUCIMove("b1a2", fen.board), fen.board, White), "Q1a2");
+    EXPECT_EQ(ParseSANMove("Rd8", fen.board, White), Move{}); // ambiguous
+    EXPECT_EQ(ParseSANMove("Rad8!?", fen.board, White), ParseUCIMove("a8d8", fen.board));
+    fen = ParseFen("r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1");
+    EXPECT_EQ(ParseSANMove("0-0-0", fen.board, Black), ParseUCIMove("e8c8", fen.board));
+}
+
+TEST(UCI, EpdOperationsSplitOnSemicolonsOutsideQuotes) {
+    auto operations = EpdOperations("2rr3k/pp3pp1/1nnqbN1p/3pN3/2pP4/2P3Q1/PP3PPP/R4RK1 w - - bm Qg6 Rf7; id \"WAC;001\";");
+    EXPECT_EQ(operations.size(), 2u);
+    EXPECT_EQ(operations["bm"], "Qg6 Rf7");
+    EXPECT_EQ(operations["id"], "WAC;001");
+    operations = EpdOperations("8/8/8/8/8/8/8/K1k5 w - - 0 1 am Kb1;");
+    EXPECT_EQ(operations.size(), 1u);
+    EXPECT_EQ(operations["am"], "Kb1");
+    EXPECT_TRUE(EpdOperations("8/8/8/8/8/8/8/K1k5 w - -").empty());
+}
+
+// Growing the move list a move at a time must end on the same position as parsing the last command from scratch
+TEST(UCI, IncrementalPositionMatchesFullParse) {
+    const std::string moves[] = { "e2e4", "c7c5", "g1f3", "d7d6", "f1b5", "c8d7", "e1g1", "d7b5" };
+    const std::string bases[] = { "position startpos", "position fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" };
+    for (const std::string& base : bases) {
+        UCIState incremental;
+        std::string command = base;
+        SetPosition(incremental, command);
+        command += " moves";
+        for (const std::string& move : moves) {
+            command += ' ' + move;
+            SetPosition(incremental, command);
+        }
+        UCIState full;
+        SetPosition(full, command);
+        EXPECT_EQ(incremental.board, full.board) << base;
+        EXPECT_EQ(incremental.colorToMove, full.colorToMove) << base;
+        EXPECT_EQ(incremental.hash, full.hash) << base;
+        EXPECT_FALSE(incremental.board.ShortCastlingRight(White));
+    }
+
+    // A different game replaces the position instead of extending it
+    UCIState state;
+    SetPosition(state, "position startpos moves e2e4 e7e5");
+    SetPosition(state, "position startpos moves d2d4");
+    Fen expected = ParseFen("rnbqkbnr/pppppppp/8/8/3P4/8/PPP1PPPP/RNBQKBNR b KQkq d3 0 1");
+    EXPECT_EQ(state.board, expected.board);
+    EXPECT_EQ(state.colorToMove, Black);
+}
+
+// Moves that parse but aren't legal stop the move list there: the other side's piece, a piece moving like another
+// one, a promotion short of the last rank, a capture of an own piece
+TEST(UCI, PositionStopsAtIllegalMove) {
+    const std::string illegalMoves[] = { "d7d5", "g1g3", "e1e3", "d2d3q", "b1d2" };
+    Fen expected = ParseFen("rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2");
+    for (const std::string& move : illegalMoves) {
+        UCIState state;
+        SetPosition(state, "position startpos moves e2e4 e7e5 " + move + " g8f6");
+        EXPECT_EQ(state.board, expected.board) << move;
+        EXPECT_EQ(state.colorToMove, White) << move;
+        // The next command starts over rather than building on the rejected one
+        SetPosition(state, "position startpos moves e2e4 e7e5 " + move + " g8f6 d2d4");
+        EXPECT_EQ(state.board, expected.board) << move;
+    }
+}
+
+TEST(UCI, SetOptionParsesNameAndValue) {
+    UCIState state;
+    SetOption(state, "setoption name UseNewFeature value false");
+    EXPECT_FALSE(state.useNewFeature);
+    SetOption(state, "setoption name UseNewFeature value true");
+    EXPECT_TRUE(state.useNewFeature);
+    SetOption(state, "setoption name MultiPV value 3");
+    EXPECT_EQ(state.multiPV, 3);
+    SetOption(state, "setoption name MultiPV value 1000");
+    EXPECT_EQ(state.multiPV, 64);
+    // Unknown names change nothing
+    SetOption(state, "setoption name Hash value 64");
+    EXPECT_TRUE(state.useNewFeature);
+    EXPECT_EQ(state.multiPV, 64);
+    // Tunables only exist in tuning builds, where values are clamped to their range
+    for (const Tunable& tunable : Tunables()) {
+        EXPECT_LE(tunable.min, tunable.defaultValue) << tunable.name;
+        EXPECT_LE(tunable.defaultValue, tunable.max) << tunable.name;
+        EXPECT_TRUE(SetTunable(tunable.name, tunable.max + 1));
+        EXPECT_EQ(*tunable.value, tunable.max) << tunable.name;
+        SetOption(state, std::string("setoption name ") + tunable.name + " value " + std::to_string(tunable.defaultValue));
+        EXPECT_EQ(*tunable.value, tunable.defaultValue) << tunable.name;
+    }
+    EXPECT_FALSE(SetTunable("NoSuchTunable", 1));
+}
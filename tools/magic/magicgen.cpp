@@ -1,31 +1,16 @@
 #include <bit>
 #include <cmath>
 #include <cstdlib>
-#include <fstream>
-#include <immintrin.h>
+#include <iomanip>
 #include <iostream>
 #include <random>
 #include <vector>
 
 #include "board.h"
-#include "utilities.h"
 
 static constexpr int rookMoves[4] = { 8, -8, 1, -1 };
 static constexpr int bishopMoves[4] = { 7, 9, -7, -9 };
 
-#ifndef USE_PEXT
-static std::uint64_t rookMagics[64];
-static std::uint64_t bishopMagics[64];
-static constexpr int rookShift = 64 - 12; // 12 is upper bound for popcount(rookMasks[i])
-static constexpr int bishopShift = 64 - 9; // 9 is upper bound for popcount(bishopMasks[i])
-#endif 
-
-static Bitboard rookMasks[64];
-static Bitboard rookAttacks[64][4096];
-
-static Bitboard bishopMasks[64];
-static Bitboard bishopAttacks[64][512];
-
 static bool BishopReachedEdge(Square square, int move) {
     int file = square % 8;
     int rank = square / 8;
@@ -88,19 +73,12 @@ static Bitboard GenBishopMask(Square square) {
     return mask;
 }
 
-static std::uint64_t RandomUint64() {
-    std::uint64_t u1, u2, u3, u4;
-    u1 = (std::uint64_t)(rand()) & 0xFFFF;
-    u2 = (std::uint64_t)(rand()) & 0xFFFF;
-    u3 = (std::uint64_t)(rand()) & 0xFFFF;
-    u4 = (std::uint64_t)(rand()) & 0xFFFF;
-    return u1 | (u2 << 16) | (u3 << 32) | (u4 << 48);
-}
+static std::mt19937_64 rng{0x5EED}; // fixed seed so reruns print the same magics
 
 // apparently this finds magics faster than the way I was doing before
 // https://www.chessprogramming.org/Looking_for_Magics 
 static std::uint64_t GenMagic() {
-    return RandomUint64() & RandomUint64() & RandomUint64(); 
+    return rng() & rng() & rng();
 }
 
 static Bitboard GenRookAttackBitboard(Square square, Bitboard occupancy) {
@@ -133,130 +111,70 @@ static Bitboard GenBishopAttackBitboard(Square square, Bitboard occupancy) {
     return attackBitboard;
 }
 
-static void GenAttackBitboardArray(bool rook) {
+// Finds a magic for every square that maps all occupancy subsets of the square's mask into exactly
+// 2^popcount(mask) slots (fancy magic, per-square shift), so attack_bitboards.cpp can pack the tables densely.
+static void FindMagics(bool rook, std::uint64_t (&magics)[64]) {
     auto GenMaskFunc = rook ? GenRookMask : GenBishopMask;
-    Bitboard* masks = rook ? rookMasks : bishopMasks;
-    const unsigned int countPermutations = rook ? 4096 : 512;
     auto GenAttackBitboardFunc = rook ? GenRookAttackBitboard : GenBishopAttackBitboard;
-#ifndef USE_PEXT
-    auto magics = rook ? rookMagics : bishopMagics;
-    const int shift = rook ? rookShift : bishopShift;
-#endif
 
     for (Square square = 0; square < 64; square++) {
-        auto squareAttacks = rook ? rookAttacks[square] : bishopAttacks[square];
         Bitboard mask = GenMaskFunc(square);
-        masks[square] = mask;
-        std::vector<int> oneIndices;
-        for (int i = 0; i < 64; i++) {
-            if ((1ULL << i) & mask) {
-                oneIndices.push_back(i);
-            }
-        }
-
-        std::vector<Bitboard> occupancyPermutations(countPermutations);
-        std::vector<Bitboard> attackBitboards(countPermutations);
-        for (std::uint32_t i = 0; i < countPermutations; i++) {
-            occupancyPermutations[i] = 0;
-            for (std::uint32_t j = 0; j < oneIndices.size(); j++) {
-                if (i & (1ULL << j)) {
-                    occupancyPermutations[i] |= (1ULL << oneIndices[j]);
-                }
-            }
-#ifdef USE_PEXT
-            std::uint64_t idx = _pext_u64(occupancyPermutations[i], mask);
-            squareAttacks[idx] = GenAttackBitboardFunc(square, occupancyPermutations[i]);
-#else
-            attackBitboards[i] = GenAttackBitboardFunc(square, occupancyPermutations[i]);
-#endif
-        }
-#ifndef USE_PEXT
-        std::vector<bool> idxUsed(countPermutations, false);
-        std::uint64_t magic;
-        while (true) {
-            magic = GenMagic();
+        int bits = std::popcount(mask);
+        int shift = 64 - bits;
+
+        std::vector<Bitboard> occupancies;
+        std::vector<Bitboard> attacks;
+        Bitboard occupancy = 0;
+        do {
+            occupancies.push_back(occupancy);
+            attacks.push_back(GenAttackBitboardFunc(square, occupancy));
+            occupancy = (occupancy - mask) & mask; // next subset of mask (Carry-Rippler)
+        } while (occupancy);
+
+        std::vector<Bitboard> table(occupancies.size());
+        std::vector<int> epoch(occupancies.size(), 0);
+        for (int attempt = 1; ; attempt++) {
+            std::uint64_t magic = GenMagic();
             // see chessprogramming link above for this weirdness
             if (std::popcount((mask * magic) & 0xFF00000000000000ULL) < 6) { continue; }
             bool goodMagic = true;
-            idxUsed.assign(idxUsed.size(), false);
-            for (std::uint32_t i = 0; i < countPermutations; i++) {
-                Bitboard occupancyPermutation = occupancyPermutations[i];
-                int permutationIdx = (occupancyPermutation * magic) >> shift;
+            for (std::size_t i = 0; i < occupancies.size(); i++) {
+                std::size_t idx = (occupancies[i] * magic) >> shift;
+                if (epoch[idx] != attempt) {
+                    epoch[idx] = attempt;
+                    table[idx] = attacks[i];
+                }
                 // bad collision = bad magic number
-                if (idxUsed[permutationIdx] && squareAttacks[permutationIdx] != attackBitboards[i]) {
+                else if (table[idx] != attacks[i]) {
                     goodMagic = false;
                     break;
                 }
-                else {
-                    idxUsed[permutationIdx] = true;
-                    squareAttacks[permutationIdx] = attackBitboards[i];
-                }
             }
             if (goodMagic) {
                 magics[square] = magic;
                 break;
             }
         }
-#endif
     }
 }
 
-int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: magicgen <output_file>" << std::endl;            
-        return 1;
-    }
-
-    std::string outputFilePath = argv[1];
-    std::ofstream outputFile{outputFilePath};
-
-    GenAttackBitboardArray(true);
-    GenAttackBitboardArray(false);
-
-    outputFile << "#pragma once\n"
-                  "#include <cstdint>\n"
-                  "static constexpr std::uint64_t rookMask[64] = {";
-
-    for (int i = 0; i < 64; i++) {
-        outputFile << rookMasks[i] << "ULL,";
-    }
-
-#ifndef USE_PEXT
-    outputFile << "};\nstatic constexpr std::uint64_t rookMagic[64] = {";
-    
-    for (int i = 0; i < 64; i++) {
-        outputFile << rookMagics[i] << "ULL,";
-    }
-#endif
-    outputFile << "};\nstatic constexpr std::uint64_t rookAttacks[64][4096] = {";
-
-    for (int i = 0; i < 64; i++) {
-        for (int j = 0; j < 4096; j++) {
-            outputFile << rookAttacks[i][j] << "ULL,";
-        }
-    }
-
-    outputFile << "};\nstatic constexpr std::uint64_t bishopMask[64] = {";
-
+static void WriteMagics(std::ostream& out, const char* name, const std::uint64_t (&magics)[64]) {
+    out << "static constexpr std::uint64_t " << name << "[64] = {\n";
     for (int i = 0; i < 64; i++) {
-        outputFile << bishopMasks[i] << "ULL,";
+        out << (i % 4 == 0 ? "    " : " ") << "0x" << std::hex << std::setw(16) << std::setfill('0') << magics[i] << "ULL,"
+            << (i % 4 == 3 ? "\n" : "");
     }
+    out << std::dec << "};\n";
+}
 
-#ifndef USE_PEXT
-    outputFile << "};\nstatic constexpr std::uint64_t bishopMagic[64] = {";
-    
-    for (int i = 0; i < 64; i++) {
-        outputFile << bishopMagics[i] << "ULL,";
-    }
-#endif
-
-    outputFile << "};\nstatic constexpr std::uint64_t bishopAttacks[64][512] = {";
-
-    for (int i = 0; i < 64; i++) {
-        for (int j = 0; j < 512; j++) {
-            outputFile << bishopAttacks[i][j] << "ULL,";
-        }
-    }
+int main() {
+    std::uint64_t rookMagics[64];
+    std::uint64_t bishopMagics[64];
+    FindMagics(true, rookMagics);
+    FindMagics(false, bishopMagics);
 
-    outputFile << "};\n";
+    // Paste the output into attack_bitboards.cpp
+    WriteMagics(std::cout, "ROOK_MAGICS", rookMagics);
+    WriteMagics(std::cout, "BISHOP_MAGICS", bishopMagics);
+    return 0;
 }
@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "movegen.h"
+#include "tablebase.h"
+#include "utilities.h"
+
+// Generates small Syzygy tables (.rtbw and .rtbz) for the tablebase tests by iterating over every position of a
+// material signature: first WDL to a fixpoint, then DTZ, using the engine's own move generation. Tables reached by
+// captures and promotions are generated first if the output directory doesn't have them yet.
+// Values are written with a fixed length code instead of Syzygy's pair compression, which the decoder reads all the
+// same, and every position is probed back through the engine's decoder before tbgen reports success. Wins and
+// losses over 100 plies are marked cursed and blessed, which is only exact when no capture leads into one.
+// Every position and its successor list is kept in memory, which is fine for 3 men and gets heavy at 4.
+
+int maxDepth; // required by movegen
+
+namespace {
+
+constexpr std::uint32_t ZEROING_CHILD = 1u << 31;
+constexpr int UNKNOWN_DTZ = 1 << 30;
+
+enum Outcome : std::int8_t { Unknown, Win, Loss, Draw, Illegal };
+
+struct Position {
+    std::uint32_t firstChild;   // into children, successors inside this table
+    std::uint32_t childCount;
+    bool externalLoss;          // a capture or promotion reaches a position lost for the opponent
+    bool externalDraw;          // ... or a drawn one
+    bool externalWin;           // ... or one won by the opponent
+};
+
+// Positions are generated over 64 squares per piece in TablebasePieces order, plus the side to move
+std::uint64_t EntryCount(const std::vector<Piece>& pieces) {
+    return (std::uint64_t)2 << (6 * pieces.size());
+}
+
+std::uint64_t DenseIndex(const Board& board, Color colorToMove, const std::vector<Piece>& pieces) {
+    std::uint64_t index = colorToMove;
+    Bitboard squares = 0;
+    for (std::size_t i = 0; i < pieces.size(); i++) {
+        if (i == 0 || pieces[i].type != pieces[i - 1].type || pieces[i].color != pieces[i - 1].color) {
+            squares = board.bitboards2D[pieces[i].color][(int)pieces[i].type];
+        }
+        index = index * 64 + PopLSB(squares);
+    }
+    return index;
+}
+
+// Decodes a dense index into a board; false for illegal positions and for non-ascending orderings of equal pieces
+bool DecodeIndex(std::uint64_t index, const std::vector<Piece>& pieces, Board& board, Color& colorToMove) {
+    board = Board(false);
+    board.castlingRights = 0;
+    Square squares[TABLEBASE_MAX_PIECES];
+    for (int i = (int)pieces.size() - 1; i >= 0; i--) {
+        squares[i] = index % 64;
+        index /= 64;
+    }
+    colorToMove = Color(index);
+    for (std::size_t i = 0; i < pieces.size(); i++) {
+        Square square = squares[i];
+        if (board.Occupancy() & ToBitboard(square)) {
+            return false;
+        }
+        if (pieces[i].type == PieceType::Pawn && (square < 8 || square >= 56)) {
+            return false;
+        }
+        if (i > 0 && pieces[i].type == pieces[i - 1].type && pieces[i].color == pieces[i - 1].color && square < squares[i - 1]) {
+            return false;
+        }
+        board.AddPiece(pieces[i].type, pieces[i].color, square);
+    }
+    // The side that just moved can't be in check
+    return !InCheck(board, ToggleColor(colorToMove));
+}
+
+// Values of one side to move and leading pawn file, in Syzygy index order
+struct Subtable {
+    SyzygyEncoding encoding;
+    int order[2];
+    std::vector<std::uint8_t> values;
+    std::vector<bool> written;
+};
+
+// Pieces in an order the index encoding accepts: leading pawns, then the other side's pawns, then runs of equal
+// pieces; without pawns the pieces a side has one of come first, so the leading group is three unique pieces or the
+// two kings
+void ChooseEncoding(const SyzygyMaterial& material, const std::vector<Piece>& pieces, int file, Subtable& subtable) {
+    std::vector<std::uint8_t> codes;
+    for (const Piece& piece : pieces) {
+        codes.push_back((std::uint8_t)((int)piece.type + 1 + 8 * piece.color));
+    }
+    auto rank = [&](std::uint8_t code) {
+        if (material.hasPawns) {
+            std::uint8_t leadPawn = material.leadColor == White ? 1 : 9;
+            return code == leadPawn ? 0 : code == (leadPawn ^ 8) ? 1 : 2;
+        }
+        return std::count(codes.begin(), codes.end(), code) == 1 ? 0 : 1;
+    };
+    std::stable_sort(codes.begin(), codes.end(), [&](std::uint8_t a, std::uint8_t b) {
+        return rank(a) != rank(b) ? rank(a) < rank(b) : a < b;
+    });
+    std::copy(codes.begin(), codes.end(), subtable.encoding.pieces);
+    subtable.order[0] = 0;
+    subtable.order[1] = material.hasPawns && material.pawnCount[1] ? 1 : 0xF;
+    SetSyzygyGroups(material, subtable.encoding, subtable.order, file);
+    std::uint64_t size = subtable.encoding.groupIdx[std::find(subtable.encoding.groupLen, subtable.encoding.groupLen + TABLEBASE_MAX_PIECES, 0) - subtable.encoding.groupLen];
+    subtable.values.assign(size, 0);
+    subtable.written.assign(size, false);
+}
+
+void Append(std::vector<std::uint8_t>& out, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((std::uint8_t)(value >> (8 * i)));
+    }
+}
+
+void Align(std::vector<std::uint8_t>& out, std::size_t alignment) {
+    out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+// The parts of a Syzygy file for one subtable. Every value is its own symbol of the same length, so the Huffman
+// code has a single length and the pair tree only leaves.
+struct CompressedValues {
+    std::vector<std::uint8_t> sizes, sparseIndex, blockLengths, blocks;
+};
+
+constexpr int BLOCK_SIZE_BITS = 5; // small blocks like real tables, a probe decodes from the start of its block
+constexpr int SPAN_BITS = 8;
+
+CompressedValues Compress(const std::vector<std::uint8_t>& values, std::uint8_t flags) {
+    CompressedValues compressed;
+    std::vector<std::uint8_t> symbolValues = values;
+    std::sort(symbolValues.begin(), symbolValues.end());
+    symbolValues.erase(std::unique(symbolValues.begin(), symbolValues.end()), symbolValues.end());
+    if (symbolValues.size() == 1) {
+        compressed.sizes = { (std::uint8_t)(flags | 128), symbolValues[0] };
+        return compressed;
+    }
+    std::uint8_t symbols[256] = {};
+    for (std::size_t i = 0; i < symbolValues.size(); i++) {
+        symbols[symbolValues[i]] = (std::uint8_t)i;
+    }
+    const int symbolBits = std::bit_width(symbolValues.size() - 1);
+    const std::uint64_t perBlock = (8 << BLOCK_SIZE_BITS) / symbolBits;
+    const std::uint64_t blockCount = (values.size() + perBlock - 1) / perBlock;
+
+    std::vector<std::uint8_t>& sizes = compressed.sizes;
+    sizes = { flags, BLOCK_SIZE_BITS, SPAN_BITS, 0 };
+    Append(sizes, blockCount, 4);
+    sizes.push_back((std::uint8_t)symbolBits); // longest and shortest code
+    sizes.push_back((std::uint8_t)symbolBits);
+    Append(sizes, 0, 2);                       // lowest symbol of that length
+    Append(sizes, symbolValues.size(), 2);
+    for (std::uint8_t value : symbolValues) {  // leaves: left is the value, right 0xFFF
+        sizes.push_back(value);
+        sizes.push_back(0xF0);
+        sizes.push_back(0xFF);
+    }
+    Align(sizes, 2);
+
+    compressed.blocks.assign(blockCount << BLOCK_SIZE_BITS, 0);
+    for (std::uint64_t i = 0; i < values.size(); i++) {
+        std::uint64_t bit = (i / perBlock << (BLOCK_SIZE_BITS + 3)) + i % perBlock * symbolBits;
+        for (int b = symbolBits - 1; b >= 0; b--, bit++) {
+            if (symbols[values[i]] >> b & 1) {
+                compressed.blocks[bit / 8] |= 0x80 >> (bit % 8);
+            }
+        }
+    }
+    for (std::uint64_t block = 0; block < blockCount; block++) {
+        Append(compressed.blockLengths, std::min(perBlock, values.size() - block * perBlock) - 1, 2);
+    }
+    // Entry k locates index k * span + span / 2, clamped to the last value with the rest added to the offset
+    const std::uint64_t span = (std::uint64_t)1 << SPAN_BITS;
+    for (std::uint64_t k = 0; k < (values.size() + span - 1) / span; k++) {
+        std::uint64_t target = k * span + span / 2;
+        std::uint64_t index = std::min<std::uint64_t>(target, values.size() - 1);
+        Append(compressed.sparseIndex, index / perBlock, 4);
+        Append(compressed.sparseIndex, index % perBlock + (target - index), 2);
+    }
+    return compressed;
+}
+
+bool WriteTable(const std::filesystem::path& path, const SyzygyMaterial& material, bool dtz, Subtable (&subtables)[2][4], std::uint8_t flags) {
+    const bool split = material.key != material.key2;
+    const int sides = !dtz && split ? 2 : 1;
+    const int files = material.hasPawns ? 4 : 1;
+    const bool bothPawns = material.hasPawns && material.pawnCount[1];
+    std::vector<std::uint8_t> out = dtz ? std::vector<std::uint8_t>{ 0xD7, 0x66, 0x0C, 0xA5 }
+                                        : std::vector<std::uint8_t>{ 0x71, 0xE8, 0x23, 0x5D };
+    out.push_back((std::uint8_t)(split | material.hasPawns << 1));
+    for (int file = 0; file < files; file++) {
+        const Subtable& other = subtables[sides - 1][file];
+        for (int i = 0; i < 1 + bothPawns; i++) {
+            out.push_back((std::uint8_t)(subtables[0][file].order[i] | other.order[i] << 4));
+        }
+        for (int i = 0; i < material.pieceCount; i++) {
+            out.push_back((std::uint8_t)(subtables[0][file].encoding.pieces[i] | other.encoding.pieces[i] << 4));
+        }
+    }
+    Align(out, 2);
+    CompressedValues compressed[2][4];
+    for (int file = 0; file < files; file++) {
+        for (int stm = 0; stm < sides; stm++) {
+            compressed[stm][file] = Compress(subtables[stm][file].values, flags);
+            out.insert(out.end(), compressed[stm][file].sizes.begin(), compressed[stm][file].sizes.end());
+        }
+    }
+    if (dtz) {
+        Align(out, 2); // no value maps
+    }
+    for (auto part : { &CompressedValues::sparseIndex, &CompressedValues::blockLengths, &CompressedValues::blocks }) {
+        for (int file = 0; file < files; file++) {
+            for (int stm = 0; stm < sides; stm++) {
+                if (part == &CompressedValues::blocks) {
+                    Align(out, 64);
+                }
+                const std::vector<std::uint8_t>& bytes = compressed[stm][file].*part;
+                out.insert(out.end(), bytes.begin(), bytes.end());
+            }
+        }
+    }
+    out.resize(out.size() + 8, 0); // the decoder reads a little past the end of a block
+    std::ofstream stream{path, std::ios::binary};
+    stream.write((const char*)out.data(), out.size());
+    if (!stream) {
+        std::cerr << "Failed to write '" << path.string() << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool GenerateTable(const std::string& name, const std::filesystem::path& directory);
+
+// Loads the table for a position reached by a capture or promotion, generating it first if needed
+bool ProbeOrGenerate(const Board& board, Color colorToMove, const std::filesystem::path& directory, int& wdl) {
+    if (ProbeWDL(board, colorToMove, wdl)) {
+        return true;
+    }
+    bool flipped;
+    if (!GenerateTable(TablebaseName(board, flipped), directory)) {
+        return false;
+    }
+    LoadTablebases(directory.string());
+    return ProbeWDL(board, colorToMove, wdl);
+}
+
+bool GenerateTable(const std::string& name, const std::filesystem::path& directory) {
+    std::vector<Piece> pieces = TablebasePieces(name);
+    SyzygyMaterial material;
+    if (pieces.empty() || !ParseSyzygyMaterial(name, material)) {
+        std::cerr << "Invalid table name '" << name << "'" << std::endl;
+        return false;
+    }
+    if (pieces.size() > 4) {
+        std::cerr << name << ": only tables of up to 4 pieces can be generated in memory" << std::endl;
+        return false;
+    }
+    bool flipped;
+    Board check(false);
+    for (std::size_t i = 0; i < pieces.size(); i++) {
+        check.AddPiece(pieces[i].type, pieces[i].color, (Square)i);
+    }
+    if (TablebaseName(check, flipped) != name) {
+        std::cerr << "'" << name << "' is not a canonical table name, try '" << TablebaseName(check, flipped) << "'" << std::endl;
+        return false;
+    }
+    std::cout << "Generating " << name << "..." << std::endl;
+
+    const std::uint64_t entryCount = EntryCount(pieces);
+    std::vector<Position> positions(entryCount);
+    std::vector<std::uint32_t> children;
+    std::vector<Outcome> outcomes(entryCount, Unknown);
+    std::vector<int> dtz(entryCount, UNKNOWN_DTZ);
+
+    // Successors, checkmates and stalemates
+    for (std::uint64_t index = 0; index < entryCount; index++) {
+        Board board;
+        Color colorToMove;
+        if (!DecodeIndex(index, pieces, board, colorToMove)) {
+            outcomes[index] = Illegal;
+            continue;
+        }
+        Position& position = positions[index];
+        position = { (std::uint32_t)children.size(), 0, false, false, false };
+        MoveList moves = GenMoves(board, colorToMove);
+        if (moves.empty()) {
+            outcomes[index] = InCheck(board, colorToMove) ? Loss : Draw;
+            dtz[index] = 0;
+            continue;
+        }
+        for (const Move& move : moves) {
+            bool pawnMove = board.PieceTypeAt(move.From()) == PieceType::Pawn;
+            Board child = board;
+            UndoInfo undo = MakeMove(move, child, colorToMove);
+            child.enPassant = -1;
+            if (undo.capturedPieceType != PieceType::None || move.Type() == Move::Promotion) {
+                int wdl;
+                if (!ProbeOrGenerate(child, ToggleColor(colorToMove), directory, wdl)) {
+                    return false;
+                }
+                position.externalLoss |= wdl < 0;
+                position.externalDraw |= wdl == 0;
+                position.externalWin |= wdl > 0;
+            }
+            else {
+                std::uint32_t childIndex = (std::uint32_t)DenseIndex(child, ToggleColor(colorToMove), pieces);
+                children.push_back(childIndex | (pawnMove ? ZEROING_CHILD : 0));
+                position.childCount++;
+            }
+        }
+        if (position.externalLoss) {
+            outcomes[index] = Win;
+            dtz[index] = 1;
+        }
+    }
+
+    auto childIndex = [&](std::uint32_t child) { return child & ~ZEROING_CHILD; };
+
+    // WDL: a position is won if some move reaches a lost one and lost if every move reaches a won one
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (std::uint64_t index = 0; index < entryCount; index++) {
+            if (outcomes[index] != Unknown) {
+                continue;
+            }
+            const Position& position = positions[index];
+            bool allWin = !position.externalDraw;
+            for (std::uint32_t i = 0; i < position.childCount; i++) {
+                Outcome childOutcome = outcomes[childIndex(children[position.firstChild + i])];
+                if (childOutcome == Loss) {
+                    outcomes[index] = Win;
+                    changed = true;
+                    break;
+                }
+                allWin &= childOutcome == Win;
+            }
+            if (outcomes[index] == Unknown && allWin) {
+                outcomes[index] = Loss;
+                changed = true;
+            }
+        }
+    }
+
+    // DTZ: relax until nothing changes. Values only ever decrease and stay upper bounds of the true distance, and
+    // after n passes every position whose true distance is at most n has it.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (std::uint64_t index = 0; index < entryCount; index++) {
+            Outcome outcome = outcomes[index];
+            if (outcome != Win && outcome != Loss) {
+                continue;
+            }
+            const Position& position = positions[index];
+            if (position.childCount == 0 && dtz[index] == 0) {
+                continue; // checkmated
+            }
+            int best = outcome == Win ? UNKNOWN_DTZ : (position.externalWin ? 1 : 0);
+            for (std::uint32_t i = 0; i < position.childCount; i++) {
+                std::uint32_t child = children[position.firstChild + i];
+                std::uint64_t index2 = childIndex(child);
+                bool zeroing = child & ZEROING_CHILD;
+                int childDtz = zeroing ? 1 : (dtz[index2] >= UNKNOWN_DTZ ? UNKNOWN_DTZ : dtz[index2] + 1);
+                if (outcome == Win && outcomes[index2] == Loss) {
+                    best = std::min(best, childDtz);
+                }
+                else if (outcome == Loss) {
+                    best = std::max(best, childDtz);
+                }
+            }
+            if (best < dtz[index]) {
+                dtz[index] = best;
+                changed = true;
+            }
+        }
+    }
+
+    // Spread the values over the Syzygy subtables. WDL stores both sides to move unless the material is
+    // symmetric, DTZ only white to move (in the table's colors) and the decoder searches one ply for black.
+    Subtable wdlTables[2][4], dtzTables[2][4];
+    for (int file = 0; file < (material.hasPawns ? 4 : 1); file++) {
+        for (int stm = 0; stm < 2; stm++) {
+            ChooseEncoding(material, pieces, file, wdlTables[stm][file]);
+            std::fill(wdlTables[stm][file].values.begin(), wdlTables[stm][file].values.end(), 2);
+        }
+        ChooseEncoding(material, pieces, file, dtzTables[0][file]);
+    }
+    const bool symmetric = material.key == material.key2;
+    auto store = [&](Subtable& subtable, std::uint64_t index, std::uint8_t value) {
+        if (subtable.written[index] && subtable.values[index] != value) {
+            return false;
+        }
+        subtable.written[index] = true;
+        subtable.values[index] = value;
+        return true;
+    };
+    for (std::uint64_t index = 0; index < entryCount; index++) {
+        Board board;
+        Color colorToMove;
+        if (outcomes[index] == Illegal || !DecodeIndex(index, pieces, board, colorToMove)) {
+            continue;
+        }
+        Outcome outcome = outcomes[index];
+        bool decided = outcome == Win || outcome == Loss;
+        bool overFiftyMoves = decided && dtz[index] > 100;
+        int wdl = outcome == Win ? (overFiftyMoves ? 1 : 2) : outcome == Loss ? (overFiftyMoves ? -1 : -2) : 0;
+        SyzygyPosition position = NormalizeSyzygyPosition(material, board, colorToMove, symmetric && colorToMove == Black);
+        Subtable& wdlTable = wdlTables[position.stm][position.file];
+        bool consistent = store(wdlTable, SyzygyIndex(material, wdlTable.encoding, position), (std::uint8_t)(wdl + 2));
+        if (position.stm == 0) {
+            // DTZ minus one in plies, in moves past the fifty move rule, clamped at 0 for mated positions
+            int value = !decided ? 0 : overFiftyMoves ? (dtz[index] - 101) / 2 : std::max(dtz[index] - 1, 0);
+            Subtable& dtzTable = dtzTables[0][position.file];
+            consistent &= store(dtzTable, SyzygyIndex(material, dtzTable.encoding, position), (std::uint8_t)std::min(value, 255));
+        }
+        if (!consistent) {
+            std::cerr << name << ": positions with different values share a Syzygy index" << std::endl;
+            return false;
+        }
+    }
+    if (!WriteTable(directory / (name + ".rtbw"), material, false, wdlTables, 0) ||
+        !WriteTable(directory / (name + ".rtbz"), material, true, dtzTables, 4 | 8)) { // values in plies
+        return false;
+    }
+
+    // Read every position back through the engine's probing code
+    LoadTablebases(directory.string());
+    std::uint64_t mismatches = 0;
+    for (std::uint64_t index = 0; index < entryCount; index++) {
+        Board board;
+        Color colorToMove;
+        if (outcomes[index] == Illegal || !DecodeIndex(index, pieces, board, colorToMove)) {
+            continue;
+        }
+        bool decided = (outcomes[index] == Win || outcomes[index] == Loss) && dtz[index] <= 100;
+        int expectedWdl = !decided ? 0 : outcomes[index] == Win ? 1 : -1;
+        int wdl, probedDtz;
+        if (!ProbeDTZ(board, colorToMove, wdl, probedDtz) || wdl != expectedWdl || (decided && probedDtz != dtz[index])) {
+            mismatches++;
+        }
+    }
+    if (mismatches) {
+        std::cerr << name << ": " << mismatches << " positions probe differently from what was generated" << std::endl;
+        return false;
+    }
+
+    std::uint64_t wins = std::count(outcomes.begin(), outcomes.end(), Win);
+    std::uint64_t losses = std::count(outcomes.begin(), outcomes.end(), Loss);
+    std::uint64_t draws = std::count(outcomes.begin(), outcomes.end(), Draw) + std::count(outcomes.begin(), outcomes.end(), Unknown);
+    int maxDtz = 0;
+    for (std::uint64_t index = 0; index < entryCount; index++) {
+        if (outcomes[index] == Win || outcomes[index] == Loss) {
+            maxDtz = std::max(maxDtz, dtz[index]);
+        }
+    }
+    std::cout << name << ": " << wins << " wins, " << draws << " draws, " << losses << " losses, max DTZ " << maxDtz << std::endl;
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: tbgen <output directory> <table>... (e.g. tbgen tb KQvK KRvK KPvK)" << std::endl;
+        return 1;
+    }
+    std::filesystem::path directory = argv[1];
+    std::filesystem::create_directories(directory);
+    LoadTablebases(directory.string());
+    for (int i = 2; i < argc; i++) {
+        if (std::filesystem::exists(directory / (std::string(argv[i]) + ".rtbw"))) {
+            continue;
+        }
+        if (!GenerateTable(argv[i], directory)) {
+            return 1;
+        }
+        LoadTablebases(directory.string());
+    }
+    return 0;
+}
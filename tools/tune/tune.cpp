@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "eval_params.h"
+#include "eval_trace.h"
+#include "fen.h"
+#include "packed_position.h"
+#include "search.h"
+
+// Texel tuning of the weights in eval_params.h. Every labelled position is evaluated once with the evaluation trace
+// enabled, which turns it into a sparse row of coefficients, one per weight the position's evaluation depends on, plus
+// a constant for everything that isn't tuned (king zone attacks, rounding). From then on the evaluation of a position
+// is the dot product of its row with the weights, so an epoch is one streaming pass over flat arrays and never calls
+// Evaluate again. The weights minimise the mean squared error between sigmoid(eval) and the label, using full batch
+// gradients computed on all threads and Adam updates, and are written out as a new eval_params.h.
+//
+// Data is .fpack files from gensfen or EPD files with a result per line ("1-0", "0-1", "1/2-1/2", or [1.0], [0.5],
+// [0.0]), both only containing quiet positions.
+
+int maxDepth; // required by movegen
+
+namespace {
+
+// Weight groups in the order of the weight vector and of eval_params.h. Scaled groups are the king shelter terms,
+// which the evaluation multiplies by the king safety scale of the king's side.
+struct WeightGroup {
+    const char* name;
+    int size;
+    bool scaled;
+};
+
+enum Group { PieceValues, PawnTable, KnightTable, BishopTable, RookTable, QueenTable, DoubledPawn, IsolatedPawn,
+             BlockedPawn, ShieldBonus, ShieldMissing, StormPenalty, SemiOpenFile, OpenFile, GroupCount };
+
+constexpr WeightGroup groups[GroupCount] = {
+    { "pieceValues", 5, false },
+    { "pawnScoreTable", 64, false },
+    { "knightScoreTable", 64, false },
+    { "bishopScoreTable", 64, false },
+    { "rookScoreTable", 64, false },
+    { "queenScoreTable", 64, false },
+    { "doubledPawnPenalty", 1, false },
+    { "isolatedPawnPenalty", 1, false },
+    { "blockedPawnPenalty", 1, false },
+    { "pawnShieldBonus", 3, true },
+    { "pawnShieldMissing", 1, true },
+    { "pawnStormPenalty", 4, true },
+    { "semiOpenFileNearKing", 1, true },
+    { "openFileNearKing", 1, true },
+};
+
+struct Offsets {
+    int start[GroupCount + 1];
+    constexpr Offsets() : start() {
+        for (int i = 0; i < GroupCount; i++) {
+            start[i + 1] = start[i] + groups[i].size;
+        }
+    }
+};
+constexpr Offsets offsets;
+constexpr int WEIGHT_COUNT = offsets.start[GroupCount];
+
+std::vector<double> InitialWeights() {
+    std::vector<double> weights(WEIGHT_COUNT);
+    auto set = [&](Group group, const int* values) {
+        std::copy(values, values + groups[group].size, weights.begin() + offsets.start[group]);
+    };
+    const std::array<int, 64>* tables[5] = { &pawnScoreTable, &knightScoreTable, &bishopScoreTable, &rookScoreTable,
+                                             &queenScoreTable };
+    set(PieceValues, pieceValues);
+    for (int i = 0; i < 5; i++) {
+        set(Group(PawnTable + i), tables[i]->data());
+    }
+    set(DoubledPawn, &doubledPawnPenalty);
+    set(IsolatedPawn, &isolatedPawnPenalty);
+    set(BlockedPawn, &blockedPawnPenalty);
+    set(ShieldBonus, pawnShieldBonus);
+    set(ShieldMissing, &pawnShieldMissing);
+    set(StormPenalty, pawnStormPenalty);
+    set(SemiOpenFile, &semiOpenFileNearKing);
+    set(OpenFile, &openFileNearKing);
+    return weights;
+}
+
+// One non-zero coefficient of a position. scale is 0 for plain terms, 1 + color for terms scaled by that color's king
+// safety scale.
+struct Entry {
+    std::uint16_t weight;
+    std::int8_t coefficient;
+    std::uint8_t scale;
+};
+static_assert(sizeof(Entry) == 4);
+
+// Structure of arrays, position p owns entries[first[p], first[p + 1])
+struct Dataset {
+    std::vector<std::uint32_t> first{0};
+    std::vector<Entry> entries;
+    std::vector<float> constant;
+    std::vector<float> target;
+    std::vector<float> scale[2];
+
+    std::size_t Size() const { return target.size(); }
+};
+
+// Adds the position's coefficients, from white's POV, with target the expected score for white in [0, 1]
+void AddPosition(Dataset& data, const std::vector<double>& weights, const Board& board, double target) {
+    evalTrace = {};
+    double eval = Evaluate(board, White);
+    double linear = 0;
+    auto add = [&](int weight, int coefficient, int scale) {
+        if (coefficient != 0) {
+            data.entries.push_back({ (std::uint16_t)weight, (std::int8_t)coefficient, (std::uint8_t)scale });
+            linear += weights[weight] * coefficient * (scale ? evalTrace.kingSafetyScale[scale - 1] : 1.0);
+        }
+    };
+    auto addPlain = [&](Group group, int index, const int (&count)[2]) {
+        add(offsets.start[group] + index, count[White] - count[Black], 0);
+    };
+    auto addScaled = [&](Group group, int index, const int (&count)[2]) {
+        add(offsets.start[group] + index, count[White], 1 + White);
+        add(offsets.start[group] + index, -count[Black], 1 + Black);
+    };
+    for (int type = 0; type < 5; type++) {
+        addPlain(PieceValues, type, evalTrace.pieces[type]);
+        for (int square = 0; square < 64; square++) {
+            addPlain(Group(PawnTable + type), square, evalTrace.pieceSquares[type][square]);
+        }
+    }
+    addPlain(DoubledPawn, 0, evalTrace.doubledPawns);
+    addPlain(IsolatedPawn, 0, evalTrace.isolatedPawns);
+    addPlain(BlockedPawn, 0, evalTrace.blockedPawns);
+    for (int i = 0; i < 3; i++) {
+        addScaled(ShieldBonus, i, evalTrace.pawnShieldBonus[i]);
+    }
+    addScaled(ShieldMissing, 0, evalTrace.pawnShieldMissing);
+    for (int i = 0; i < 4; i++) {
+        addScaled(StormPenalty, i, evalTrace.pawnStormPenalty[i]);
+    }
+    addScaled(SemiOpenFile, 0, evalTrace.semiOpenFileNearKing);
+    addScaled(OpenFile, 0, evalTrace.openFileNearKing);
+
+    data.first.push_back((std::uint32_t)data.entries.size());
+    data.constant.push_back((float)(eval - linear));
+    data.target.push_back((float)target);
+    data.scale[White].push_back((float)evalTrace.kingSafetyScale[White]);
+    data.scale[Black].push_back((float)evalTrace.kingSafetyScale[Black]);
+}
+
+// Result for white in [0, 1] from an EPD line, -1 if it has none
+double ParseResult(std::string_view line) {
+    const std::pair<std::string_view, double> results[] = {
+        { "1/2-1/2", 0.5 }, { "1-0", 1.0 }, { "0-1", 0.0 }, { "[1.0]", 1.0 }, { "[0.5]", 0.5 }, { "[0.0]", 0.0 },
+    };
+    for (const auto& [text, result] : results) {
+        if (line.find(text) != std::string_view::npos) {
+            return result;
+        }
+    }
+    return -1;
+}
+
+struct TuneOptions {
+    std::vector<std::string> dataPaths;
+    std::string outPath;
+    int epochs = 1000;
+    double learningRate = 1.0;
+    double k = 0; // 0 means fit it to the data first
+    double lambda = 1.0; // weight of the game result in the target, the rest is the sigmoid of the search score
+    std::uint64_t maxPositions = 0;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+};
+
+bool Load(const std::string& path, const TuneOptions& options, const std::vector<double>& weights, Dataset& data) {
+    auto full = [&] { return options.maxPositions && data.Size() >= options.maxPositions; };
+    if (path.ends_with(".fpack")) {
+        PackedPositionReader reader;
+        if (!reader.Open(path)) {
+            std::cerr << "Failed to open '" << path << "'" << std::endl;
+            return false;
+        }
+        PackedPosition position;
+        while (!full() && reader.Next(position)) {
+            Board board;
+            Color colorToMove;
+            UnpackPosition(position, board, colorToMove);
+            int sign = colorToMove == White ? 1 : -1;
+            double result = (sign * position.result + 1) / 2.0;
+            // The search score is turned into an expected result with the same scale as the evaluation, K = 1
+            double scoreResult = 1 / (1 + std::pow(10.0, -sign * position.score / 400.0));
+            AddPosition(data, weights, board, options.lambda * result + (1 - options.lambda) * scoreResult);
+        }
+        return true;
+    }
+    std::ifstream file{path};
+    if (!file) {
+        std::cerr << "Failed to open '" << path << "'" << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int lineNumber = 1; !full() && std::getline(file, line); lineNumber++) {
+        double result = ParseResult(line);
+        if (result < 0) {
+            continue;
+        }
+        try {
+            AddPosition(data, weights, ParseFen(EpdToFen(line)).board, result);
+        }
+        catch (const std::exception& error) {
+            std::cerr << path << ":" << lineNumber << ": " << error.what() << std::endl;
+        }
+    }
+    return true;
+}
+
+double Sigmoid(double k, double eval) {
+    return 1 / (1 + std::exp(-k * eval));
+}
+
+// Evaluation from white's POV under the current weights
+double Eval(const Dataset& data, const std::vector<double>& weights, std::size_t p) {
+    const double scale[3] = { 1.0, data.scale[White][p], data.scale[Black][p] };
+    double eval = data.constant[p];
+    for (std::uint32_t i = data.first[p]; i < data.first[p + 1]; i++) {
+        const Entry& entry = data.entries[i];
+        eval += weights[entry.weight] * entry.coefficient * scale[entry.scale];
+    }
+    return eval;
+}
+
+// Runs work(begin, end, thread) over the positions split evenly between the threads
+template<typename Work>
+void Parallel(const Dataset& data, int threads, Work work) {
+    std::vector<std::thread> workers;
+    std::size_t chunk = (data.Size() + threads - 1) / threads;
+    for (int t = 0; t < threads; t++) {
+        std::size_t begin = std::min(data.Size(), t * chunk);
+        std::size_t end = std::min(data.Size(), begin + chunk);
+        workers.emplace_back(work, begin, end, t);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// k converts centipawns to the sigmoid's natural scale: the usual 10^(-K * eval / 400) with k = K * ln(10) / 400
+double Loss(const Dataset& data, const std::vector<double>& weights, double k, int threads) {
+    std::vector<double> losses(threads);
+    Parallel(data, threads, [&](std::size_t begin, std::size_t end, int t) {
+        double loss = 0;
+        for (std::size_t p = begin; p < end; p++) {
+            double error = Sigmoid(k, Eval(data, weights, p)) - data.target[p];
+            loss += error * error;
+        }
+        losses[t] = loss;
+    });
+    double loss = 0;
+    for (double threadLoss : losses) {
+        loss += threadLoss;
+    }
+    return loss / data.Size();
+}
+
+// Golden section search for the k that best fits the current weights to the data
+double FitK(const Dataset& data, const std::vector<double>& weights, int threads) {
+    const double ratio = (std::sqrt(5.0) - 1) / 2;
+    double low = 0, high = 0.05;
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double lossA = Loss(data, weights, a, threads), lossB = Loss(data, weights, b, threads);
+    while (high - low > 1e-6) {
+        if (lossA < lossB) {
+            high = b;
+            b = a;
+            lossB = lossA;
+            a = high - ratio * (high - low);
+            lossA = Loss(data, weights, a, threads);
+        }
+        else {
+            low = a;
+            a = b;
+            lossA = lossB;
+            b = low + ratio * (high - low);
+            lossB = Loss(data, weights, b, threads);
+        }
+    }
+    return (low + high) / 2;
+}
+
+// Mean gradient of the loss with respect to every weight, the constant factor 2k is left to the learning rate
+std::vector<double> Gradient(const Dataset& data, const std::vector<double>& weights, double k, int threads) {
+    std::vector<std::vector<double>> gradients(threads, std::vector<double>(WEIGHT_COUNT));
+    Parallel(data, threads, [&](std::size_t begin, std::size_t end, int t) {
+        std::vector<double>& gradient = gradients[t];
+        for (std::size_t p = begin; p < end; p++) {
+            double sigmoid = Sigmoid(k, Eval(data, weights, p));
+            double delta = (sigmoid - data.target[p]) * sigmoid * (1 - sigmoid);
+            const double scale[3] = { delta, delta * data.scale[White][p], delta * data.scale[Black][p] };
+            for (std::uint32_t i = data.first[p]; i < data.first[p + 1]; i++) {
+                const Entry& entry = data.entries[i];
+                gradient[entry.weight] += entry.coefficient * scale[entry.scale];
+            }
+        }
+    });
+    std::vector<double> gradient(WEIGHT_COUNT);
+    for (const std::vector<double>& threadGradient : gradients) {
+        for (int i = 0; i < WEIGHT_COUNT; i++) {
+            gradient[i] += threadGradient[i] / data.Size();
+        }
+    }
+    return gradient;
+}
+
+void Tune(const Dataset& data, std::vector<double>& weights, double k, const TuneOptions& options) {
+    constexpr double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    std::vector<double> m(WEIGHT_COUNT), v(WEIGHT_COUNT);
+    const auto start = std::chrono::steady_clock::now();
+    for (int epoch = 1; epoch <= options.epochs; epoch++) {
+        std::vector<double> gradient = Gradient(data, weights, k, options.threads);
+        double correction1 = 1 - std::pow(beta1, epoch);
+        double correction2 = 1 - std::pow(beta2, epoch);
+        for (int i = 0; i < WEIGHT_COUNT; i++) {
+            m[i] = beta1 * m[i] + (1 - beta1) * gradient[i];
+            v[i] = beta2 * v[i] + (1 - beta2) * gradient[i] * gradient[i];
+            weights[i] -= options.learningRate * (m[i] / correction1) / (std::sqrt(v[i] / correction2) + epsilon);
+        }
+        if (epoch % 50 == 0 || epoch == options.epochs) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "epoch " << epoch << "  loss " << std::setprecision(8) << Loss(data, weights, k, options.threads)
+                      << "  " << std::setprecision(4) << seconds << " s" << std::endl;
+        }
+    }
+}
+
+void WriteArray(std::ostream& out, const std::vector<int>& values) {
+    out << "{ ";
+    for (std::size_t i = 0; i < values.size(); i++) {
+        out << (i ? ", " : "") << values[i];
+    }
+    out << " }";
+}
+
+void WriteTable(std::ostream& out, const char* name, const int* values) {
+    out << "static constexpr std::array<int, 64> " << name << " = {\n";
+    for (int rank = 0; rank < 8; rank++) {
+        out << "    ";
+        for (int file = 0; file < 8; file++) {
+            out << std::setw(3) << values[rank * 8 + file] << (rank * 8 + file < 63 ? (file < 7 ? ", " : ",") : "");
+        }
+        out << "\n";
+    }
+    out << "};\n\n";
+}
+
+// Same layout as the checked in eval_params.h, so a tune shows up as a diff of the numbers only
+bool WriteParams(const std::string& path, const std::vector<double>& weights) {
+    std::vector<int> rounded(WEIGHT_COUNT);
+    for (int i = 0; i < WEIGHT_COUNT; i++) {
+        rounded[i] = (int)std::lround(weights[i]);
+    }
+    auto group = [&](Group g) {
+        return std::vector<int>(rounded.begin() + offsets.start[g], rounded.begin() + offsets.start[g + 1]);
+    };
+    std::ostringstream out;
+    out << "#pragma once\n\n#include \"tunables.h\"\n#include <array>\n\n"
+           "// Tunable evaluation weights in centipawns. This file is written by tools/tune (faris-tune --out eval_params.h), so\n"
+           "// hand edits are fine but are lost on the next tune; keep the layout when editing.\n\n"
+           "// Piece-square tables from white's POV with a1 = 0, square XOR 56 to get the score from black's POV\n";
+    for (int i = 0; i < 5; i++) {
+        WriteTable(out, groups[PawnTable + i].name, rounded.data() + offsets.start[PawnTable + i]);
+    }
+    std::vector<int> values = group(PieceValues);
+    values.push_back(pieceValues[(int)PieceType::King]);
+    values.push_back(0);
+    out << "// Indexed by PieceType. The king value only orders captures made by the king, the last entry is PieceType::None.\n"
+           "TUNABLE int pieceValues[7] = ";
+    WriteArray(out, values);
+    out << ";\n\n// Per pawn\n"
+        << "static constexpr int doubledPawnPenalty = " << rounded[offsets.start[DoubledPawn]] << ";\n"
+        << "static constexpr int isolatedPawnPenalty = " << rounded[offsets.start[IsolatedPawn]] << ";\n"
+        << "static constexpr int blockedPawnPenalty = " << rounded[offsets.start[BlockedPawn]]
+        << "; // square in front occupied by any piece\n\n"
+        << "// Shelter, from the king's POV, summed over the king's file and its neighbours\n";
+    auto line = [&](const std::string& declaration, const char* comment) {
+        out << std::left << std::setw(65) << declaration << std::right << comment << "\n";
+    };
+    auto array = [&](Group g) {
+        std::ostringstream text;
+        text << "static constexpr int " << groups[g].name << "[" << groups[g].size << "] = ";
+        WriteArray(text, group(g));
+        return text.str() + ";";
+    };
+    auto scalar = [&](Group g) {
+        return "static constexpr int " + std::string(groups[g].name) + " = " + std::to_string(rounded[offsets.start[g]]) + ";";
+    };
+    line(array(ShieldBonus), "// own pawn 1 or 2 ranks in front of the king");
+    line(scalar(ShieldMissing), "// own pawns on the file, but none close in front");
+    line(array(StormPenalty), "// closest enemy pawn 1, 2 or 3 ranks in front");
+    line(scalar(SemiOpenFile), "// no own pawn on the file");
+    line(scalar(OpenFile), "// no pawn at all on the file");
+
+    std::ofstream file{path};
+    file << out.str();
+    return (bool)file;
+}
+
+bool ParseOptions(int argc, char** argv, TuneOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--")) {
+            options.dataPaths.emplace_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--out") {
+            options.outPath = value;
+        }
+        else if (arg == "--epochs") {
+            options.epochs = std::max(0, std::atoi(value));
+        }
+        else if (arg == "--lr") {
+            options.learningRate = std::atof(value);
+        }
+        else if (arg == "--k") {
+            options.k = std::atof(value) * std::log(10.0) / 400;
+        }
+        else if (arg == "--lambda") {
+            options.lambda = std::clamp(std::atof(value), 0.0, 1.0);
+        }
+        else if (arg == "--max-positions") {
+            options.maxPositions = std::strtoull(value, nullptr, 10);
+        }
+        else if (arg == "--threads") {
+            options.threads = std::max(1, std::atoi(value));
+        }
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.dataPaths.empty() || options.outPath.empty()) {
+        std::cerr << "Usage: faris-tune [--epochs <n>] [--lr <cp>] [--k <K>] [--lambda <l>] [--max-positions <n>] "
+                     "[--threads <t>] --out <eval_params.h> <data.fpack|data.epd>..." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    TuneOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    std::vector<double> weights = InitialWeights();
+    Dataset data;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& path : options.dataPaths) {
+        if (!Load(path, options, weights, data)) {
+            return 1;
+        }
+    }
+    if (data.Size() == 0) {
+        std::cerr << "No labelled positions found" << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Extracted " << data.Size() << " positions, " << data.entries.size() << " coefficients in " << seconds
+              << " s" << std::endl;
+
+    double k = options.k > 0 ? options.k : FitK(data, weights, options.threads);
+    std::cout << "K " << k * 400 / std::log(10.0) << "  initial loss " << std::setprecision(8)
+              << Loss(data, weights, k, options.threads) << std::endl;
+    Tune(data, weights, k, options);
+    if (!WriteParams(options.outPath, weights)) {
+        std::cerr << "Failed to write '" << options.outPath << "'" << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << options.outPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "trace.h"
+
+#ifdef USE_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+struct TraceRecordEntry {
+    std::uint64_t timestamp; // ns since TraceInit
+    std::uint64_t duration;  // ns, only used by complete ('X') events
+    std::int64_t arg;
+    TraceEvent event;
+    char phase;
+};
+
+// Power of two so the ring index is a mask. Oldest records are overwritten once the buffer wraps.
+constexpr std::uint64_t TRACE_BUFFER_SIZE = 1 << 18;
+
+TraceRecordEntry traceBuffer[TRACE_BUFFER_SIZE];
+std::atomic<std::uint64_t> traceHead{0};
+std::chrono::steady_clock::time_point traceStart = std::chrono::steady_clock::now();
+
+constexpr const char* eventNames[(int)TraceEvent::Count] = {
+    "Search", "Iteration", "AspirationSearch", "AspirationResearch", "TTClear", "TimeBudget", "TimeAbort",
+    "GenMoves", "Evaluate", "Quiesce"
+};
+
+constexpr const char* eventArgNames[(int)TraceEvent::Count] = {
+    "timeMS", "depth", "window", "window", nullptr, "timeMS", "overshootMS", nullptr, nullptr, nullptr
+};
+
+// Chrome trace timestamps are in microseconds. Print with ns precision without going through floating point,
+// which would switch to scientific notation on long runs.
+void WriteMicroseconds(std::ostream& out, std::uint64_t ns) {
+    char fraction[4] = { char('0' + ns / 100 % 10), char('0' + ns / 10 % 10), char('0' + ns % 10), '\0' };
+    out << ns / 1000 << '.' << fraction;
+}
+
+}
+
+std::uint64_t TraceTimestampNS() {
+    auto elapsed = std::chrono::steady_clock::now() - traceStart;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void TraceInit() {
+    traceStart = std::chrono::steady_clock::now();
+    traceHead.store(0, std::memory_order_relaxed);
+    std::atexit(TraceFlush);
+}
+
+void TraceRecord(TraceEvent event, char phase, std::int64_t arg, std::uint64_t timestamp, std::uint64_t duration) {
+    std::uint64_t index = traceHead.fetch_add(1, std::memory_order_relaxed) & (TRACE_BUFFER_SIZE - 1);
+    traceBuffer[index] = { timestamp, duration, arg, event, phase };
+}
+
+void TraceFlush() {
+    const char* path = std::getenv("FARIS_TRACE_FILE");
+    if (!path) {
+        path = "faris_trace.json";
+    }
+    std::ofstream out{path};
+    if (!out) {
+        std::cerr << "Failed to open trace file '" << path << "'" << std::endl;
+        return;
+    }
+
+    std::uint64_t head = traceHead.load(std::memory_order_acquire);
+    std::uint64_t first = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    for (std::uint64_t i = first; i < head; i++) {
+        const TraceRecordEntry& record = traceBuffer[i & (TRACE_BUFFER_SIZE - 1)];
+        out << "{\"name\":\"" << eventNames[(int)record.event] << "\",\"ph\":\"" << record.phase
+            << "\",\"pid\":1,\"tid\":1,\"ts\":";
+        WriteMicroseconds(out, record.timestamp);
+        if (record.phase == 'X') {
+            out << ",\"dur\":";
+            WriteMicroseconds(out, record.duration);
+        }
+        else if (record.phase == 'i') {
+            out << ",\"s\":\"t\"";
+        }
+        const char* argName = eventArgNames[(int)record.event];
+        if (argName && record.phase != 'E') {
+            out << ",\"args\":{\"" << argName << "\":" << record.arg << "}";
+        }
+        out << (i + 1 < head ? "},\n" : "}\n");
+    }
+    out << "]}\n";
+}
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+// Optional latency tracing (configure with -DFARIS_ENABLE_TRACE=ON). Events are recorded into a fixed-size ring
+// buffer and dumped as Chrome trace JSON (chrome://tracing, Perfetto) when the engine exits. Output path is taken
+// from the FARIS_TRACE_FILE environment variable, defaulting to faris_trace.json.
+// When tracing is disabled every hook below compiles away to nothing.
+
+enum class TraceEvent : std::uint8_t {
+    Search,             // whole call to Search, arg = allotted time in ms
+    Iteration,          // one iterative deepening iteration, arg = depth
+    AspirationSearch,   // one root search inside an iteration, arg = aspiration window size
+    AspirationResearch, // window failed, arg = new window size
+    TTClear,            // transposition table cleared
+    TimeBudget,         // time manager allotted search time, arg = ms
+    TimeAbort,          // search stopped by time check, arg = ms past the deadline
+    GenMoves,           // sampled
+    Evaluate,           // sampled
+    Quiesce,            // sampled
+    Count
+};
+
+#ifdef USE_TRACE
+
+// Only 1 out of every TRACE_SAMPLE_INTERVAL calls of a sampled (hot) function is timed
+static constexpr std::uint32_t TRACE_SAMPLE_INTERVAL = 1024;
+
+std::uint64_t TraceTimestampNS();
+void TraceInit();
+void TraceRecord(TraceEvent event, char phase, std::int64_t arg, std::uint64_t timestamp, std::uint64_t duration = 0);
+void TraceFlush();
+
+inline void TraceBegin(TraceEvent event, std::int64_t arg = 0) { TraceRecord(event, 'B', arg, TraceTimestampNS()); }
+inline void TraceEnd(TraceEvent event, std::int64_t arg = 0) { TraceRecord(event, 'E', arg, TraceTimestampNS()); }
+inline void TraceInstant(TraceEvent event, std::int64_t arg = 0) { TraceRecord(event, 'i', arg, TraceTimestampNS()); }
+
+struct TraceScope {
+    TraceEvent event;
+    TraceScope(TraceEvent event, std::int64_t arg = 0) : event(event) { TraceBegin(event, arg); }
+    ~TraceScope() { TraceEnd(event); }
+};
+
+// Times one in every TRACE_SAMPLE_INTERVAL calls and records it as a complete ('X') event
+template<TraceEvent event>
+struct TraceSample {
+    std::uint64_t start = 0;
+    TraceSample() {
+        thread_local std::uint32_t counter = 0;
+        if (++counter == TRACE_SAMPLE_INTERVAL) {
+            counter = 0;
+            start = TraceTimestampNS();
+        }
+    }
+    ~TraceSample() {
+        if (start) {
+            TraceRecord(event, 'X', 0, start, TraceTimestampNS() - start);
+        }
+    }
+};
+
+#define FARIS_TRACE_CONCAT_IMPL(a, b) a##b
+#define FARIS_TRACE_CONCAT(a, b) FARIS_TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(event, arg) TraceScope FARIS_TRACE_CONCAT(traceScope, __LINE__){event, arg}
+#define TRACE_SAMPLE(event) TraceSample<event> FARIS_TRACE_CONCAT(traceSample, __LINE__){}
+
+#else
+
+inline void TraceInit() {}
+inline void TraceFlush() {}
+inline void TraceBegin(TraceEvent, std::int64_t = 0) {}
+inline void TraceEnd(TraceEvent, std::int64_t = 0) {}
+inline void TraceInstant(TraceEvent, std::int64_t = 0) {}
+
+#define TRACE_SCOPE(event, arg) ((void)0)
+#define TRACE_SAMPLE(event) ((void)0)
+
+#endif
@@ -1,9 +1,12 @@
+#pragma once
+
 #include "board.h"
 #include "movegen.h"
 #include <array>
 #include <cstdint>
+#include <vector>
 
-enum ScoreType {
+enum ScoreType : std::uint8_t {
     Exact,
     LowerBound,
     UpperBound
@@ -11,27 +14,65 @@ enum ScoreType {
 
 struct TTEntry {
     std::uint64_t hash;
-    Move bestMove;
     int score;
+    Move bestMove;
+    std::int8_t depth;
     ScoreType scoreType;
-    int depth;
 };
+static_assert(sizeof(TTEntry) == 16);
+
+// SplitMix64, usable in constant expressions
+constexpr std::uint64_t SplitMix64(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+    std::uint64_t piece[64][6][2];
+    std::uint64_t blackToMove;
+    std::array<std::uint64_t, 16> castlingRights;
+    std::array<std::uint64_t, 8> enPassantFile;
+};
+
+static constexpr ZobristKeys GenZobristKeys(std::uint64_t seed) {
+    ZobristKeys keys{};
+    for (int i = 0; i < 64; i++) {
+        for (int j = 0; j < 6; j++) {
+            for (int k = 0; k < 2; k++) {
+                keys.piece[i][j][k] = SplitMix64(seed);
+            }
+        }
+    }
+    keys.blackToMove = SplitMix64(seed);
+    for (std::uint64_t& value : keys.castlingRights) {
+        value = SplitMix64(seed);
+    }
+    for (std::uint64_t& value : keys.enPassantFile) {
+        value = SplitMix64(seed);
+    }
+    return keys;
+}
+
+// Fixed at compile time so hashes, TT collisions and therefore node counts are the same in every run. Changing the
+// seed changes the bench signature.
+inline constexpr ZobristKeys ZOBRIST_KEYS = GenZobristKeys(0x46617269735A6F62);
 
 struct TT {
-    static constexpr int size = 10'000'000;
+    static constexpr std::size_t DEFAULT_SIZE = 10'000'000; // entries, 160 MB
 
     std::uint64_t hits = 0;
-    std::vector<TTEntry> table{size};
-    std::uint64_t pieceZobrist[64][6][2];
-    std::uint64_t blackToMoveZobrist;
-    std::array<std::uint64_t, 16> castlingRightsZobrist;
-    std::array<std::uint64_t, 8> enPassantFileZobrist;
+    std::size_t size;
+    std::vector<TTEntry> table;
     
     std::uint64_t Hash(const Board& board, Color colorToMove);
     const TTEntry* Search(const Board& board, Color colorToMove);
     const TTEntry* Search(std::uint64_t hash);
     void Add(const Board& board, Color colorToMove, int depth, int score, ScoreType scoreType, const Move& bestMove);
-    TT();
+    void Add(std::uint64_t hash, int depth, int score, ScoreType scoreType, const Move& bestMove);
+    void Clear();
+    explicit TT(std::size_t entryCount = DEFAULT_SIZE);
 };
 
 extern TT transpositionTable;
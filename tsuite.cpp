@@ -0,0 +1,240 @@
+#include "tsuite.h"
+#include "fen.h"
+#include "search.h"
+#include "transposition.h"
+#include "utilities.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TsuiteOptions {
+    std::string epdPath;
+    int moveTime = 0;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int hashMB = 64; // per worker
+};
+
+struct Problem {
+    std::string id;
+    Fen fen;
+    std::string bm; // as written, for the report
+    std::string am;
+    std::vector<Move> bestMoves;  // playing any of them solves the position
+    std::vector<Move> avoidMoves; // playing any of them fails it
+    std::string error;            // why the line can't be used, empty if it can
+
+    bool Correct(const Move& move) const {
+        return (bestMoves.empty() || std::find(bestMoves.begin(), bestMoves.end(), move) != bestMoves.end()) &&
+               std::find(avoidMoves.begin(), avoidMoves.end(), move) == avoidMoves.end();
+    }
+};
+
+struct Solution {
+    Move move{};
+    bool solved = false;
+    // From the first iteration after which the best move stayed correct
+    std::uint64_t timeMS = 0;
+    std::uint64_t nodes = 0;
+    int depth = 0;
+};
+
+// The moves of a bm or am operation, false with the offending move in error if one isn't legal in the position
+bool ParseMoves(const std::string& operands, const Problem& problem, std::vector<Move>& moves, std::string& error) {
+    std::istringstream stream{operands};
+    std::string san;
+    while (stream >> san) {
+        Move move = ParseSANMove(san, problem.fen.board, problem.fen.colorToMove);
+        if (move == Move{}) {
+            error = "'" + san + "' is not a legal move";
+            return false;
+        }
+        moves.push_back(move);
+    }
+    return true;
+}
+
+Problem ParseProblem(const std::string& line, std::size_t lineNumber) {
+    Problem problem;
+    problem.id = "line " + std::to_string(lineNumber);
+    try {
+        problem.fen = ParseFen(EpdToFen(line));
+    }
+    catch (const std::exception& error) {
+        problem.error = error.what();
+        return problem;
+    }
+    auto operations = EpdOperations(line);
+    if (auto id = operations.find("id"); id != operations.end() && !id->second.empty()) {
+        problem.id = id->second;
+    }
+    if (auto bm = operations.find("bm"); bm != operations.end()) {
+        problem.bm = bm->second;
+        if (!ParseMoves(bm->second, problem, problem.bestMoves, problem.error)) {
+            return problem;
+        }
+    }
+    if (auto am = operations.find("am"); am != operations.end()) {
+        problem.am = am->second;
+        if (!ParseMoves(am->second, problem, problem.avoidMoves, problem.error)) {
+            return problem;
+        }
+    }
+    if (problem.bestMoves.empty() && problem.avoidMoves.empty()) {
+        problem.error = "no bm or am operation";
+    }
+    return problem;
+}
+
+Solution Solve(const Problem& problem, const TsuiteOptions& options) {
+    searchTT->Clear();
+    searchHistory->Clear();
+    threefoldRepetitionTable.clear();
+    Solution solution;
+    bool correct = false;
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsedMS = [&] {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    };
+    SearchLimits limits{ .moveTime = options.moveTime };
+    limits.onIteration = [&](int depth) {
+        bool nowCorrect = !rootLines[0].pv.empty() && problem.Correct(rootLines[0].pv[0]);
+        if (nowCorrect && !correct) {
+            solution.timeMS = elapsedMS();
+            solution.nodes = searchNodes;
+            solution.depth = depth;
+        }
+        correct = nowCorrect;
+    };
+    solution.move = Search(problem.fen.board, problem.fen.colorToMove, limits, false);
+    solution.solved = problem.Correct(solution.move);
+    if (solution.solved && !correct) {
+        // Found without a completed iteration backing it
+        solution.timeMS = elapsedMS();
+        solution.nodes = searchNodes;
+        solution.depth = 0;
+    }
+    return solution;
+}
+
+bool ParseOptions(int argc, char** argv, TsuiteOptions& options) {
+    for (int i = 2; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--")) {
+            options.epdPath = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--movetime") {
+            options.moveTime = std::atoi(value);
+        }
+        else if (arg == "--threads") {
+            options.threads = std::max(1, std::atoi(value));
+        }
+        else if (arg == "--hash") {
+            options.hashMB = std::max(1, std::atoi(value));
+        }
+        else {
+            std::cerr << "Unknown tsuite option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.epdPath.empty() || options.moveTime <= 0) {
+        std::cerr << "Usage: faris-engine tsuite <file.epd> --movetime <ms> [--threads <t>] [--hash <MB>]" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int Tsuite(int argc, char** argv) {
+    TsuiteOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    std::ifstream epd{options.epdPath};
+    if (!epd) {
+        std::cerr << "Failed to open '" << options.epdPath << "'" << std::endl;
+        return 1;
+    }
+    std::vector<Problem> problems;
+    std::string line;
+    for (std::size_t lineNumber = 1; std::getline(epd, line); lineNumber++) {
+        if (line.find_first_not_of(" \t\r") != std::string::npos) {
+            problems.push_back(ParseProblem(line, lineNumber));
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t ttEntries = (std::size_t)options.hashMB * 1024 * 1024 / sizeof(TTEntry);
+    std::vector<Solution> solutions(problems.size());
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::min<int>(options.threads, (int)problems.size()); i++) {
+        workers.emplace_back([&] {
+            auto table = std::make_unique<TT>(ttEntries);
+            searchTT = table.get();
+            for (std::size_t index = next++; index < problems.size(); index = next++) {
+                if (problems[index].error.empty()) {
+                    solutions[index] = Solve(problems[index], options);
+                }
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int solved = 0;
+    int usable = 0;
+    std::uint64_t solvedTimeMS = 0;
+    std::uint64_t solvedNodes = 0;
+    for (std::size_t i = 0; i < problems.size(); i++) {
+        const Problem& problem = problems[i];
+        std::cout << std::setw(4) << i + 1 << "  " << std::left << std::setw(14) << problem.id << std::right;
+        if (!problem.error.empty()) {
+            std::cout << "skipped: " << problem.error << "\n";
+            continue;
+        }
+        usable++;
+        const Solution& solution = solutions[i];
+        std::string expected = !problem.bm.empty() ? "bm " + problem.bm : "";
+        expected += !problem.am.empty() ? (expected.empty() ? "am " : ", am ") + problem.am : "";
+        std::string played = solution.move == Move{} ? "-" : MoveToSAN(solution.move, problem.fen.board, problem.fen.colorToMove);
+        std::cout << (solution.solved ? "solved  " : "failed  ") << std::left << std::setw(8) << played << std::right;
+        if (solution.solved) {
+            solved++;
+            solvedTimeMS += solution.timeMS;
+            solvedNodes += solution.nodes;
+            std::cout << " time " << std::setw(7) << solution.timeMS << " ms  nodes " << std::setw(10) << solution.nodes
+                      << "  depth " << std::setw(2) << solution.depth << "  (" << expected << ")\n";
+        }
+        else {
+            std::cout << " (" << expected << ")\n";
+        }
+    }
+    std::cout << "Solved " << solved << " of " << usable << " in " << std::fixed << std::setprecision(1) << seconds
+              << " s, to solution " << solvedTimeMS << " ms and " << solvedNodes << " nodes over the solved positions"
+              << std::endl;
+    return 0;
+}
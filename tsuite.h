@@ -0,0 +1,8 @@
+#pragma once
+
+// faris-engine tsuite <file.epd> --movetime <ms> [--threads <t>] [--hash <MB>]
+// Runs a tactical test suite: searches every EPD position for movetime and checks the best move against the
+// position's bm (best move) and am (avoid move) operations, written in SAN. Prints per position whether it was
+// solved and the time, nodes and depth from which the best move stayed correct, then the totals. Positions are
+// spread over worker threads, one core each gives comparable times. Returns the process exit code.
+int Tsuite(int argc, char** argv);
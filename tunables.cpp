@@ -0,0 +1,37 @@
+#include "tunables.h"
+#include "board.h"
+#include "eval_params.h"
+#include <algorithm>
+
+namespace {
+
+#ifdef USE_TUNING
+#define FARIS_REGISTER_TUNABLE(variable, uciName, defaultValue, min, max) { uciName, &variable, defaultValue, min, max },
+const Tunable tunables[] = {
+    FARIS_TUNABLES(FARIS_REGISTER_TUNABLE)
+    { "PawnValue", &pieceValues[(int)PieceType::Pawn], pieceValues[(int)PieceType::Pawn], 50, 200 },
+    { "KnightValue", &pieceValues[(int)PieceType::Knight], pieceValues[(int)PieceType::Knight], 150, 600 },
+    { "BishopValue", &pieceValues[(int)PieceType::Bishop], pieceValues[(int)PieceType::Bishop], 150, 600 },
+    { "RookValue", &pieceValues[(int)PieceType::Rook], pieceValues[(int)PieceType::Rook], 250, 1000 },
+    { "QueenValue", &pieceValues[(int)PieceType::Queen], pieceValues[(int)PieceType::Queen], 500, 1800 },
+};
+#undef FARIS_REGISTER_TUNABLE
+#else
+const std::span<const Tunable> tunables;
+#endif
+
+}
+
+std::span<const Tunable> Tunables() {
+    return tunables;
+}
+
+bool SetTunable(std::string_view name, int value) {
+    for (const Tunable& tunable : Tunables()) {
+        if (name == tunable.name) {
+            *tunable.value = std::clamp(value, tunable.min, tunable.max);
+            return true;
+        }
+    }
+    return false;
+}
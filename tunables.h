@@ -0,0 +1,51 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+// Search constants an SPSA tuner may move, each with the range it is allowed to move in. Normal builds see them as
+// constexpr values; with FARIS_ENABLE_TUNING (USE_TUNING) they are plain globals, listed by the uci command as spin
+// options of the same name and written by setoption, so a tuner can drive them over UCI. The piece values in
+// eval_params.h are declared with TUNABLE as well and registered in tunables.cpp.
+#ifdef USE_TUNING
+#define TUNABLE inline
+#else
+#define TUNABLE inline constexpr
+#endif
+
+//  variable                 UCI name                  default   min     max
+#define FARIS_TUNABLES(X) \
+    X(nullMoveMinDepth,       "NullMoveMinDepth",       4,        2,      8)      \
+    X(nullMoveReduction,      "NullMoveReduction",      2,        1,      4)      \
+    X(nullMoveDeepReduction,  "NullMoveDeepReduction",  3,        1,      5)      \
+    X(nullMoveDeepDepth,      "NullMoveDeepDepth",      7,        4,      12)     \
+    X(iirMinDepth,            "IirMinDepth",            3,        2,      12)     \
+    X(singularMinDepth,       "SingularMinDepth",       6,        4,      12)     \
+    X(singularMarginPerDepth, "SingularMarginPerDepth", 2,        0,      16)     \
+    X(aspirationDelta,        "AspirationDelta",        50,       5,      300)    \
+    X(nodeCheckInterval,      "NodeCheckInterval",      4096,     256,    65536)  \
+    X(quiesceMaxDepth,        "QuiesceMaxDepth",        8,        1,      32)     \
+    X(timeDivisor,            "TimeDivisor",            20,       5,      60)     \
+    X(incrementPercent,       "IncrementPercent",       50,       0,      100)    \
+    X(killerScore1,           "KillerScore1",           9000,     0,      9999)   \
+    X(killerScore2,           "KillerScore2",           8000,     0,      9999)   \
+    X(counterMoveScore,       "CounterMoveScore",       7000,     0,      9999)   \
+    X(historyBonusScale,      "HistoryBonusScale",      32,       1,      64)     \
+    X(historyBonusMax,        "HistoryBonusMax",        2048,     64,     8192)
+
+#define FARIS_DECLARE_TUNABLE(variable, uciName, defaultValue, min, max) TUNABLE int variable = defaultValue;
+FARIS_TUNABLES(FARIS_DECLARE_TUNABLE)
+#undef FARIS_DECLARE_TUNABLE
+
+struct Tunable {
+    const char* name;
+    int* value;
+    int defaultValue;
+    int min;
+    int max;
+};
+
+// Every tunable in a USE_TUNING build, nothing otherwise
+std::span<const Tunable> Tunables();
+// Sets the named tunable to value clamped to its range, false if there is no tunable by that name
+bool SetTunable(std::string_view name, int value);
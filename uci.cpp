@@ -1,95 +1,213 @@
 #include "uci.h"
+#include "attack_bitboards.h"
 #include "board.h"
+#include "book.h"
+#include "cpu.h"
 #include "fen.h"
 #include "movegen.h"
 #include "search.h"
+#include "tablebase.h"
 #include "transposition.h"
+#include "tunables.h"
 #include "utilities.h"
-#include <cassert>
+#include <algorithm>
+#include <charconv>
 #include <iostream>
-#include <sstream>
 #include <string>
-#include <vector>
+#include <string_view>
 
-static std::string MoveToUCINotation(const Move& move) {
-    std::string uciMove;
-    uciMove += (move.from % 8) + 'a';
-    uciMove += (move.from / 8) + '1';
-    uciMove += (move.to % 8) + 'a';
-    uciMove += (move.to / 8) + '1';
-    switch (move.promotionType) {
-        case PieceType::Queen:
-            uciMove += 'q';
-            break;
-        case PieceType::Rook:
-            uciMove += 'r';
-            break;
-        case PieceType::Bishop:
-            uciMove += 'b';
-            break;
-        case PieceType::Knight:
-            uciMove += 'n';
-            break;
-        default:
-            break;
+namespace {
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Splits a command into whitespace separated tokens as views into the line, nothing is copied
+struct Tokenizer {
+    std::string_view rest;
+
+    // Empty once the line is used up
+    std::string_view Next() {
+        std::size_t begin = 0;
+        while (begin < rest.size() && IsSpace(rest[begin])) {
+            begin++;
+        }
+        std::size_t end = begin;
+        while (end < rest.size() && !IsSpace(rest[end])) {
+            end++;
+        }
+        std::string_view token = rest.substr(begin, end - begin);
+        rest.remove_prefix(end);
+        return token;
+    }
+
+    // Everything not consumed yet without surrounding whitespace, for values that may contain spaces
+    std::string_view Rest() {
+        while (!rest.empty() && IsSpace(rest.front())) {
+            rest.remove_prefix(1);
+        }
+        while (!rest.empty() && IsSpace(rest.back())) {
+            rest.remove_suffix(1);
+        }
+        return rest;
+    }
+};
+
+template<typename T = int>
+T ParseInt(std::string_view text) {
+    T value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+}
+
+void SetPosition(UCIState& state, std::string_view command) {
+    command = Tokenizer{command}.Rest();
+    const std::string& last = state.lastPosition;
+    std::string_view newMoves;
+    if (!last.empty() && command.starts_with(last) && (command.size() == last.size() || command[last.size()] == ' ')) {
+        newMoves = command.substr(last.size());
+    }
+    else {
+        threefoldRepetitionTable.clear();
+        Tokenizer tokens{command};
+        tokens.Next(); // "position"
+        std::string_view type = tokens.Next();
+        std::string_view rest = tokens.Rest();
+        if (type == "fen") {
+            std::size_t movesStart = rest.find("moves");
+            Fen fen = ParseFen(std::string(rest.substr(0, movesStart)));
+            state.board = fen.board;
+            state.colorToMove = fen.colorToMove;
+            newMoves = movesStart == std::string_view::npos ? std::string_view{} : rest.substr(movesStart);
+        }
+        else {
+            state.board = Board();
+            state.colorToMove = White;
+            newMoves = rest;
+        }
+        state.hash = transpositionTable.Hash(state.board, state.colorToMove);
+        threefoldRepetitionTable[state.hash]++;
+    }
+    Tokenizer tokens{newMoves};
+    for (std::string_view token = tokens.Next(); !token.empty(); token = tokens.Next()) {
+        if (token == "moves") {
+            continue;
+        }
+        // Only the moves new to this command are checked, so generating them all stays cheap
+        Move move = ParseUCIMove(token, state.board);
+        MoveList legalMoves = GenMoves(state.board, state.colorToMove);
+        if (std::find(legalMoves.begin(), legalMoves.end(), move) == legalMoves.end()) {
+            std::cerr << "Illegal move '" << token << "' in position command" << std::endl;
+            // The board doesn't match the command, so the next one can't build on it
+            state.lastPosition.clear();
+            return;
+        }
+        MakeMove(move, state.board, state.colorToMove, state.hash);
+        threefoldRepetitionTable[state.hash]++;
+        state.colorToMove = ToggleColor(state.colorToMove);
+    }
+    state.lastPosition.assign(command);
+}
+
+void SetOption(UCIState& state, std::string_view command) {
+    // "setoption name <name> [value <value>]", names may have several words and values (paths) spaces
+    Tokenizer tokens{command};
+    tokens.Next(); // "setoption"
+    tokens.Next(); // "name"
+    std::string_view name = tokens.Rest();
+    std::string_view value;
+    std::size_t valueStart = name.find(" value ");
+    if (valueStart != std::string_view::npos) {
+        value = Tokenizer{name.substr(valueStart + 7)}.Rest();
+        name = name.substr(0, valueStart);
+    }
+    if (name == "UseNewFeature") {
+        state.useNewFeature = value == "true";
+    }
+    else if (name == "SliderAttacks") {
+        SliderAttackImpl impl = value == "Pext"  ? SliderAttackImpl::Pext
+                              : value == "Magic" ? SliderAttackImpl::Magic
+                                                 : DefaultSliderAttackImpl();
+        if (!SetSliderAttackImpl(impl)) {
+            std::cout << "info string slider attacks " << value << " not supported on this CPU/build" << std::endl;
+        }
+        std::cout << "info string slider attacks " << SliderAttackImplName(GetSliderAttackImpl()) << std::endl;
+    }
+    else if (name == "SetwiseAttacks") {
+        SetwiseAttackImpl impl = value == "Avx2"   ? SetwiseAttackImpl::Avx2
+                               : value == "Scalar" ? SetwiseAttackImpl::Scalar
+                                                   : DefaultSetwiseAttackImpl();
+        if (!SetSetwiseAttackImpl(impl)) {
+            std::cout << "info string setwise attacks " << value << " not supported on this CPU/build" << std::endl;
+        }
+        std::cout << "info string setwise attacks " << SetwiseAttackImplName(GetSetwiseAttackImpl()) << std::endl;
+    }
+    else if (name == "SyzygyPath") {
+        int count = LoadTablebases(value == "<empty>" ? "" : std::string(value));
+        std::cout << "info string tablebases loaded " << count << ", max pieces " << TablebaseMaxPieces() << std::endl;
+    }
+    else if (name == "BookFile") {
+        if (value.empty() || value == "<empty>") {
+            openingBook.Close();
+        }
+        else if (openingBook.Open(std::string(value))) {
+            std::cout << "info string book " << value << std::endl;
+        }
+    }
+    else if (name == "MultiPV") {
+        state.multiPV = std::clamp(ParseInt(value), 1, 64);
+    }
+    else if (name == "OwnBook") {
+        state.ownBook = value == "true";
+    }
+    else if (!SetTunable(name, ParseInt(value))) {
+        std::cout << "info string unknown option " << name << std::endl;
     }
-    return uciMove;
 }
 
 void ProcessInput() {
     UCIState state;
-    while (true) {
-        std::string line;
-        std::getline(std::cin, line);
-        std::stringstream ss{line};
-        std::string token;
-        ss >> token;
+    // Reused for every command so reading a line doesn't allocate once it has grown to the longest command
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        Tokenizer tokens{line};
+        std::string_view token = tokens.Next();
         if (token == "position") {
-            threefoldRepetitionTable.clear();
-            ss >> token;
-            state.colorToMove = White;
-            if (token == "fen") {
-                std::string fenString;
-                while (ss >> token && token != "moves") {
-                    fenString += token + ' ';
+            SetPosition(state, line);
+        }
+        else if (token == "go") {
+            state.wtime = state.btime = state.winc = state.binc = state.depth = state.moveTime = 0;
+            state.nodes = 0;
+            for (std::string_view key = tokens.Next(); !key.empty(); key = tokens.Next()) {
+                if (key == "wtime") {
+                    state.wtime = ParseInt(tokens.Next());
                 }
-                Fen fen = ParseFen(fenString);
-                state.board = fen.board;
-                state.colorToMove = fen.colorToMove;
-            }
-            else {
-                state.board = Board();
-                ss >> token; // skip "startpos" token
-            }
-            std::uint64_t hash = transpositionTable.Hash(state.board, state.colorToMove);
-            threefoldRepetitionTable[hash]++;
-            if (token == "moves") {
-                while (ss >> token) {
-                    std::vector<Move> moves = GenMoves(state.board, state.colorToMove);
-                    for (const Move& move : moves) {
-                        if (MoveToUCINotation(move) == token) {
-                            MakeMove(move, state.board, state.colorToMove, hash);
-                            threefoldRepetitionTable[hash]++;
-                            state.colorToMove = ToggleColor(state.colorToMove);
-                            break;
-                        }
-                    }
+                else if (key == "btime") {
+                    state.btime = ParseInt(tokens.Next());
+                }
+                else if (key == "winc") {
+                    state.winc = ParseInt(tokens.Next());
+                }
+                else if (key == "binc") {
+                    state.binc = ParseInt(tokens.Next());
+                }
+                else if (key == "depth") {
+                    state.depth = ParseInt(tokens.Next());
+                }
+                else if (key == "movetime") {
+                    state.moveTime = ParseInt(tokens.Next());
+                }
+                else if (key == "nodes") {
+                    state.nodes = ParseInt<std::uint64_t>(tokens.Next());
                 }
             }
-        }
-        else if (token == "go") {
-            ss >> token;
-            assert(token == "wtime");
-            ss >> state.wtime;
-            ss >> token;
-            assert(token == "btime");
-            ss >> state.btime;
-            ss >> token;
-            assert(token == "winc");
-            ss >> state.winc;
-            ss >> token;
-            assert(token == "binc");
-            ss >> state.binc;
+            Move bookMove;
+            if (state.ownBook && openingBook.Probe(state.board, state.colorToMove, bookMove)) {
+                std::cout << "bestmove " << MoveToUCINotation(bookMove) << std::endl;
+                continue;
+            }
             std::cerr << "Computing...\n";
             int time, inc;
             if (state.colorToMove == White) {
@@ -106,16 +224,37 @@ void ProcessInput() {
             else {
                 std::cerr << "Not using new feature\n";
             }
-            Move move = Search(state.board, state.colorToMove, time, inc, state.useNewFeature);
+            SearchLimits limits{ .time = time, .inc = inc, .moveTime = state.moveTime, .depth = state.depth,
+                                 .multiPV = state.multiPV, .nodes = state.nodes, .printInfo = true };
+            Move move = Search(state.board, state.colorToMove, limits, state.useNewFeature);
             // TODO: implement ponder
             std::cout << "bestmove " << MoveToUCINotation(move) << std::endl;
         }
         else if (token == "uci") {
-            std::cout << "id name Faris\nid author Zaid Al-ruwaishan\noption name UseNewFeature type check default false\nuciok" << std::endl;
+            const CpuFeatures& cpu = GetCpuFeatures();
+            std::cout << "id name Faris\nid author Zaid Al-ruwaishan\n"
+                      << "option name UseNewFeature type check default false\n"
+                      << "option name SliderAttacks type combo default Auto var Auto var Magic var Pext\n"
+                      << "option name SetwiseAttacks type combo default Auto var Auto var Scalar var Avx2\n"
+                      << "option name SyzygyPath type string default <empty>\n"
+                      << "option name OwnBook type check default false\n"
+                      << "option name BookFile type string default <empty>\n"
+                      << "option name MultiPV type spin default 1 min 1 max 64\n";
+            for (const Tunable& tunable : Tunables()) {
+                std::cout << "option name " << tunable.name << " type spin default " << tunable.defaultValue << " min "
+                          << tunable.min << " max " << tunable.max << "\n";
+            }
+            std::cout << "info string cpu bmi2 " << cpu.bmi2 << " fastpext " << cpu.fastPext << " avx2 " << cpu.avx2
+                      << ", slider attacks " << SliderAttackImplName(GetSliderAttackImpl())
+                      << ", setwise attacks " << SetwiseAttackImplName(GetSetwiseAttackImpl()) << "\n"
+                      << "uciok" << std::endl;
         }
         else if (token == "ucinewgame") {
             std::cerr << "Recieved ucinewgame... clearing table" << std::endl;
             threefoldRepetitionTable.clear();
+            state.lastPosition.clear();
+            transpositionTable.Clear();
+            searchHistory->Clear();
             std::cerr << "Table cleared" << std::endl;
             // Not much to do here at this point...
         }
@@ -123,8 +262,7 @@ void ProcessInput() {
             std::cout << "readyok" << std::endl;
         }
         else if (token == "setoption") {
-            // For now there is only one option so assuming this is only provided to enable new feature
-            state.useNewFeature = true;
+            SetOption(state, line);
         }
         else if (token == "quit") {
             return;
@@ -1,13 +1,30 @@
+#pragma once
+
 #include "board.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
 
 struct UCIState {
     Board board;
     Color colorToMove = White;
-    int wtime;
-    int btime;
+    std::uint64_t hash = 0; // TT::Hash of board
+    std::string lastPosition; // previous position command, later ones usually extend it by a move or two
+    int wtime = 0;
+    int btime = 0;
     int winc = 0;
     int binc = 0;
+    int depth = 0;
+    int moveTime = 0;
+    std::uint64_t nodes = 0;
+    int multiPV = 1;
     bool useNewFeature = false;
+    bool ownBook = false; // play from openingBook while it has the position
 };
 
+// Handles "position [startpos | fen <fen>] [moves <move>...]". When the command extends the previous one, as it does
+// on every move of a game, only the new moves are played, so the cost doesn't grow with the length of the game.
+void SetPosition(UCIState& state, std::string_view command);
+// Handles "setoption name <name> [value <value>]"; names that aren't options of their own go to the tunables
+void SetOption(UCIState& state, std::string_view command);
 void ProcessInput();
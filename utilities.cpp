@@ -2,7 +2,203 @@
 #include "attack_bitboards.h"
 #include "board.h"
 #include "transposition.h"
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <string_view>
+
+std::string MoveToUCINotation(const Move& move) {
+    std::string uciMove;
+    uciMove += (move.From() % 8) + 'a';
+    uciMove += (move.From() / 8) + '1';
+    uciMove += (move.To() % 8) + 'a';
+    uciMove += (move.To() / 8) + '1';
+    switch (move.PromotionType()) {
+        case PieceType::Queen:
+            uciMove += 'q';
+            break;
+        case PieceType::Rook:
+            uciMove += 'r';
+            break;
+        case PieceType::Bishop:
+            uciMove += 'b';
+            break;
+        case PieceType::Knight:
+            uciMove += 'n';
+            break;
+        default:
+            break;
+    }
+    return uciMove;
+}
+
+Move ParseUCIMove(std::string_view uciMove, const Board& board) {
+    if (uciMove.size() < 4 || uciMove.size() > 5) {
+        return Move{};
+    }
+    for (int i = 0; i < 4; i += 2) {
+        if (uciMove[i] < 'a' || uciMove[i] > 'h' || uciMove[i + 1] < '1' || uciMove[i + 1] > '8') {
+            return Move{};
+        }
+    }
+    Square from = (uciMove[0] - 'a') + 8 * (uciMove[1] - '1');
+    Square to = (uciMove[2] - 'a') + 8 * (uciMove[3] - '1');
+    PieceType type = board.PieceTypeAt(from);
+    if (type == PieceType::None) {
+        return Move{};
+    }
+    if (uciMove.size() == 5) {
+        switch (uciMove[4]) {
+            case 'q':
+                return Move(from, to, Move::Promotion, PieceType::Queen);
+            case 'r':
+                return Move(from, to, Move::Promotion, PieceType::Rook);
+            case 'b':
+                return Move(from, to, Move::Promotion, PieceType::Bishop);
+            case 'n':
+                return Move(from, to, Move::Promotion, PieceType::Knight);
+            default:
+                return Move{};
+        }
+    }
+    if (type == PieceType::King && std::abs(from - to) == 2) {
+        return Move(from, to, Move::Castling);
+    }
+    if (type == PieceType::Pawn && to == board.enPassant) {
+        return Move(from, to, Move::EnPassant);
+    }
+    return Move(from, to);
+}
+
+namespace {
+
+constexpr char SAN_PIECE_LETTERS[] = "PNBRQK";
+
+std::string SquareName(Square square) {
+    return { char('a' + square % 8), char('1' + square / 8) };
+}
+
+}
+
+std::string MoveToSAN(const Move& move, const Board& board, Color colorToMove) {
+    std::string san;
+    const PieceType type = board.PieceTypeAt(move.From());
+    if (move.Type() == Move::Castling) {
+        san = move.To() % 8 == 6 ? "O-O" : "O-O-O";
+    }
+    else {
+        const bool capture = move.Type() == Move::EnPassant || board.PieceTypeAt(move.To()) != PieceType::None;
+        if (type == PieceType::Pawn) {
+            if (capture) {
+                san += char('a' + move.From() % 8);
+            }
+        }
+        else {
+            san += SAN_PIECE_LETTERS[(int)type];
+            // Name the from file if that tells the pieces that can reach the square apart, else the rank, else both
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (const Move& other : GenMoves(board, colorToMove)) {
+                if (other.To() == move.To() && other.From() != move.From() && board.PieceTypeAt(other.From()) == type) {
+                    ambiguous = true;
+                    sameFile |= other.From() % 8 == move.From() % 8;
+                    sameRank |= other.From() / 8 == move.From() / 8;
+                }
+            }
+            if (ambiguous && (!sameFile || sameRank)) {
+                san += char('a' + move.From() % 8);
+            }
+            if (ambiguous && sameFile) {
+                san += char('1' + move.From() / 8);
+            }
+        }
+        if (capture) {
+            san += 'x';
+        }
+        san += SquareName(move.To());
+        if (move.Type() == Move::Promotion) {
+            san += '=';
+            san += SAN_PIECE_LETTERS[(int)move.PromotionType()];
+        }
+    }
+    Board child = board;
+    MakeMove(move, child, colorToMove);
+    const Color opponent = ToggleColor(colorToMove);
+    if (InCheck(child, opponent)) {
+        san += GenMoves(child, opponent).empty() ? '#' : '+';
+    }
+    return san;
+}
+
+Move ParseSANMove(std::string_view san, const Board& board, Color colorToMove) {
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+    const MoveList moves = GenMoves(board, colorToMove);
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        const int toFile = san.size() == 3 ? 6 : 2;
+        for (const Move& move : moves) {
+            if (move.Type() == Move::Castling && move.To() % 8 == toFile) {
+                return move;
+            }
+        }
+        return Move{};
+    }
+    // [piece] [from file] [from rank] [x] to [=promotion]
+    PieceType type = PieceType::Pawn;
+    if (!san.empty() && san.front() >= 'B' && san.front() <= 'R') {
+        const char* letter = std::char_traits<char>::find(SAN_PIECE_LETTERS + 1, 5, san.front());
+        if (!letter) {
+            return Move{};
+        }
+        type = PieceType(letter - SAN_PIECE_LETTERS);
+        san.remove_prefix(1);
+    }
+    PieceType promotionType = PieceType::None;
+    if (!san.empty() && san.back() >= 'B' && san.back() <= 'R') {
+        const char* letter = std::char_traits<char>::find(SAN_PIECE_LETTERS + 1, 4, san.back());
+        if (!letter) {
+            return Move{};
+        }
+        promotionType = PieceType(letter - SAN_PIECE_LETTERS);
+        san.remove_suffix(1);
+        if (!san.empty() && san.back() == '=') {
+            san.remove_suffix(1);
+        }
+    }
+    if (san.size() < 2) {
+        return Move{};
+    }
+    const char toFile = san[san.size() - 2];
+    const char toRank = san[san.size() - 1];
+    if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') {
+        return Move{};
+    }
+    const Square to = (toFile - 'a') + 8 * (toRank - '1');
+    int fromFile = -1;
+    int fromRank = -1;
+    for (char c : san.substr(0, san.size() - 2)) {
+        if (c >= 'a' && c <= 'h') {
+            fromFile = c - 'a';
+        }
+        else if (c >= '1' && c <= '8') {
+            fromRank = c - '1';
+        }
+        else if (c != 'x') {
+            return Move{};
+        }
+    }
+    Move match{};
+    int matches = 0;
+    for (const Move& move : moves) {
+        if (move.To() == to && move.Type() != Move::Castling && board.PieceTypeAt(move.From()) == type &&
+            move.PromotionType() == promotionType && (fromFile < 0 || move.From() % 8 == fromFile) &&
+            (fromRank < 0 || move.From() / 8 == fromRank)) {
+            match = move;
+            matches++;
+        }
+    }
+    return matches == 1 ? match : Move{};
+}
 
 void PrettyPrint(Bitboard bb) {
     for (int rank = 7; rank >= 0; rank--) {
@@ -40,176 +236,132 @@ void PrettyPrint(const Board& board) {
 }
 
 Piece PieceAt(int squareIndex, const Board &board) {
-    Bitboard squareIndexBB = (Bitboard)1 << squareIndex;
-    for (int i = 0; i < COUNT_BITBOARDS; i++) {
-        if (squareIndexBB & board.bitboards[i]) {
-            return i < 6 ? Piece{PieceType(i), Color::White} : Piece{PieceType(i - 6), Color::Black};
-        }
-    }
-    return {PieceType::None};
+    return board.PieceAt(squareIndex);
 }
 
 PieceType PieceTypeAt(Square square, const Board& board) {
-    Bitboard squareBB = ToBitboard(square);
-    for (int i = 0; i < COUNT_BITBOARDS; i++) {
-        if (squareBB & board.bitboards[i]) {
-            return i < 6 ? PieceType(i) : PieceType(i - 6);
-        }
-    }
-    return PieceType::None;
+    return board.PieceTypeAt(square);
+}
+
+PieceType PieceTypeAt(Square square, const Board& board, Color color) {
+    Piece piece = board.PieceAt(square);
+    return piece.color == color ? piece.type : PieceType::None;
 }
 
 // TODO: move to Board, or move all these low-level methods that operate on Board to a different file
-PieceType RemovePiece(Square square, Board& board, Color color) {
-    Bitboard squareBB = ToBitboard(square);
-    PieceType removedPieceType = PieceType::None;
-    for (int i = 0; i < 6; i++) {
-        if (squareBB & board.bitboards2D[color][i]) {
-            board.bitboards2D[color][i] &= ~squareBB;
-            removedPieceType = PieceType(i);
-            break;
-        }
-    }
-    assert(removedPieceType != PieceType::None);
+template<Color color>
+PieceType RemovePiece(Square square, Board& board) {
+    PieceType removedPieceType = board.PieceTypeAt(square);
+    assert(removedPieceType != PieceType::None && board.PieceAt(square).color == color);
+    board.RemovePiece(removedPieceType, color, square);
     return removedPieceType;
 }
 
-void MakeMove(const Move &move, Board &board, Color moveColor) {
-    board.Move(move.type, moveColor, move.from, move.to);
-    Color oppColor = ToggleColor(moveColor);
-    Bitboard toBB = ToBitboard(move.to);
-    if (move.capturedPieceType != PieceType::None) {
-        if (board.enPassant && move.to == board.enPassant) {
-            assert(move.capturedPieceType == PieceType::Pawn);
-            constexpr int enPassantOffset[2] = { -8, 8 };
-            Square epPawnSquare = move.to + enPassantOffset[moveColor];
-            board.bitboards2D[oppColor][(int)move.capturedPieceType] &= ~ToBitboard(epPawnSquare);
-        }
-        else {
-            board.bitboards2D[oppColor][(int)move.capturedPieceType] &= ~toBB;
+template<Color moveColor, bool updateHash>
+static UndoInfo MakeMoveImpl(const Move &move, Board &board, std::uint64_t& boardHash) {
+    constexpr Color oppColor = ToggleColor(moveColor);
+    constexpr int pawnDirection = moveColor == White ? 8 : -8;
+    const Square from = move.From();
+    const Square to = move.To();
+    UndoInfo undo{ .capturedPieceType = PieceType::None, .enPassant = board.enPassant, .castlingRights = board.castlingRights };
+
+    if (move.Type() == Move::EnPassant) {
+        Square capturedPawnSquare = to - pawnDirection;
+        undo.capturedPieceType = PieceType::Pawn;
+        board.RemovePiece(PieceType::Pawn, oppColor, capturedPawnSquare);
+        if constexpr (updateHash) {
+            boardHash ^= ZOBRIST_KEYS.piece[capturedPawnSquare][(int)PieceType::Pawn][oppColor];
         }
     }
-    if (move.promotionType != PieceType::None) {
-        board.PromotePawn(move.promotionType, moveColor, move.to);
-    }
-    if (move.type == PieceType::King && move.from == STARTING_KING_SQUARE[moveColor] ) {
-        if (move.to == move.from + 2) { // short castle
-            board.Move(PieceType::Rook, moveColor, move.from + 3, move.from + 1);
-        }
-        else if (move.to == move.from - 2) { // long castle
-            board.Move(PieceType::Rook, moveColor, move.from - 4, move.from - 1);
+    else {
+        undo.capturedPieceType = board.PieceTypeAt(to);
+        if (undo.capturedPieceType != PieceType::None) {
+            board.RemovePiece(undo.capturedPieceType, oppColor, to);
+            if constexpr (updateHash) {
+                boardHash ^= ZOBRIST_KEYS.piece[to][(int)undo.capturedPieceType][oppColor];
+            }
         }
     }
-    board.enPassant += move.enPassantDelta;
-    board.shortCastlingRight[moveColor] = board.shortCastlingRight[moveColor] && !(move.flags & Move::RemovesShortCastlingRight);
-    board.longCastlingRight[moveColor] = board.longCastlingRight[moveColor] && !(move.flags & Move::RemovesLongCastlingRight);
-    board.shortCastlingRight[oppColor] = board.shortCastlingRight[oppColor] && !(move.flags & Move::RemovesOppShortCastlingRight);
-    board.longCastlingRight[oppColor] = board.longCastlingRight[oppColor] && !(move.flags & Move::RemovesOppLongCastlingRight);
-}
 
-void MakeMove(const Move &move, Board &board, Color moveColor, std::uint64_t& boardHash) {
-    boardHash ^= transpositionTable.blackToMoveZobrist; // color always toggled
-    boardHash ^= transpositionTable.pieceZobrist[move.from][(int)move.type][moveColor]; // remove moving piece from old square
-    if (board.enPassant != -1) {
-        boardHash ^= transpositionTable.enPassantFileZobrist[board.enPassant & 0x7];
+    const PieceType type = board.PieceTypeAt(from);
+    board.Move(type, moveColor, from, to);
+    const PieceType typeOnArrival = move.Type() == Move::Promotion ? move.PromotionType() : type;
+    if (move.Type() == Move::Promotion) {
+        board.PromotePawn(typeOnArrival, moveColor, to);
     }
-    Square newEPSquare = board.enPassant + move.enPassantDelta;
-    if (newEPSquare != -1) {
-        boardHash ^= transpositionTable.enPassantFileZobrist[newEPSquare & 0x7];
+    else if (move.Type() == Move::Castling) {
+        Square rookFrom = to > from ? from + 3 : from - 4;
+        Square rookTo = to > from ? from + 1 : from - 1;
+        board.Move(PieceType::Rook, moveColor, rookFrom, rookTo);
+        if constexpr (updateHash) {
+            boardHash ^= ZOBRIST_KEYS.piece[rookFrom][(int)PieceType::Rook][moveColor];
+            boardHash ^= ZOBRIST_KEYS.piece[rookTo][(int)PieceType::Rook][moveColor];
+        }
     }
-    Color oppColor = ToggleColor(moveColor);
 
-    board.Move(move.type, moveColor, move.from, move.to);
-    Bitboard toBB = ToBitboard(move.to);
-    if (move.capturedPieceType != PieceType::None) {
-        if (move.type == PieceType::Pawn && board.enPassant != -1 && move.to == board.enPassant) {
-            assert(move.capturedPieceType == PieceType::Pawn);
-            constexpr int enPassantOffset[2] = { -8, 8 };
-            Square capturedPawnSquare = move.to + enPassantOffset[moveColor];
-            board.bitboards2D[oppColor][(int)move.capturedPieceType] &= ~ToBitboard(capturedPawnSquare);
-            boardHash ^= transpositionTable.pieceZobrist[capturedPawnSquare][(int)move.capturedPieceType][oppColor]; 
+    board.enPassant = type == PieceType::Pawn && (to - from == 2 * pawnDirection) ? from + pawnDirection : -1;
+    board.castlingRights &= CASTLING_RIGHTS_MASK[from] & CASTLING_RIGHTS_MASK[to];
+
+    if constexpr (updateHash) {
+        boardHash ^= ZOBRIST_KEYS.blackToMove; // color always toggled
+        boardHash ^= ZOBRIST_KEYS.piece[from][(int)type][moveColor];
+        boardHash ^= ZOBRIST_KEYS.piece[to][(int)typeOnArrival][moveColor];
+        if (undo.enPassant != -1) {
+            boardHash ^= ZOBRIST_KEYS.enPassantFile[undo.enPassant & 0x7];
         }
-        else {
-            board.bitboards2D[oppColor][(int)move.capturedPieceType] &= ~toBB;
-            boardHash ^= transpositionTable.pieceZobrist[move.to][(int)move.capturedPieceType][oppColor]; 
+        if (board.enPassant != -1) {
+            boardHash ^= ZOBRIST_KEYS.enPassantFile[board.enPassant & 0x7];
         }
+        boardHash ^= ZOBRIST_KEYS.castlingRights[undo.castlingRights];
+        boardHash ^= ZOBRIST_KEYS.castlingRights[board.castlingRights];
     }
-    if (move.promotionType != PieceType::None) {
-        board.PromotePawn(move.promotionType, moveColor, move.to);
-        boardHash ^= transpositionTable.pieceZobrist[move.to][(int)move.promotionType][moveColor];
+    return undo;
+}
+
+template<Color moveColor>
+UndoInfo MakeMove(const Move &move, Board &board) {
+    std::uint64_t unusedHash = 0;
+    return MakeMoveImpl<moveColor, false>(move, board, unusedHash);
+}
+
+template<Color moveColor>
+UndoInfo MakeMove(const Move &move, Board &board, std::uint64_t& boardHash) {
+    return MakeMoveImpl<moveColor, true>(move, board, boardHash);
+}
+
+template<Color moveColor>
+void UndoMove(const Move &move, Board &board, const UndoInfo& undo) {
+    constexpr Color oppColor = ToggleColor(moveColor);
+    constexpr int pawnDirection = moveColor == White ? 8 : -8;
+    const Square from = move.From();
+    const Square to = move.To();
+
+    if (move.Type() == Move::Promotion) {
+        board.RemovePiece(move.PromotionType(), moveColor, to);
+        board.AddPiece(PieceType::Pawn, moveColor, from);
     }
     else {
-        boardHash ^= transpositionTable.pieceZobrist[move.to][(int)move.type][moveColor];
-    }
-    if (move.type == PieceType::King && move.from == STARTING_KING_SQUARE[moveColor] ) {
-        if (move.to == move.from + 2) { // short castle
-            board.Move(PieceType::Rook, moveColor, move.from + 3, move.from + 1);
-            boardHash ^= transpositionTable.pieceZobrist[move.from + 3][(int)PieceType::Rook][moveColor];
-            boardHash ^= transpositionTable.pieceZobrist[move.from + 1][(int)PieceType::Rook][moveColor];
-        }
-        else if (move.to == move.from - 2) { // long castle
-            board.Move(PieceType::Rook, moveColor, move.from - 4, move.from - 1);
-            boardHash ^= transpositionTable.pieceZobrist[move.from - 4][(int)PieceType::Rook][moveColor];
-            boardHash ^= transpositionTable.pieceZobrist[move.from - 1][(int)PieceType::Rook][moveColor];
-        }
-    }
-
-    unsigned int oldCastlingRightsIndex = ((unsigned int)(board.shortCastlingRight[White])) << 3 |
-                                          ((unsigned int)(board.shortCastlingRight[Black])) << 2 |
-                                          ((unsigned int)(board.longCastlingRight[White])) << 1 |
-                                          ((unsigned int)(board.longCastlingRight[Black])); 
-    boardHash ^= transpositionTable.castlingRightsZobrist[oldCastlingRightsIndex];
-
-    board.enPassant = newEPSquare;
-    board.shortCastlingRight[moveColor] = board.shortCastlingRight[moveColor] && !(move.flags & Move::RemovesShortCastlingRight);
-    board.longCastlingRight[moveColor] = board.longCastlingRight[moveColor] && !(move.flags & Move::RemovesLongCastlingRight);
-    board.shortCastlingRight[oppColor] = board.shortCastlingRight[oppColor] && !(move.flags & Move::RemovesOppShortCastlingRight);
-    board.longCastlingRight[oppColor] = board.longCastlingRight[oppColor] && !(move.flags & Move::RemovesOppLongCastlingRight);
-
-    unsigned int newCastlingRightsIndex = ((unsigned int)(board.shortCastlingRight[White])) << 3 |
-                                          ((unsigned int)(board.shortCastlingRight[Black])) << 2 |
-                                          ((unsigned int)(board.longCastlingRight[White])) << 1 |
-                                          ((unsigned int)(board.longCastlingRight[Black])); 
-    boardHash ^= transpositionTable.castlingRightsZobrist[newCastlingRightsIndex];
-}
-
-void UndoMove(const Move &move, Board &board, Color moveColor) {
-    Square originalEPSquare = board.enPassant - move.enPassantDelta;
-    board.Move(move.type, moveColor, move.to, move.from);
-    Bitboard toBB = ToBitboard(move.to);
-    Color oppColor = ToggleColor(moveColor);
-    // TODO: handle enPassant capture properly
-    if (move.capturedPieceType != PieceType::None) {
-        if (move.type == PieceType::Pawn && move.to == originalEPSquare) {
-            constexpr int enPassantOffset[2] = { -8, 8 };
-            Square capturedPawnSquare = move.to + enPassantOffset[moveColor];
-            board.bitboards2D[oppColor][(int)move.capturedPieceType] |= ToBitboard(capturedPawnSquare);
+        board.Move(board.PieceTypeAt(to), moveColor, to, from);
+    }
+    if (move.Type() == Move::Castling) {
+        if (to > from) {
+            board.Move(PieceType::Rook, moveColor, from + 1, from + 3); 
         }
         else {
-            board.bitboards2D[oppColor][(int)move.capturedPieceType] |= toBB;
+            board.Move(PieceType::Rook, moveColor, from - 1, from - 4);
         }
     }
-    if (move.promotionType != PieceType::None) {
-        board.bitboards2D[moveColor][(int)move.promotionType] &= ~toBB;
-    }
-    if (move.type == PieceType::King && move.from == STARTING_KING_SQUARE[moveColor] ) {
-        if (move.to == move.from + 2) {
-            board.Move(PieceType::Rook, moveColor, move.from + 1, move.from + 3); 
-        }
-        else if (move.to == move.from - 2) {
-            board.Move(PieceType::Rook, moveColor, move.from - 1, move.from - 4);
-        }
+    if (undo.capturedPieceType != PieceType::None) {
+        Square capturedSquare = move.Type() == Move::EnPassant ? to - pawnDirection : to;
+        board.AddPiece(undo.capturedPieceType, oppColor, capturedSquare);
     }
 
-    board.enPassant = originalEPSquare;
-    
-    board.shortCastlingRight[moveColor] = board.shortCastlingRight[moveColor] || (move.flags & Move::RemovesShortCastlingRight);
-    board.longCastlingRight[moveColor] = board.longCastlingRight[moveColor] || (move.flags & Move::RemovesLongCastlingRight);
-    board.shortCastlingRight[oppColor] = board.shortCastlingRight[oppColor] || (move.flags & Move::RemovesOppShortCastlingRight);
-    board.longCastlingRight[oppColor] = board.longCastlingRight[oppColor] || (move.flags & Move::RemovesOppLongCastlingRight);
+    board.enPassant = undo.enPassant;
+    board.castlingRights = undo.castlingRights;
 }
 
-bool underThreat(const Board &board, int squareIndex, Color threatColor) {
+template<Color threatColor>
+bool UnderThreat(const Board &board, int squareIndex) {
     if (knightAttacks[squareIndex] & board.Knights(threatColor)) { return true; }
     if (pawnAttacks[ToggleColor(threatColor)][squareIndex] & board.Pawns(threatColor)) { return true; }
     if (kingAttacks[squareIndex] & board.Kings(threatColor)) { return true; } 
@@ -228,7 +380,21 @@ bool underThreat(const Board &board, int squareIndex, Color threatColor) {
     return false;
 }
 
-bool InCheck(const Board& board, Color color) {
+template<Color color>
+bool InCheck(const Board& board) {
     Square kingSquare = LSB(board.bitboards2D[color][KING_OFFSET]);
-    return underThreat(board, kingSquare, ToggleColor(color));
+    return UnderThreat<ToggleColor(color)>(board, kingSquare);
 }
+
+template PieceType RemovePiece<White>(Square square, Board& board);
+template PieceType RemovePiece<Black>(Square square, Board& board);
+template UndoInfo MakeMove<White>(const Move &move, Board &board);
+template UndoInfo MakeMove<Black>(const Move &move, Board &board);
+template UndoInfo MakeMove<White>(const Move &move, Board &board, std::uint64_t& boardHash);
+template UndoInfo MakeMove<Black>(const Move &move, Board &board, std::uint64_t& boardHash);
+template void UndoMove<White>(const Move &move, Board &board, const UndoInfo& undo);
+template void UndoMove<Black>(const Move &move, Board &board, const UndoInfo& undo);
+template bool UnderThreat<White>(const Board &board, int squareIndex);
+template bool UnderThreat<Black>(const Board &board, int squareIndex);
+template bool InCheck<White>(const Board& board);
+template bool InCheck<Black>(const Board& board);
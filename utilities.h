@@ -1,15 +1,53 @@
 #pragma once 
 #include "board.h"
 #include "movegen.h"
+#include <string>
+#include <string_view>
 
+std::string MoveToUCINotation(const Move& move);
+// Builds the move from its squares and the board without generating moves, so the move is trusted to be legal.
+// Returns the null move Move{} for malformed text or an empty from square.
+Move ParseUCIMove(std::string_view uciMove, const Board& board);
+// Standard algebraic notation with the check or mate suffix, e.g. "Nbd7", "exd6", "e8=Q+", "O-O-O"
+std::string MoveToSAN(const Move& move, const Board& board, Color colorToMove);
+// Parses SAN as written in EPD and PGN files: the suffixes "+", "#", "!" and "?" are ignored and castling may be written
+// with zeros. Returns Move{} unless exactly one legal move matches.
+Move ParseSANMove(std::string_view san, const Board& board, Color colorToMove);
 void PrettyPrint(Bitboard bb);
 void PrettyPrint(const Board& board);
 Piece PieceAt(int squareIndex, const Board &board);
 PieceType PieceTypeAt(Square square, const Board& board);
-PieceType RemovePiece(Square square, Board& board, Color color);
+PieceType PieceTypeAt(Square square, const Board& board, Color color);
 
-void MakeMove(const Move &move, Board &board, Color colorToMove);
-void MakeMove(const Move &move, Board &board, Color colorToMove, std::uint64_t &boardHash);
-void UndoMove(const Move& move, Board& board, Color colorToMove);
-bool underThreat(const Board &board, int squareIndex, Color threatColor);
-bool InCheck(const Board& board, Color color);
+// The templated versions are specialized per color so search and movegen avoid branching on the side to move.
+// The Color-argument overloads dispatch to them for callers that only know the color at runtime.
+template<Color color> PieceType RemovePiece(Square square, Board& board);
+template<Color colorToMove> UndoInfo MakeMove(const Move &move, Board &board);
+template<Color colorToMove> UndoInfo MakeMove(const Move &move, Board &board, std::uint64_t &boardHash);
+template<Color colorToMove> void UndoMove(const Move& move, Board& board, const UndoInfo& undo);
+template<Color threatColor> bool UnderThreat(const Board &board, int squareIndex);
+template<Color color> bool InCheck(const Board& board);
+
+inline PieceType RemovePiece(Square square, Board& board, Color color) {
+    return color == White ? RemovePiece<White>(square, board) : RemovePiece<Black>(square, board);
+}
+
+inline UndoInfo MakeMove(const Move &move, Board &board, Color colorToMove) {
+    return colorToMove == White ? MakeMove<White>(move, board) : MakeMove<Black>(move, board);
+}
+
+inline UndoInfo MakeMove(const Move &move, Board &board, Color colorToMove, std::uint64_t &boardHash) {
+    return colorToMove == White ? MakeMove<White>(move, board, boardHash) : MakeMove<Black>(move, board, boardHash);
+}
+
+inline void UndoMove(const Move& move, Board& board, Color colorToMove, const UndoInfo& undo) {
+    colorToMove == White ? UndoMove<White>(move, board, undo) : UndoMove<Black>(move, board, undo);
+}
+
+inline bool underThreat(const Board &board, int squareIndex, Color threatColor) {
+    return threatColor == White ? UnderThreat<White>(board, squareIndex) : UnderThreat<Black>(board, squareIndex);
+}
+
+inline bool InCheck(const Board& board, Color color) {
+    return color == White ? InCheck<White>(board) : InCheck<Black>(board);
+}